@@ -0,0 +1,236 @@
+#include "CharScan.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+size_t
+ScalarScan::spaceRun(const char* p, size_t n)
+{
+  size_t i = 0;
+  while (i < n && (charClasses[p[i]] & CHAR_SPACE)) {
+    i++;
+  }
+  return i;
+}
+
+size_t
+ScalarScan::identifierRun(const char* p, size_t n)
+{
+  size_t i = 0;
+  while (i < n && (charClasses[p[i]] & (CHAR_IDENT_START | CHAR_DIGIT))) {
+    i++;
+  }
+  return i;
+}
+
+size_t
+ScalarScan::numberRun(const char* p, size_t n)
+{
+  size_t i = 0;
+  while (i < n && ((charClasses[p[i]] & CHAR_DIGIT) || p[i] == '.')) {
+    i++;
+  }
+  return i;
+}
+
+size_t
+ScalarScan::findEither(const char* p, size_t n, char a, char b)
+{
+  size_t i = 0;
+  while (i < n && p[i] != a && p[i] != b) {
+    i++;
+  }
+  return i;
+}
+
+// [vector blocks]
+//
+// A Block compares SIZE bytes at a time into lanes of all ones or all zeros
+// and packs them into an integer mask with BITS bits per byte. Byte ranges
+// are tested unsigned as min(v - lo, hi - lo) == v - lo.
+
+namespace {
+
+#if defined(__SSE2__)
+
+struct Block
+{
+  using Vec = __m128i;
+  static constexpr size_t SIZE = 16;
+  static constexpr unsigned BITS = 1;
+  static constexpr uint64_t ALL = 0xffffull;
+
+  static Vec load(const char* p)
+  {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  }
+  static Vec splat(char c) { return _mm_set1_epi8(c); }
+  static Vec equal(Vec a, char c) { return _mm_cmpeq_epi8(a, splat(c)); }
+  static Vec either(Vec a, Vec b) { return _mm_or_si128(a, b); }
+  static Vec inRange(Vec v, char lo, char hi)
+  {
+    Vec d = _mm_sub_epi8(v, splat(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(d, splat(hi - lo)), d);
+  }
+  static uint64_t mask(Vec v)
+  {
+    return static_cast<uint32_t>(_mm_movemask_epi8(v));
+  }
+};
+
+#elif defined(__ARM_NEON)
+
+struct Block
+{
+  using Vec = uint8x16_t;
+  static constexpr size_t SIZE = 16;
+  static constexpr unsigned BITS = 4;
+  static constexpr uint64_t ALL = ~0ull;
+
+  static Vec load(const char* p)
+  {
+    return vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+  }
+  static Vec splat(char c) { return vdupq_n_u8(static_cast<uint8_t>(c)); }
+  static Vec equal(Vec a, char c) { return vceqq_u8(a, splat(c)); }
+  static Vec either(Vec a, Vec b) { return vorrq_u8(a, b); }
+  static Vec inRange(Vec v, char lo, char hi)
+  {
+    return vcleq_u8(vsubq_u8(v, splat(lo)), splat(hi - lo));
+  }
+  // no movemask, narrowing each 16 bit pair by 4 leaves a nibble per byte
+  static uint64_t mask(Vec v)
+  {
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(v), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+  }
+};
+
+#endif
+
+} // namespace
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+
+#if defined(__SSE2__)
+const char* const VectorScan::NAME = "sse2";
+#else
+const char* const VectorScan::NAME = "neon";
+#endif
+
+using ScalarRun = size_t (*)(const char*, size_t);
+
+// most runs in source code are a few bytes long, those end before a block
+// load pays off
+static const size_t SCALAR_PREFIX = 8;
+
+// bytes of [p, p + n) while `match` holds, whole blocks first and the tail
+// through `scalar`
+template<typename Match>
+static size_t
+vectorRun(const char* p, size_t n, Match match, ScalarRun scalar)
+{
+  size_t i = scalar(p, n < SCALAR_PREFIX ? n : SCALAR_PREFIX);
+  if (i < SCALAR_PREFIX) {
+    return i;
+  }
+  for (; i + Block::SIZE <= n; i += Block::SIZE) {
+    uint64_t miss = ~Block::mask(match(Block::load(p + i))) & Block::ALL;
+    if (miss) {
+      return i + __builtin_ctzll(miss) / Block::BITS;
+    }
+  }
+  return i + scalar(p + i, n - i);
+}
+
+size_t
+VectorScan::spaceRun(const char* p, size_t n)
+{
+  return vectorRun(
+    p,
+    n,
+    [](Block::Vec v) {
+      return Block::either(Block::equal(v, ' '),
+                           Block::inRange(v, '\t', '\r'));
+    },
+    ScalarScan::spaceRun);
+}
+
+size_t
+VectorScan::identifierRun(const char* p, size_t n)
+{
+  return vectorRun(
+    p,
+    n,
+    [](Block::Vec v) {
+      // setting bit 5 folds A-Z onto a-z without pulling in anything else
+      Block::Vec lower = Block::either(v, Block::splat(0x20));
+      return Block::either(
+        Block::either(Block::inRange(lower, 'a', 'z'),
+                      Block::inRange(v, '0', '9')),
+        Block::equal(v, '_'));
+    },
+    ScalarScan::identifierRun);
+}
+
+size_t
+VectorScan::numberRun(const char* p, size_t n)
+{
+  return vectorRun(
+    p,
+    n,
+    [](Block::Vec v) {
+      return Block::either(Block::inRange(v, '0', '9'), Block::equal(v, '.'));
+    },
+    ScalarScan::numberRun);
+}
+
+size_t
+VectorScan::findEither(const char* p, size_t n, char a, char b)
+{
+  size_t i = 0;
+  for (; i + Block::SIZE <= n; i += Block::SIZE) {
+    Block::Vec v = Block::load(p + i);
+    uint64_t hits = Block::mask(Block::either(Block::equal(v, a),
+                                              Block::equal(v, b)));
+    if (hits) {
+      return i + __builtin_ctzll(hits) / Block::BITS;
+    }
+  }
+  return i + ScalarScan::findEither(p + i, n - i, a, b);
+}
+
+#else
+
+const char* const VectorScan::NAME = "scalar";
+
+size_t
+VectorScan::spaceRun(const char* p, size_t n)
+{
+  return ScalarScan::spaceRun(p, n);
+}
+
+size_t
+VectorScan::identifierRun(const char* p, size_t n)
+{
+  return ScalarScan::identifierRun(p, n);
+}
+
+size_t
+VectorScan::numberRun(const char* p, size_t n)
+{
+  return ScalarScan::numberRun(p, n);
+}
+
+size_t
+VectorScan::findEither(const char* p, size_t n, char a, char b)
+{
+  return ScalarScan::findEither(p, n, a, b);
+}
+
+#endif
+
+// [/vector blocks]
@@ -0,0 +1,215 @@
+/**
+ * $file CharScan.h
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+
+// [char classes]
+
+enum CharClass : uint8_t
+{
+  CHAR_SPACE = 1 << 0,      // what isspace() accepts in the C locale
+  CHAR_IDENT_START = 1 << 1, // [A-Za-z_]
+  CHAR_DIGIT = 1 << 2,
+  CHAR_OPERATOR = 1 << 3,
+};
+
+struct CharClassTable
+{
+  uint8_t classes[256];
+
+  constexpr uint8_t operator[](char c) const
+  {
+    return classes[static_cast<unsigned char>(c)];
+  }
+};
+
+constexpr CharClassTable
+makeCharClassTable()
+{
+  CharClassTable table = {};
+  for (int c = 0; c < 256; ++c) {
+    uint8_t cls = 0;
+    if (c == ' ' || (c >= '\t' && c <= '\r')) {
+      cls |= CHAR_SPACE;
+    }
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') {
+      cls |= CHAR_IDENT_START;
+    }
+    if (c >= '0' && c <= '9') {
+      cls |= CHAR_DIGIT;
+    }
+    for (char op : std::string_view("+-*/%=<>!&|^~?:.,;(){}[]")) {
+      if (c == op) {
+        cls |= CHAR_OPERATOR;
+      }
+    }
+    table.classes[c] = cls;
+  }
+  return table;
+}
+
+inline constexpr CharClassTable charClasses = makeCharClassTable();
+
+// [/char classes]
+
+// [keywords]
+
+inline constexpr std::string_view cKeywords[] = {
+  "auto",       "break",     "case",           "char",
+  "const",      "continue",  "default",        "do",
+  "double",     "else",      "enum",           "extern",
+  "float",      "for",       "goto",           "if",
+  "inline",     "int",       "long",           "register",
+  "restrict",   "return",    "short",          "signed",
+  "sizeof",     "static",    "struct",         "switch",
+  "typedef",    "union",     "unsigned",       "void",
+  "volatile",   "while",     "_Alignas",       "_Alignof",
+  "_Atomic",    "_Bool",     "_Complex",       "_Generic",
+  "_Imaginary", "_Noreturn", "_Static_assert", "_Thread_local",
+};
+
+// Perfect hash over cKeywords, the multipliers are searched for at compile
+// time so editing the list can't silently introduce a collision.
+struct KeywordHash
+{
+  static constexpr size_t TABLE_SIZE = 128;
+  static constexpr size_t MAX_LENGTH = 14;
+
+  uint32_t first = 0;
+  uint32_t last = 0;
+  uint8_t slots[TABLE_SIZE] = {}; // keyword index + 1, 0 is empty
+
+  constexpr size_t operator()(std::string_view word) const
+  {
+    return (static_cast<unsigned char>(word[0]) * first +
+            static_cast<unsigned char>(word[word.size() - 1]) * last +
+            static_cast<unsigned char>(word[1]) + word.size()) %
+           TABLE_SIZE;
+  }
+};
+
+constexpr KeywordHash
+makeKeywordHash()
+{
+  for (uint32_t first = 1; first < 64; ++first) {
+    for (uint32_t last = 0; last < 64; ++last) {
+      KeywordHash hash;
+      hash.first = first;
+      hash.last = last;
+
+      bool perfect = true;
+      size_t count = sizeof(cKeywords) / sizeof(cKeywords[0]);
+      for (size_t i = 0; i < count && perfect; ++i) {
+        size_t slot = hash(cKeywords[i]);
+        perfect = hash.slots[slot] == 0;
+        hash.slots[slot] = static_cast<uint8_t>(i + 1);
+      }
+      if (perfect) {
+        return hash;
+      }
+    }
+  }
+  return KeywordHash();
+}
+
+inline constexpr KeywordHash keywordHash = makeKeywordHash();
+static_assert(keywordHash.first != 0, "no perfect hash for cKeywords");
+
+constexpr bool
+isKeyword(std::string_view word)
+{
+  if (word.size() < 2 || word.size() > KeywordHash::MAX_LENGTH) {
+    return false;
+  }
+  uint8_t slot = keywordHash.slots[keywordHash(word)];
+  return slot != 0 && cKeywords[slot - 1] == word;
+}
+
+// [/keywords]
+
+// Runs of one character class, as used by the tokenizer. Every function
+// returns how many bytes from the start of [p, p + n) belong to the run, or
+// for findEither() the offset of the first match (n if there is none).
+struct ScalarScan
+{
+  static constexpr const char* NAME = "scalar";
+
+  static size_t spaceRun(const char* p, size_t n);
+  static size_t identifierRun(const char* p, size_t n); // [A-Za-z0-9_]
+  static size_t numberRun(const char* p, size_t n);     // [0-9.]
+  static size_t findEither(const char* p, size_t n, char a, char b);
+};
+
+// Same contract, 16 bytes per step with SSE2 or NEON, which every x86_64
+// and aarch64 build has, scalar on other targets.
+struct VectorScan
+{
+  static const char* const NAME;
+
+  static size_t spaceRun(const char* p, size_t n);
+  static size_t identifierRun(const char* p, size_t n);
+  static size_t numberRun(const char* p, size_t n);
+  static size_t findEither(const char* p, size_t n, char a, char b);
+};
+
+// What tokenizeLine() runs on. Space, identifier and number runs in source
+// code are mostly a few bytes long, those are scanned per byte inline and
+// only a run past LONG_RUN bytes goes on in vector blocks. Literal bodies go
+// to the blocks right away.
+struct TokenScan
+{
+  static constexpr size_t LONG_RUN = 16;
+
+  static size_t spaceRun(const char* p, size_t n)
+  {
+    return run(
+      p,
+      n,
+      [](char c) { return (charClasses[c] & CHAR_SPACE) != 0; },
+      VectorScan::spaceRun);
+  }
+
+  static size_t identifierRun(const char* p, size_t n)
+  {
+    return run(
+      p,
+      n,
+      [](char c) {
+        return (charClasses[c] & (CHAR_IDENT_START | CHAR_DIGIT)) != 0;
+      },
+      VectorScan::identifierRun);
+  }
+
+  static size_t numberRun(const char* p, size_t n)
+  {
+    return run(
+      p,
+      n,
+      [](char c) { return (charClasses[c] & CHAR_DIGIT) || c == '.'; },
+      VectorScan::numberRun);
+  }
+
+  static size_t findEither(const char* p, size_t n, char a, char b)
+  {
+    return VectorScan::findEither(p, n, a, b);
+  }
+
+private:
+  template<typename Match>
+  static size_t run(const char* p,
+                    size_t n,
+                    Match match,
+                    size_t (*longRun)(const char*, size_t))
+  {
+    size_t limit = n < LONG_RUN ? n : LONG_RUN;
+    size_t i = 0;
+    while (i < limit && match(p[i])) {
+      i++;
+    }
+    return i < LONG_RUN ? i : i + longRun(p + i, n - i);
+  }
+};
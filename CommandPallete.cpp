@@ -1,4 +1,6 @@
 #include "CommandPallete.h"
+#include "Profiler.h"
+#include "Utf8.h"
 #include <algorithm>
 
 CommandPalette::CommandPalette(BatchRenderer& renderer,
@@ -176,6 +178,7 @@ CommandPalette::updateSystemCommandList()
   m_items.emplace_back("/r", 3);
   m_items.emplace_back("/fmt", 4);
   m_items.emplace_back("/wdir", 5);
+  m_items.emplace_back("/trace", 6);
 
   filterItems();
 }
@@ -292,21 +295,18 @@ CommandPalette::handleInput(SDL_Event e)
         } break;
         case SDLK_BACKSPACE:
           if (!m_inputText.empty() && m_cursorPosition > 0) {
-            m_inputText.erase(m_cursorPosition - 1, 1);
-            m_cursorPosition--;
+            size_t previous = PreviousCodepoint(m_inputText, m_cursorPosition);
+            m_inputText.erase(previous, m_cursorPosition - previous);
+            m_cursorPosition = previous;
             checkAndUpdateMode();
             filterItems();
           }
           break;
         case SDLK_LEFT:
-          if (m_cursorPosition > 0) {
-            m_cursorPosition--;
-          }
+          m_cursorPosition = PreviousCodepoint(m_inputText, m_cursorPosition);
           break;
         case SDLK_RIGHT:
-          if (m_cursorPosition < m_inputText.length()) {
-            m_cursorPosition++;
-          }
+          m_cursorPosition = NextCodepoint(m_inputText, m_cursorPosition);
           break;
         case SDLK_HOME:
           m_cursorPosition = 0;
@@ -329,18 +329,8 @@ CommandPalette::handleInput(SDL_Event e)
 float
 CommandPalette::measureTextWidth(const std::string& text) const
 {
-  float totalWidth = 0;
-  float scale =
-    stbtt_ScaleForPixelHeight(&m_renderer.fontData.fontInfo, fontSize);
-
-  for (char c : text) {
-    int32_t advance, lsb;
-    stbtt_GetCodepointHMetrics(
-      &m_renderer.fontData.fontInfo, c, &advance, &lsb);
-    totalWidth += advance * scale;
-  }
-
-  return totalWidth;
+  const GlyphMetrics& glyphs = m_renderer.fontData.Metrics(fontSize);
+  return glyphs.Width(text.data(), text.size());
 }
 
 void
@@ -349,6 +339,8 @@ CommandPalette::render()
   if (!m_isVisible)
     return;
 
+  PROFILE_ZONE("palette render");
+
   // @background
   float paletteWidth = m_windowWidth * 0.7f;
   float paletteHeight = m_windowHeight * 0.6f;
@@ -383,10 +375,12 @@ CommandPalette::render()
     m_inputText.c_str(), inputTextPosition, fontSize, WHITE, LAYER_UI);
 
   // @cursor
-  Vector2 cursorPosition = { inputPosition.x + 5.0f +
-                               measureTextWidth(
-                                 m_inputText.substr(0, m_cursorPosition)),
-                             inputPosition.y + 5.0f };
+  const GlyphMetrics& glyphs = m_renderer.fontData.Metrics(fontSize);
+  size_t cursorColumn = std::min(m_cursorPosition, m_inputText.size());
+  Vector2 cursorPosition = {
+    inputPosition.x + 5.0f + glyphs.Width(m_inputText.data(), cursorColumn),
+    inputPosition.y + 5.0f
+  };
 
   m_renderer.AddQuad(cursorPosition,
                      2.0f,
@@ -526,10 +520,9 @@ CommandPalette::renderTextSearchResults()
                           LAYER_UI);
 
       // highlighted part
+      const GlyphMetrics& glyphs = m_renderer.fontData.Metrics(fontSize);
       float preHighlightWidth =
-        m_renderer
-          .MeasureText(displayText.substr(0, highlightStart).c_str(), fontSize)
-          .x;
+        glyphs.Width(displayText.data(), highlightStart);
       m_renderer.DrawText(
         displayText
           .substr(highlightStart + 10, highlightEnd - highlightStart - 10)
@@ -541,13 +534,8 @@ CommandPalette::renderTextSearchResults()
 
       // after the highlight
       float highlightWidth =
-        m_renderer
-          .MeasureText(
-            displayText
-              .substr(highlightStart + 10, highlightEnd - highlightStart - 10)
-              .c_str(),
-            fontSize)
-          .x;
+        glyphs.Width(displayText.data() + highlightStart + 10,
+                     highlightEnd - highlightStart - 10);
       m_renderer.DrawText(
         displayText.substr(highlightEnd + 11).c_str(),
         { itemPosition.x + 5.0f + preHighlightWidth + highlightWidth,
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "PieceTable.h"
 #include "backend/2d/Renderer.h"
 #include "pch.h"
 #include <functional>
@@ -46,7 +47,7 @@ public:
   void handleInput(SDL_Event e);
   float measureTextWidth(const std::string& text) const;
   void render();
-  void setEditorText(const std::string& text) { m_editorText = text; }
+  void setEditorText(const PieceTable& text) { m_editorText = text.substr(0); }
   inline CommandPaletteMode getMode() const { return m_mode; }
 
 public:
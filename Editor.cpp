@@ -1,5 +1,7 @@
 #include "Editor.h"
+#include "Profiler.h"
 #include "Tokenizer.h"
+#include "Utf8.h"
 
 #include <chrono>
 #include <fstream>
@@ -16,8 +18,6 @@
 #include <unordered_set>
 
 extern std::map<SyntaxElementType, SyntaxStyle> syntaxStyles;
-extern inline const std::unordered_set<std::string> cKeywords;
-extern inline const std::unordered_set<char> cOperators;
 
 constexpr int32_t OFFSET_FROM_BOTTOM = 80;
 
@@ -42,21 +42,18 @@ SimpleTextEditor::SimpleTextEditor(BatchRenderer& renderer,
   , cursorVisualPosition(pos)
   , cursorTargetPosition(pos)
 {
+  font = &renderer.fontData;
   fontInfo = &renderer.fontData.fontInfo;
-  recalculateFontMetrics();
-  lineNumberWidth = measureTextWidth("000") + 20.0f;
   editorWidth = renderer.windowWidth;
   editorHeight = renderer.windowHeight - OFFSET_FROM_BOTTOM;
+  recalculateFontMetrics();
 
-  text = " ";
+  replaceBuffer(" ");
   cursorPosition = 0;
   resetSelection();
   updateCursorTargetPosition();
 
-  textChanged = true;
-  const std::vector<WrappedLine>& lines = wrapText(text);
-  float totalContentHeight = lines.size() * lineHeight;
-  maxScrollOffsetY = std::max(0.0f, totalContentHeight - editorHeight);
+  updateScrollBounds();
   scrollOffsetY = 0;
 }
 
@@ -218,7 +215,7 @@ SimpleTextEditor::hideHoverInfo()
 
 // [/CTAGS]
 
-const std::string&
+const PieceTable&
 SimpleTextEditor::getText() const
 {
   return text;
@@ -231,8 +228,7 @@ SimpleTextEditor::handleCommandPaletteSelection(size_t position)
   resetSelection();
   updateCursorTargetPosition();
 
-  const std::vector<WrappedLine>& lines = wrapText(text);
-  size_t lineIndex = getLineIndexAtPosition(cursorPosition, lines);
+  size_t lineIndex = getLineIndexAtPosition(cursorPosition);
   scrollOffsetY = lineIndex * lineHeight;
   scrollOffsetY = std::max(0.0f, std::min(scrollOffsetY, maxScrollOffsetY));
 }
@@ -243,6 +239,7 @@ SimpleTextEditor::resize(uint32_t width, uint32_t height)
   editorWidth = width;
   editorHeight = height - OFFSET_FROM_BOTTOM;
   recalculateFontMetrics();
+  frameDirty = true;
 }
 
 void
@@ -259,6 +256,11 @@ SimpleTextEditor::loadProjectConfig()
                 << std::endl;
     }
     configFile.close();
+
+    auto scroll = projectConfig.find("gpu_scroll");
+    gpuScroll = scroll != projectConfig.end() && scroll->is_boolean() &&
+                scroll->get<bool>();
+    frameDirty = true;
   } else {
     std::cerr << "Error: Unable to open project configuration file."
               << projectConfigPath << std::endl;
@@ -266,6 +268,16 @@ SimpleTextEditor::loadProjectConfig()
   }
 }
 
+uint32_t
+SimpleTextEditor::msaaSamples() const
+{
+  auto samples = projectConfig.find("msaa_samples");
+  if (samples == projectConfig.end() || !samples->is_number_unsigned()) {
+    return MSAA_NUMBER_OF_SAMPLE;
+  }
+  return samples->get<uint32_t>();
+}
+
 static std::string build_command_status = "IDLE";
 static pid_t build_process_pid = -1;
 static std::chrono::steady_clock::time_point build_start_time;
@@ -376,7 +388,7 @@ SimpleTextEditor::formatCodeWithClangFormat()
     std::cerr << "Error: Unable to create temporary input file.\n";
     return;
   }
-  outFile << text;
+  outFile << text.substr(0);
   outFile.close();
 
   std::string tempOutputFile = "temp_program_out.c";
@@ -418,11 +430,15 @@ SimpleTextEditor::formatCodeWithClangFormat()
   buffer << inFile.rdbuf();
   inFile.close();
 
-  std::string oldText = text;
-  pushUndoState();
-  text = buffer.str();
+  // only the changed hunks go into the undo journal
+  std::vector<UndoEdit> edits = diffText(text.substr(0), buffer.str());
+  beginUndoGroup();
+  for (const UndoEdit& edit : edits) {
+    replaceText(edit.position, edit.removed.size(), edit.inserted);
+  }
+  beginUndoGroup();
 
-  // cursorPosition = 0;
+  cursorPosition = std::min(cursorPosition, text.length());
   resetSelection();
   updateCursorTargetPosition();
 
@@ -452,17 +468,15 @@ SimpleTextEditor::loadTextFromFile(const std::string& filename)
   if (file.is_open()) {
     std::stringstream buffer;
     buffer << file.rdbuf();
-    text = buffer.str();
+    replaceBuffer(buffer.str());
     file.close();
+    undoJournal.clear();
 
     cursorPosition = 0;
     resetSelection();
     updateCursorTargetPosition();
 
-    textChanged = true;
-    const std::vector<WrappedLine>& lines = wrapText(text);
-    float totalContentHeight = lines.size() * lineHeight;
-    maxScrollOffsetY = std::max(0.0f, totalContentHeight - editorHeight);
+    updateScrollBounds();
     scrollOffsetY = 0;
 
     std::cout << "File loaded successfully: " << filename << std::endl;
@@ -480,6 +494,11 @@ SimpleTextEditor::handleInput(SDL_Event& event)
 {
   bool shiftPressed = (SDL_GetModState() & SDL_KMOD_SHIFT) != 0;
   bool ctrlPressed = (SDL_GetModState() & SDL_KMOD_CTRL) != 0;
+
+  // nothing reacts to plain mouse movement
+  if (event.type != SDL_EVENT_MOUSE_MOTION) {
+    frameDirty = true;
+  }
 #if 0
   if (event.type == SDL_EVENT_MOUSE_MOTION) {
     std::string token = getCurrentTokenUnderCursor();
@@ -496,26 +515,27 @@ SimpleTextEditor::handleInput(SDL_Event& event)
   else
 #endif
   if (event.type == SDL_EVENT_KEY_DOWN) {
-    textChanged = true;
     switch (event.key.key) {
       case SDLK_BACKSPACE:
         if (hasSelection()) {
-          pushUndoState();
+          beginUndoGroup();
           deleteSelection();
         } else if (cursorPosition > 0) {
-          pushUndoState();
-          text.erase(cursorPosition - 1, 1);
-          cursorPosition--;
+          beginUndoGroup();
+          size_t previous = PreviousCodepoint(text, cursorPosition);
+          eraseText(previous, cursorPosition - previous);
+          cursorPosition = previous;
         }
         resetSelection();
         break;
       case SDLK_DELETE:
         if (hasSelection()) {
-          pushUndoState();
+          beginUndoGroup();
           deleteSelection();
         } else if (cursorPosition < text.length()) {
-          pushUndoState();
-          text.erase(cursorPosition, 1);
+          beginUndoGroup();
+          eraseText(cursorPosition,
+                    NextCodepoint(text, cursorPosition) - cursorPosition);
         }
         resetSelection();
 
@@ -594,12 +614,12 @@ SimpleTextEditor::handleInput(SDL_Event& event)
         break;
       case SDLK_RETURN:
       case SDLK_KP_ENTER:
-        pushUndoState();
+        beginUndoGroup();
         if (hasSelection()) {
           deleteSelection();
         }
 
-        text.insert(cursorPosition, "\n");
+        insertText(cursorPosition, "\n");
         cursorPosition++;
         resetSelection();
         updateCursorTargetPosition();
@@ -666,11 +686,15 @@ SimpleTextEditor::handleInput(SDL_Event& event)
         break;
     }
   } else if (event.type == SDL_EVENT_TEXT_INPUT) {
-    pushUndoState();
     if (hasSelection()) {
-      deleteSelection();
+      size_t start = std::min(selectionStart, selectionEnd);
+      size_t end = std::max(selectionStart, selectionEnd);
+      beginUndoGroup();
+      replaceText(start, end - start, event.text.text, true);
+      cursorPosition = start;
+    } else {
+      insertText(cursorPosition, event.text.text, true);
     }
-    text.insert(cursorPosition, event.text.text);
     cursorPosition += SDL_strlen(event.text.text);
     resetSelection();
   }
@@ -683,54 +707,174 @@ SimpleTextEditor::handleInput(SDL_Event& event)
 }
 
 void
-SimpleTextEditor::pushUndoState()
+SimpleTextEditor::applyEdit(size_t position,
+                            size_t count,
+                            const std::string& inserted)
 {
-  if (undoStack.size() >= MAX_STACK_SIZE) {
-    std::stack<std::string> tempStack;
-    while (undoStack.size() > 1) {
-      tempStack.push(undoStack.top());
-      undoStack.pop();
-    }
-    undoStack.pop();
-    while (!tempStack.empty()) {
-      undoStack.push(tempStack.top());
-      tempStack.pop();
+  logicalLines.erase(position, count);
+  text.erase(position, count);
+  logicalLines.insert(position, inserted.data(), inserted.size());
+  text.insert(position, inserted);
+
+  // the edited lines got new keys in the index, wrap them right away so the
+  // rows above the viewport stay exact. A big paste only gets its first
+  // lines wrapped here, the worker's layout fills in the rest.
+  size_t lastLine = logicalLines.lineAt(position + inserted.size());
+  size_t firstLine = logicalLines.lineAt(position);
+  layout.edited(firstLine);
+  if (lastLine - firstLine >= EAGER_LAYOUT_LINES) {
+    lastLine = firstLine + EAGER_LAYOUT_LINES - 1;
+    layout.defer(lastLine + 1);
+  }
+  for (size_t line = firstLine; line <= lastLine; ++line) {
+    layout.layoutLine(line);
+  }
+
+  pendingEdits.add(position, count, inserted.size());
+  editVersion++;
+  frameDirty = true;
+}
+
+void
+SimpleTextEditor::replaceBuffer(std::string contents)
+{
+  text.assign(std::move(contents));
+  logicalLines.build(text);
+  layout.invalidate();
+  glyphRuns.clear();
+
+  // the worker starts over from this text, earlier edits no longer matter
+  pendingEdits = EditRange();
+  bufferReplaced = true;
+  editVersion++;
+  frameDirty = true;
+}
+
+void
+SimpleTextEditor::wakeRenderLoop()
+{
+  // SDL_PushEvent may be called from any thread
+  SDL_Event event = {};
+  event.type = SDL_EVENT_USER;
+  SDL_PushEvent(&event);
+}
+
+void
+SimpleTextEditor::submitToWorker()
+{
+  if (editVersion == submittedVersion && glyphs == submittedGlyphs &&
+      wrapWidth == submittedWrapWidth) {
+    return;
+  }
+
+  EditorWorker::Job job;
+  job.version = editVersion;
+  job.text = text.snapshot();
+  job.edits = pendingEdits;
+  job.rebuild = bufferReplaced;
+  job.metrics = *glyphs;
+  job.wrapWidth = wrapWidth;
+  unpublished.push_back({ editVersion, pendingEdits, bufferReplaced });
+  worker.submit(std::move(job));
+
+  submittedVersion = editVersion;
+  submittedGlyphs = glyphs;
+  submittedWrapWidth = wrapWidth;
+  pendingEdits = EditRange();
+  bufferReplaced = false;
+}
+
+bool
+SimpleTextEditor::unpublishedEdits(EditRange& edits)
+{
+  uint64_t published = worker.version();
+  unpublished.erase(std::remove_if(unpublished.begin(),
+                                   unpublished.end(),
+                                   [&](const SubmittedEdits& submitted) {
+                                     return submitted.version <= published;
+                                   }),
+                    unpublished.end());
+  if (published == 0 || bufferReplaced) {
+    return false;
+  }
+  for (const SubmittedEdits& submitted : unpublished) {
+    if (submitted.rebuild) {
+      return false;
     }
+    edits.add(submitted.edits);
   }
-  undoStack.push(text);
-  while (!redoStack.empty()) {
-    redoStack.pop();
+  edits.add(pendingEdits);
+  return true;
+}
+
+void
+SimpleTextEditor::replaceText(size_t position,
+                              size_t count,
+                              const std::string& inserted,
+                              bool typing)
+{
+  if (count == 0 && inserted.empty()) {
+    return;
   }
+  undoJournal.record(
+    position, text.substr(position, count), inserted, cursorPosition, typing);
+  applyEdit(position, count, inserted);
+}
+
+void
+SimpleTextEditor::insertText(size_t position,
+                             const std::string& inserted,
+                             bool typing)
+{
+  replaceText(position, 0, inserted, typing);
+}
+
+void
+SimpleTextEditor::eraseText(size_t position, size_t count)
+{
+  replaceText(position, count, std::string());
+}
+
+void
+SimpleTextEditor::beginUndoGroup()
+{
+  undoJournal.seal();
 }
 
 void
 SimpleTextEditor::undo()
 {
-  if (!undoStack.empty()) {
-    redoStack.push(text);
-    text = undoStack.top();
-    undoStack.pop();
+  const UndoGroup* group = undoJournal.undo();
+  if (!group) {
+    return;
+  }
 
-    cursorPosition = std::min(cursorPosition, text.length() - 1);
-    resetSelection();
-    updateCursorTargetPosition();
-    textChanged = true;
+  for (auto it = group->edits.rbegin(); it != group->edits.rend(); ++it) {
+    applyEdit(it->position, it->inserted.size(), it->removed);
   }
+
+  cursorPosition = std::min(group->cursorBefore, text.length());
+  resetSelection();
+  updateCursorTargetPosition();
 }
 
 void
 SimpleTextEditor::redo()
 {
-  if (!redoStack.empty()) {
-    undoStack.push(text);
-    text = redoStack.top();
-    redoStack.pop();
+  const UndoGroup* group = undoJournal.redo();
+  if (!group) {
+    return;
+  }
 
-    cursorPosition = std::min(cursorPosition, text.length() - 1);
-    resetSelection();
-    updateCursorTargetPosition();
-    textChanged = true;
+  for (const UndoEdit& edit : group->edits) {
+    applyEdit(edit.position, edit.removed.size(), edit.inserted);
   }
+
+  const UndoEdit& last = group->edits.back();
+  cursorPosition =
+    std::min(last.position + last.inserted.size(), text.length());
+  resetSelection();
+  updateCursorTargetPosition();
 }
 
 bool
@@ -791,11 +935,12 @@ SimpleTextEditor::decreaseFontSize()
 void
 SimpleTextEditor::insertTab(bool unindent)
 {
+  beginUndoGroup();
   const size_t space_size = 2;
 
   if (selectionStart == selectionEnd) {
     if (!unindent) {
-      text.insert(cursorPosition, space_size, ' ');
+      insertText(cursorPosition, std::string(space_size, ' '));
       cursorPosition += space_size;
     }
   } else {
@@ -803,13 +948,13 @@ SimpleTextEditor::insertTab(bool unindent)
     size_t start = std::min(selectionStart, selectionEnd);
     size_t end = std::max(selectionStart, selectionEnd);
 
-    const std::vector<WrappedLine>& lines = wrapText(text);
-    size_t startLine = getLineIndexAtPosition(start, lines);
-    size_t endLine = getLineIndexAtPosition(end, lines);
+    size_t startLine = logicalLines.lineAt(start);
+    size_t endLine = logicalLines.lineAt(end);
 
     size_t offset = 0;
     for (size_t i = startLine; i <= endLine; ++i) {
-      size_t lineStart = lines[i].startPos + offset;
+      // the index follows every edit, so line starts are always current
+      size_t lineStart = logicalLines.lineStart(i);
 
       if (unindent) {
         size_t spaces = 0;
@@ -817,11 +962,11 @@ SimpleTextEditor::insertTab(bool unindent)
           spaces++;
         }
         if (spaces > 0) {
-          text.erase(lineStart, spaces);
+          eraseText(lineStart, spaces);
           offset -= spaces;
         }
       } else {
-        text.insert(lineStart, space_size, ' ');
+        insertText(lineStart, std::string(space_size, ' '));
         offset += space_size;
       }
     }
@@ -842,14 +987,12 @@ SimpleTextEditor::insertTab(bool unindent)
 void
 SimpleTextEditor::removeTab()
 {
+  beginUndoGroup();
   const size_t space_size = 2;
 
   if (selectionStart == selectionEnd) {
-    size_t lineStart = text.rfind('\n', cursorPosition);
-    if (lineStart == std::string::npos)
-      lineStart = 0;
-    else
-      lineStart++;
+    size_t lineStart =
+      logicalLines.lineStart(logicalLines.lineAt(cursorPosition));
 
     size_t spacesToRemove = std::min(cursorPosition - lineStart, space_size);
     size_t actualSpaces = 0;
@@ -861,20 +1004,19 @@ SimpleTextEditor::removeTab()
     }
 
     if (actualSpaces > 0) {
-      text.erase(lineStart, actualSpaces);
+      eraseText(lineStart, actualSpaces);
       cursorPosition -= actualSpaces;
     }
   } else {
     size_t start = std::min(selectionStart, selectionEnd);
     size_t end = std::max(selectionStart, selectionEnd);
 
-    const std::vector<WrappedLine>& lines = wrapText(text);
-    size_t startLine = getLineIndexAtPosition(start, lines);
-    size_t endLine = getLineIndexAtPosition(end, lines);
+    size_t startLine = logicalLines.lineAt(start);
+    size_t endLine = logicalLines.lineAt(end);
 
     size_t totalRemoved = 0;
     for (size_t i = startLine; i <= endLine; ++i) {
-      size_t lineStart = lines[i].startPos - totalRemoved;
+      size_t lineStart = logicalLines.lineStart(i);
       size_t spacesToRemove = 0;
 
       for (size_t j = 0; j < space_size && lineStart + j < text.length(); ++j) {
@@ -885,7 +1027,7 @@ SimpleTextEditor::removeTab()
       }
 
       if (spacesToRemove > 0) {
-        text.erase(lineStart, spacesToRemove);
+        eraseText(lineStart, spacesToRemove);
         totalRemoved += spacesToRemove;
       }
     }
@@ -904,17 +1046,16 @@ SimpleTextEditor::removeTab()
 void
 SimpleTextEditor::toggleComment()
 {
+  beginUndoGroup();
   if (selectionStart == selectionEnd) {
-    const std::vector<WrappedLine>& lines = wrapText(text);
-    size_t lineIndex = getLineIndexAtPosition(cursorPosition, lines);
-    size_t lineStart = lines[lineIndex].startPos;
-    const std::string& lineText = lines[lineIndex].text;
+    size_t lineStart =
+      logicalLines.lineStart(logicalLines.lineAt(cursorPosition));
 
-    if (lineText.substr(0, 2) == "//") {
-      text.erase(lineStart, 2);
+    if (text.substr(lineStart, 2) == "//") {
+      eraseText(lineStart, 2);
       cursorPosition = std::max(cursorPosition - 2, lineStart);
     } else {
-      text.insert(lineStart, "//");
+      insertText(lineStart, "//");
       cursorPosition += 2;
     }
   } else {
@@ -924,12 +1065,12 @@ SimpleTextEditor::toggleComment()
 
     if (selectedText.substr(0, 2) == "/*" &&
         selectedText.substr(selectedText.length() - 2) == "*/") {
-      text.erase(end - 2, 2);
-      text.erase(start, 2);
+      eraseText(end - 2, 2);
+      eraseText(start, 2);
       selectionEnd -= 4;
     } else {
-      text.insert(end, "*/");
-      text.insert(start, "/*");
+      insertText(end, "*/");
+      insertText(start, "/*");
       selectionEnd += 4;
     }
 
@@ -958,14 +1099,11 @@ SimpleTextEditor::jumpToBottom()
 void
 SimpleTextEditor::jumpToMiddleOfLine()
 {
-  const std::vector<WrappedLine>& lines = wrapText(text);
-  size_t currentLineIndex = getLineIndexAtPosition(cursorPosition, lines);
-  const WrappedLine& currentLine = lines[currentLineIndex];
-
-  size_t lineStart = currentLine.startPos;
-  size_t lineLength = currentLine.text.length();
+  size_t line = logicalLines.lineAt(cursorPosition);
+  size_t lineStart = logicalLines.lineStart(line);
+  size_t lineLength = logicalLines.lineEnd(line) - lineStart;
 
-  cursorPosition = lineStart + lineLength / 2;
+  cursorPosition = CodepointStart(text, lineStart + lineLength / 2);
   resetSelection();
   updateCursorTargetPosition();
 }
@@ -973,41 +1111,49 @@ SimpleTextEditor::jumpToMiddleOfLine()
 void
 SimpleTextEditor::duplicateLine()
 {
-  if (!text.size())
+  if (text.empty())
     return;
-  const std::vector<WrappedLine>& lines = wrapText(text);
+  beginUndoGroup();
 
   if (selectionStart == selectionEnd) {
-    size_t lineIndex = getLineIndexAtPosition(cursorPosition, lines);
-    size_t lineStart = lines[lineIndex].startPos;
-    size_t lineEnd = (lineIndex < lines.size() - 1)
-                       ? lines[lineIndex + 1].startPos
-                       : text.length();
+    size_t line = logicalLines.lineAt(cursorPosition);
+    size_t lineStart = logicalLines.lineStart(line);
+    size_t lineEnd = lineStart + logicalLines.lineLength(line);
 
     std::string lineToDuplicate = text.substr(lineStart, lineEnd - lineStart);
 
-    text.insert(lineEnd, lineToDuplicate);
+    size_t copyStart = lineEnd;
+    if (line + 1 == logicalLines.lineCount()) {
+      // the last line has no '\n' of its own
+      lineToDuplicate.insert(0, 1, '\n');
+      copyStart++;
+    }
+    insertText(lineEnd, lineToDuplicate);
 
-    cursorPosition = lineEnd + (cursorPosition - lineStart);
+    cursorPosition = copyStart + (cursorPosition - lineStart);
   } else {
     size_t start = std::min(selectionStart, selectionEnd);
     size_t end = std::max(selectionStart, selectionEnd);
 
-    size_t startLine = getLineIndexAtPosition(start, lines);
-    size_t endLine = getLineIndexAtPosition(end, lines);
+    size_t startLine = logicalLines.lineAt(start);
+    size_t endLine = logicalLines.lineAt(end);
 
-    size_t selectionStart = lines[startLine].startPos;
-    size_t selectionEnd = (endLine < lines.size() - 1)
-                            ? lines[endLine + 1].startPos
-                            : text.length();
+    size_t selectionStart = logicalLines.lineStart(startLine);
+    size_t selectionEnd =
+      logicalLines.lineStart(endLine) + logicalLines.lineLength(endLine);
 
     std::string textToDuplicate =
       text.substr(selectionStart, selectionEnd - selectionStart);
 
-    text.insert(selectionEnd, textToDuplicate);
+    size_t copyStart = selectionEnd;
+    if (endLine + 1 == logicalLines.lineCount()) {
+      textToDuplicate.insert(0, 1, '\n');
+      copyStart++;
+    }
+    insertText(selectionEnd, textToDuplicate);
 
     size_t insertedLength = selectionEnd - selectionStart;
-    selectionStart = selectionEnd;
+    selectionStart = copyStart;
     selectionEnd = selectionStart + insertedLength;
     cursorPosition = selectionEnd;
   }
@@ -1019,7 +1165,7 @@ void
 SimpleTextEditor::cutSelectedText()
 {
   if (hasSelection()) {
-    pushUndoState();
+    beginUndoGroup();
     copySelectedText();
     deleteSelection();
     updateCursorTargetPosition();
@@ -1032,11 +1178,11 @@ SimpleTextEditor::pasteText()
   if (SDL_HasClipboardText()) {
     char* clipboardText = SDL_GetClipboardText();
     if (clipboardText) {
-      pushUndoState();
+      beginUndoGroup();
       if (hasSelection()) {
         deleteSelection();
       }
-      text.insert(cursorPosition, clipboardText);
+      insertText(cursorPosition, clipboardText);
       cursorPosition += strlen(clipboardText);
       resetSelection();
       updateCursorTargetPosition();
@@ -1050,7 +1196,7 @@ SimpleTextEditor::deleteSelection()
 {
   size_t start = std::min(selectionStart, selectionEnd);
   size_t end = std::max(selectionStart, selectionEnd);
-  text.erase(start, end - start);
+  eraseText(start, end - start);
   cursorPosition = start;
   resetSelection();
 }
@@ -1066,9 +1212,7 @@ void
 SimpleTextEditor::moveCursorLeft(bool shiftPressed)
 {
   size_t oldCursorPosition = cursorPosition;
-  if (cursorPosition > 0) {
-    cursorPosition--;
-  }
+  cursorPosition = PreviousCodepoint(text, cursorPosition);
   updateSelection(shiftPressed, oldCursorPosition);
 }
 
@@ -1076,9 +1220,7 @@ void
 SimpleTextEditor::moveCursorRight(bool shiftPressed)
 {
   size_t oldCursorPosition = cursorPosition;
-  if (cursorPosition < text.length()) {
-    cursorPosition++;
-  }
+  cursorPosition = NextCodepoint(text, cursorPosition);
   updateSelection(shiftPressed, oldCursorPosition);
 }
 
@@ -1086,16 +1228,17 @@ void
 SimpleTextEditor::moveCursorUp(bool shiftPressed)
 {
   size_t oldCursorPosition = cursorPosition;
-  const std::vector<WrappedLine>& lines = wrapText(text);
-  size_t lineIndex = getLineIndexAtPosition(cursorPosition, lines);
+  size_t lineIndex = getLineIndexAtPosition(cursorPosition);
   if (lineIndex == 0)
     return;
 
-  size_t prevLineStartPos = getLineStartPosition(lineIndex - 1, lines);
-  size_t prevLineLength = lines[lineIndex - 1].text.length();
+  WrapLayout::Row line = layout.row(lineIndex);
+  WrapLayout::Row prevLine = layout.row(lineIndex - 1);
 
-  size_t cursorInLine = cursorPosition - getLineStartPosition(lineIndex, lines);
-  cursorPosition = prevLineStartPos + std::min(prevLineLength, cursorInLine);
+  size_t cursorInLine = cursorPosition - line.start;
+  cursorPosition = CodepointStart(
+    text,
+    prevLine.start + std::min(prevLine.end - prevLine.start, cursorInLine));
 
   updateSelection(shiftPressed, oldCursorPosition);
 }
@@ -1104,16 +1247,17 @@ void
 SimpleTextEditor::moveCursorDown(bool shiftPressed)
 {
   size_t oldCursorPosition = cursorPosition;
-  const std::vector<WrappedLine>& lines = wrapText(text);
-  size_t lineIndex = getLineIndexAtPosition(cursorPosition, lines);
-  if (lineIndex >= lines.size() - 1)
+  size_t lineIndex = getLineIndexAtPosition(cursorPosition);
+  if (lineIndex + 1 >= layout.rowCount())
     return;
 
-  size_t nextLineStartPos = getLineStartPosition(lineIndex + 1, lines);
-  size_t nextLineLength = lines[lineIndex + 1].text.length();
+  WrapLayout::Row line = layout.row(lineIndex);
+  WrapLayout::Row nextLine = layout.row(lineIndex + 1);
 
-  size_t cursorInLine = cursorPosition - getLineStartPosition(lineIndex, lines);
-  cursorPosition = nextLineStartPos + std::min(nextLineLength, cursorInLine);
+  size_t cursorInLine = cursorPosition - line.start;
+  cursorPosition = CodepointStart(
+    text,
+    nextLine.start + std::min(nextLine.end - nextLine.start, cursorInLine));
 
   updateSelection(shiftPressed, oldCursorPosition);
 }
@@ -1122,9 +1266,8 @@ void
 SimpleTextEditor::moveCursorToLineStart(bool shiftPressed)
 {
   size_t oldCursorPosition = cursorPosition;
-  const std::vector<WrappedLine>& lines = wrapText(text);
-  size_t lineIndex = getLineIndexAtPosition(cursorPosition, lines);
-  cursorPosition = getLineStartPosition(lineIndex, lines);
+  size_t lineIndex = getLineIndexAtPosition(cursorPosition);
+  cursorPosition = getLineStartPosition(lineIndex);
 
   updateSelection(shiftPressed, oldCursorPosition);
 }
@@ -1133,10 +1276,8 @@ void
 SimpleTextEditor::moveCursorToLineEnd(bool shiftPressed)
 {
   size_t oldCursorPosition = cursorPosition;
-  const std::vector<WrappedLine>& lines = wrapText(text);
-  size_t lineIndex = getLineIndexAtPosition(cursorPosition, lines);
-  cursorPosition =
-    getLineStartPosition(lineIndex, lines) + lines[lineIndex].text.length();
+  size_t lineIndex = getLineIndexAtPosition(cursorPosition);
+  cursorPosition = layout.row(lineIndex).end;
 
   updateSelection(shiftPressed, oldCursorPosition);
 }
@@ -1156,16 +1297,7 @@ SimpleTextEditor::updateSelection(bool shiftPressed, size_t oldCursorPosition)
 float
 SimpleTextEditor::measureTextWidth(const std::string& text) const
 {
-  float totalWidth = 0;
-  float scale = stbtt_ScaleForPixelHeight(fontInfo, fontSize);
-
-  for (char c : text) {
-    int advance, lsb;
-    stbtt_GetCodepointHMetrics(fontInfo, c, &advance, &lsb);
-    totalWidth += advance * scale;
-  }
-
-  return totalWidth;
+  return glyphs->Width(text.data(), text.size());
 }
 
 float
@@ -1192,7 +1324,11 @@ SimpleTextEditor::recalculateFontMetrics()
   stbtt_GetFontVMetrics(fontInfo, &ascent, &descent, &lineGap);
   baseline = ascent * scale;
   lineHeight = (ascent - descent + lineGap) * scale;
+  glyphs = &font->Metrics(fontSize);
+
   lineNumberWidth = measureTextWidth("000") + 20.0f;
+  wrapWidth = editorWidth - lineNumberWidth - 20.0f;
+  layout.setMetrics(*glyphs, wrapWidth);
 }
 
 void
@@ -1200,7 +1336,7 @@ SimpleTextEditor::saveBufferToFile()
 {
   std::ofstream outFile(bufferName);
   if (outFile.is_open()) {
-    outFile << text;
+    outFile << text.substr(0);
     outFile.close();
     std::cout << "File saved successfully.\n";
   } else {
@@ -1211,45 +1347,63 @@ SimpleTextEditor::saveBufferToFile()
 void
 SimpleTextEditor::updateCursorTargetPosition()
 {
-  const std::vector<WrappedLine>& lines = wrapText(text);
-  float y = position.y;
-
-  for (size_t i = 0; i < lines.size(); ++i) {
-    const WrappedLine& line = lines[i];
-    Vector2 linePosition = { position.x + lineNumberWidth, y };
-
-    size_t lineStartPos = line.startPos;
-    size_t lineEndPos = lineStartPos + line.text.length();
-
-    if (cursorPosition >= lineStartPos && cursorPosition <= lineEndPos) {
-      size_t cursorIndexInLine = cursorPosition - lineStartPos;
-      float cursorX = linePosition.x +
-                      measureTextWidth(line.text.substr(0, cursorIndexInLine));
-      cursorTargetPosition = { cursorX, y + (fontSize - baseline) };
-      return;
-    }
-
-    y += lineHeight;
-  }
+  size_t lineIndex = getLineIndexAtPosition(cursorPosition);
+  size_t lineStartPos = getLineStartPosition(lineIndex);
 
-  cursorTargetPosition = { position.x + lineNumberWidth,
-                           y + (fontSize - baseline) };
+  float cursorX = position.x + lineNumberWidth +
+                  layout.width(lineStartPos, cursorPosition);
+  float y = position.y + lineIndex * lineHeight;
+  cursorTargetPosition = { cursorX, y + (fontSize - baseline) };
 }
 
 void
 SimpleTextEditor::render(BatchRenderer& renderer)
 {
-  const std::vector<WrappedLine>& lines = wrapText(text);
-  float y = position.y - scrollOffsetY;
-  if (textChanged) {
-    tokens = tokenize(text);
-    textChanged = false;
+  PROFILE_ZONE("editor render");
+
+  // only the rows from just above the viewport down are laid out and drawn
+  size_t rowCount = layout.rowCount();
+  size_t firstRow = 0;
+  if (scrollOffsetY > lineHeight + 30) {
+    firstRow = (size_t)((scrollOffsetY - lineHeight - 30) / lineHeight);
+  }
+  float y = position.y - scrollOffsetY + firstRow * lineHeight;
+
+  // Syntax colours are the worker's. Lines edited since its last result are
+  // drawn plain until it catches up, the lines below them are found in its
+  // index by their offset from the edited span.
+  std::unique_lock<std::mutex> results = worker.tryLock();
+  EditRange stale;
+  RowColours colours;
+  colours.colored = results.owns_lock() && unpublishedEdits(stale);
+
+  // a busy worker wakes the loop when it publishes, update() then sees the
+  // new version
+  frameDirty = false;
+  uint64_t glyphGeneration = renderer.GlyphGeneration();
+  if (results.owns_lock()) {
+    renderedWorkerVersion = worker.version();
+  }
+  if (colours.colored && stale.touched) {
+    colours.stale = true;
+    colours.firstStaleLine = logicalLines.lineAt(stale.start);
+    colours.lastStaleLine = logicalLines.lineAt(stale.end);
+    colours.workerLastStaleLine =
+      worker.lines().lineAt(stale.end - stale.delta);
   }
 
-  size_t tokenIndex = 0;
+  // with GPU scrolling the text is resident and only the selection is
+  // drawn here row by row
+  size_t endRow = rowCount;
+  if (gpuScroll) {
+    renderResident(renderer, firstRow, colours, results.owns_lock());
+    if (!hasSelection()) {
+      endRow = firstRow;
+    }
+  }
 
-  for (size_t i = 0; i < lines.size(); ++i) {
-    const WrappedLine& line = lines[i];
+  for (size_t i = firstRow; i < endRow; ++i) {
+    WrapLayout::Row line = layout.row(i);
     Vector2 lineNumberPosition = { position.x, y };
     Vector2 linePosition = { position.x + lineNumberWidth, y };
     if (y + lineHeight + 30 < position.y) {
@@ -1259,14 +1413,27 @@ SimpleTextEditor::render(BatchRenderer& renderer)
       break;
     }
 
-    char lineNumberText[16];
-    sprintf(lineNumberText, "%3zu", i + 1);
-    renderer.DrawText(
-      lineNumberText, lineNumberPosition, fontSize, lineNumberColor, LAYER_UI);
+    // x of every column in the row, shared by selection, tokens and cursor,
+    // a row with a cached glyph run and no selection doesn't need it
+    bool measured = hasSelection();
+    if (measured) {
+      glyphs->PrefixWidths(
+        text.iteratorAt(line.start), line.end - line.start, rowX);
+    }
+
+    if (!gpuScroll) {
+      char lineNumberText[24]; // any size_t
+      snprintf(lineNumberText, sizeof(lineNumberText), "%3zu", i + 1);
+      renderer.DrawText(lineNumberText,
+                        lineNumberPosition,
+                        fontSize,
+                        lineNumberColor,
+                        LAYER_UI);
+    }
 
     if (hasSelection()) {
-      size_t lineStartPos = line.startPos;
-      size_t lineEndPos = lineStartPos + line.text.length();
+      size_t lineStartPos = line.start;
+      size_t lineEndPos = line.end;
 
       size_t selStart = selectionStart;
       size_t selEnd = selectionEnd;
@@ -1276,16 +1443,13 @@ SimpleTextEditor::render(BatchRenderer& renderer)
       }
 
       if (selEnd > lineStartPos && selStart < lineEndPos) {
-        size_t selectionStartInLine =
-          std::max(selStart, lineStartPos) - lineStartPos;
-        size_t selectionEndInLine = std::min(selEnd, lineEndPos) - lineStartPos;
+        size_t selectionStartPos = std::max(selStart, lineStartPos);
+        size_t selectionEndPos = std::min(selEnd, lineEndPos);
 
         float selectionXStart =
-          linePosition.x +
-          measureTextWidth(line.text.substr(0, selectionStartInLine));
+          linePosition.x + rowX[selectionStartPos - lineStartPos];
         float selectionXEnd =
-          linePosition.x +
-          measureTextWidth(line.text.substr(0, selectionEndInLine));
+          linePosition.x + rowX[selectionEndPos - lineStartPos];
 
         if (selectionXEnd < position.x ||
             selectionXStart > position.x + editorWidth) {
@@ -1320,66 +1484,24 @@ SimpleTextEditor::render(BatchRenderer& renderer)
     }
 
   RenderText:
-    float textEndX = linePosition.x + measureTextWidth(line.text);
-    if (textEndX < position.x || linePosition.x > position.x + editorWidth) {
+    if (linePosition.x > position.x + editorWidth) {
       y += lineHeight;
       continue;
     }
 
-    size_t lineStartPos = line.startPos;
-    size_t lineEndPos = lineStartPos + line.text.length();
-
-    float x = linePosition.x;
-    while (tokenIndex < tokens.size()) {
-      const SyntaxToken& token = tokens[tokenIndex];
-
-      size_t tokenStartPos = token.startPos;
-      size_t tokenEndPos = token.startPos + token.text.length();
-      if (tokenEndPos <= lineStartPos) {
-        tokenIndex++;
-        continue;
-      }
-
-      if (tokenStartPos >= lineEndPos) {
-        break;
-      }
-
-      size_t overlapStart = std::max(tokenStartPos, lineStartPos);
-      size_t overlapEnd = std::min(tokenEndPos, lineEndPos);
-      size_t overlapLength = overlapEnd - overlapStart;
-
-      if (overlapLength > 0) {
-        size_t substringStart = overlapStart - tokenStartPos;
-        size_t substringLength = overlapLength;
-
-        std::string tokenSubstring =
-          token.text.substr(substringStart, substringLength);
-        float tokenWidth = measureTextWidth(tokenSubstring);
-        Vector4 color = syntaxStyles[token.type].color;
-
-        renderer.DrawText(
-          tokenSubstring.c_str(), { x, y }, fontSize, color, LAYER_UI);
-
-        x += tokenWidth;
-      }
-
-      if (tokenEndPos <= lineEndPos) {
-        tokenIndex++;
-      } else {
-        break;
-      }
+    if (!gpuScroll) {
+      const GlyphRunCache::Run& run =
+        rowGlyphs(renderer, line, colours, measured);
+      renderer.AddInstances(run.data(), run.size(), linePosition, LAYER_UI);
     }
 
     if (hasSelection() && selectionStart != cursorPosition) {
       size_t selPos = selectionStart;
-      size_t lineStartPos = line.startPos;
-      size_t lineEndPos = lineStartPos + line.text.length();
+      size_t lineStartPos = line.start;
+      size_t lineEndPos = line.end;
 
       if (selPos >= lineStartPos && selPos <= lineEndPos) {
-        size_t selIndexInLine = selPos - lineStartPos;
-        float selCursorX =
-          linePosition.x +
-          measureTextWidth(line.text.substr(0, selIndexInLine));
+        float selCursorX = linePosition.x + rowX[selPos - lineStartPos];
         Vector2 selCursorPos = { selCursorX, y + (fontSize - baseline) };
 
         if (selCursorPos.x >= position.x &&
@@ -1412,6 +1534,191 @@ SimpleTextEditor::render(BatchRenderer& renderer)
                        LAYER_UI);
     }
   }
+
+  // glyphs evicted for this frame may have been drawn from cached runs,
+  // the next one rebuilds them
+  if (renderer.GlyphGeneration() != glyphGeneration) {
+    frameDirty = true;
+  }
+  glyphRuns.endFrame();
+}
+
+const GlyphRunCache::Run&
+SimpleTextEditor::rowGlyphs(BatchRenderer& renderer,
+                            const WrapLayout::Row& line,
+                            const RowColours& colours,
+                            bool measured)
+{
+  size_t lineStartPos = line.start;
+  size_t lineEndPos = line.end;
+
+  // tokens of the logical line, their positions are relative to its start
+  const TokenList* lineTokens = &plainTokens;
+  if (colours.colored &&
+      (!colours.stale || line.line < colours.firstStaleLine)) {
+    lineTokens = &worker.syntax().lineTokens(line.line);
+  } else if (colours.colored && line.line > colours.lastStaleLine) {
+    lineTokens = &worker.syntax().lineTokens(
+      line.line - colours.lastStaleLine + colours.workerLastStaleLine);
+  } else {
+    plainTokens.clear();
+    plainTokens.push(
+      SyntaxElementType::Default, 0, logicalLines.lineLength(line.line));
+  }
+  const TokenList& tokens = *lineTokens;
+  size_t logicalStartPos = logicalLines.lineStart(line.line);
+  size_t firstToken = tokens.firstEndingAfter(lineStartPos - logicalStartPos);
+
+  // the row's glyphs are cached by its line, where it sits in the line and
+  // what its tokens look like, an unchanged row is copied with an offset
+  uint64_t signature = GlyphRunCache::mix(
+    lineEndPos - lineStartPos, static_cast<uint64_t>(fontSize * 256.0f));
+  signature = GlyphRunCache::mix(signature, renderer.GlyphGeneration());
+  for (size_t t = firstToken; t < tokens.size(); ++t) {
+    SyntaxToken token = tokens[t];
+    size_t tokenStartPos = logicalStartPos + token.startPos;
+    if (tokenStartPos >= lineEndPos) {
+      break;
+    }
+    size_t overlapStart = std::max(tokenStartPos, lineStartPos);
+    size_t overlapEnd = std::min(tokenStartPos + token.length, lineEndPos);
+    signature = GlyphRunCache::mix(signature, overlapStart - lineStartPos);
+    signature = GlyphRunCache::mix(signature, overlapEnd - lineStartPos);
+    signature = GlyphRunCache::mix(
+      signature, QuadBatch::PackColor(syntaxStyles[token.type].color));
+  }
+
+  LineIndex::LineKey lineKey = logicalLines.lineKey(line.line);
+  uint32_t rowStart = static_cast<uint32_t>(lineStartPos - logicalStartPos);
+  if (const GlyphRunCache::Run* run =
+        glyphRuns.find(lineKey, rowStart, signature)) {
+    return *run;
+  }
+
+  if (!measured) {
+    glyphs->PrefixWidths(
+      text.iteratorAt(line.start), line.end - line.start, rowX);
+  }
+  GlyphRunCache::Run& built = glyphRuns.store(lineKey, rowStart, signature);
+
+  // built with the row at the origin
+  float x = 0.0f;
+  for (size_t t = firstToken; t < tokens.size(); ++t) {
+    SyntaxToken token = tokens[t];
+
+    size_t tokenStartPos = logicalStartPos + token.startPos;
+    size_t tokenEndPos = tokenStartPos + token.length;
+    if (tokenStartPos >= lineEndPos) {
+      break;
+    }
+
+    size_t overlapStart = std::max(tokenStartPos, lineStartPos);
+    size_t overlapEnd = std::min(tokenEndPos, lineEndPos);
+    size_t overlapLength = overlapEnd - overlapStart;
+
+    if (overlapLength > 0) {
+      std::string_view tokenText =
+        text.view(overlapStart, overlapLength, tokenScratch);
+      Vector4 color = syntaxStyles[token.type].color;
+
+      renderer.BuildText(tokenText, { x, 0.0f }, fontSize, color, built);
+
+      x = rowX[overlapEnd - lineStartPos];
+    }
+  }
+  return built;
+}
+
+void
+SimpleTextEditor::renderResident(BatchRenderer& renderer,
+                                 size_t firstRow,
+                                 const RowColours& colours,
+                                 bool current)
+{
+  // blocks are laid out at scroll 0 from the origin row, the renderer
+  // moves them by what's scrolled past it
+  if (firstRow + RESIDENT_ORIGIN_ROWS < residentOriginRow ||
+      firstRow > residentOriginRow + RESIDENT_ORIGIN_ROWS) {
+    residentOriginRow = firstRow / RESIDENT_BLOCK_ROWS * RESIDENT_BLOCK_ROWS;
+  }
+  double originY = static_cast<double>(residentOriginRow) * lineHeight;
+  renderer.SetScroll(
+    { 0.0f, -static_cast<float>(scrollOffsetY - originY) },
+    { { 0.0f, 0.0f },
+      { position.x + editorWidth, position.y + editorHeight + lineHeight } });
+
+  // anything that moves or recolours rows changes the stamp, scrolling
+  // doesn't. The layout stamp covers the text and where it goes.
+  uint64_t layoutStamp =
+    GlyphRunCache::mix(editVersion, static_cast<uint64_t>(fontSize * 256.0f));
+  layoutStamp = GlyphRunCache::mix(layoutStamp, layout.rowCount());
+  layoutStamp =
+    GlyphRunCache::mix(layoutStamp, static_cast<uint64_t>(wrapWidth));
+  layoutStamp =
+    GlyphRunCache::mix(layoutStamp, static_cast<uint64_t>(position.x));
+  layoutStamp =
+    GlyphRunCache::mix(layoutStamp, static_cast<uint64_t>(position.y));
+  layoutStamp = GlyphRunCache::mix(layoutStamp, renderer.GlyphGeneration());
+  layoutStamp = GlyphRunCache::mix(layoutStamp, residentOriginRow);
+  uint64_t stamp = GlyphRunCache::mix(layoutStamp, renderedWorkerVersion);
+  stamp = GlyphRunCache::mix(stamp, colours.colored + 2 * colours.stale);
+
+  // the viewport's blocks and one on either side, so rows are streamed in
+  // a block ahead of being scrolled into view
+  size_t rowCount = layout.rowCount();
+  if (rowCount == 0) {
+    return;
+  }
+  size_t visibleRows = static_cast<size_t>(editorHeight / lineHeight) + 2;
+  size_t firstBlock = firstRow / RESIDENT_BLOCK_ROWS;
+  size_t lastBlock = std::min(firstRow + visibleRows, rowCount - 1) /
+                     RESIDENT_BLOCK_ROWS;
+  firstBlock = firstBlock ? firstBlock - 1 : 0;
+  lastBlock = std::min(lastBlock + 1, (rowCount - 1) / RESIDENT_BLOCK_ROWS);
+
+  for (size_t block = firstBlock; block <= lastBlock; ++block) {
+    if (renderer.KeepResident(block, stamp, LAYER_UI)) {
+      continue;
+    }
+    // while the worker holds its results the blocks of the last frame it
+    // didn't are kept, as long as nothing was edited or laid out anew
+    // since. Otherwise the block is rebuilt plain.
+    if (!current && layoutStamp == residentLayoutStamp &&
+        renderer.KeepResident(block, residentStamp, LAYER_UI)) {
+      continue;
+    }
+
+    blockScratch.clear();
+    size_t endRow = std::min((block + 1) * RESIDENT_BLOCK_ROWS, rowCount);
+    for (size_t i = block * RESIDENT_BLOCK_ROWS; i < endRow; ++i) {
+      WrapLayout::Row line = layout.row(i);
+      int64_t row = static_cast<int64_t>(i) -
+                    static_cast<int64_t>(residentOriginRow);
+      float y = position.y + row * lineHeight;
+
+      char lineNumberText[24]; // any size_t
+      snprintf(lineNumberText, sizeof(lineNumberText), "%3zu", i + 1);
+      renderer.BuildText(lineNumberText,
+                         { position.x, y },
+                         fontSize,
+                         lineNumberColor,
+                         blockScratch);
+
+      const GlyphRunCache::Run& run =
+        rowGlyphs(renderer, line, colours, false);
+      for (QuadInstance glyph : run) {
+        glyph.translation.x += position.x + lineNumberWidth;
+        glyph.translation.y += y;
+        blockScratch.push_back(glyph);
+      }
+    }
+    renderer.AddResident(
+      block, stamp, LAYER_UI, blockScratch.data(), blockScratch.size());
+  }
+  if (current) {
+    residentStamp = stamp;
+    residentLayoutStamp = layoutStamp;
+  }
 }
 
 void
@@ -1442,13 +1749,41 @@ SimpleTextEditor::renderBar(BatchRenderer& renderer)
     tokenInfo = info;
   }
 
-  char buffer[255];
+  // geometry that didn't fit is never silent
+  char dropped[64] = "";
+  if (uint64_t quads = renderer.DroppedQuads()) {
+    snprintf(dropped,
+             sizeof(dropped),
+             ", %llu quads dropped",
+             (unsigned long long)quads);
+  }
+
+  // GPU times only once the pass is timed
+  char gpu[64] = "";
+  if (gpuFrameP99 > 0.0f) {
+    snprintf(gpu,
+             sizeof(gpu),
+             ", GPU p50 %.2f ms, p99 %.2f ms",
+             gpuFrameP50,
+             gpuFrameP99);
+  }
+
+  char buffer[320];
   const char* name = bufferName.empty() ? "Untitled" : bufferName.c_str();
-  sprintf(buffer,
-          "Buffer: %s | Build: %s | CTAGS: %s",
-          name,
-          build_command_status.c_str(),
-          tokenInfo.c_str());
+  snprintf(buffer,
+           sizeof(buffer),
+           "Buffer: %s | Build: %s | Frames: %llu drawn, %llu skipped%s, "
+           "p50 %.2f ms, p99 %.2f ms%s | Upload: %.1f KB | CTAGS: %s",
+           name,
+           build_command_status.c_str(),
+           (unsigned long long)framesRendered,
+           (unsigned long long)framesSkipped,
+           dropped,
+           frameP50,
+           frameP99,
+           gpu,
+           uploadBytes / 1024.0,
+           tokenInfo.c_str());
 
   renderer.DrawText(
     buffer, { 20.0f, editorHeight + (50.0f + 15.0f) }, 20.0f, WHITE, LAYER_UI);
@@ -1458,17 +1793,44 @@ void
 SimpleTextEditor::update(float deltaTime)
 {
   cursorBlinkTime += deltaTime;
-  if (cursorBlinkTime >= 0.1f) {
+  if (cursorBlinkTime >= CURSOR_BLINK_SECONDS) {
     showCursor = !showCursor;
     cursorBlinkTime = 0;
+    frameDirty = true;
   }
 
-  cursorVisualPosition = vector2_lerp(
-    cursorVisualPosition, cursorTargetPosition, deltaTime * cursorMoveSpeed);
+  // after the loop slept deltaTime can be long, don't overshoot the target
+  Vector2 lastVisualPosition = cursorVisualPosition;
+  cursorVisualPosition =
+    vector2_lerp(cursorVisualPosition,
+                 cursorTargetPosition,
+                 std::min(deltaTime * cursorMoveSpeed, 1.0f));
 
   if (vector2_distance(cursorVisualPosition, cursorTargetPosition) < 0.5f) {
     cursorVisualPosition = cursorTargetPosition;
   }
+  if (vector2_distance(cursorVisualPosition, lastVisualPosition) > 0.0f) {
+    frameDirty = true;
+  }
+
+  size_t lastRowCount = layout.rowCount();
+  float lastScrollOffsetY = scrollOffsetY;
+
+  // rows off screen are copied from the worker's layout once it has seen
+  // every edit, then it gets whatever changed this frame
+  {
+    std::unique_lock<std::mutex> results = worker.tryLock();
+    if (results.owns_lock() && worker.version() == editVersion &&
+        submittedVersion == editVersion) {
+      PROFILE_ZONE("wrap settle");
+      layout.settle(LAYOUT_SETTLE_LINES, &worker.layout());
+    }
+    if (results.owns_lock() && worker.version() != renderedWorkerVersion) {
+      frameDirty = true;
+    }
+  }
+  submitToWorker();
+  updateScrollBounds();
 
   updateCursorTargetPosition();
   autoScrollToCursor();
@@ -1477,6 +1839,24 @@ SimpleTextEditor::update(float deltaTime)
     scrollOffsetY = 0;
   if (scrollOffsetY > maxScrollOffsetY)
     scrollOffsetY = maxScrollOffsetY;
+
+  if (layout.rowCount() != lastRowCount || scrollOffsetY != lastScrollOffsetY) {
+    frameDirty = true;
+  }
+}
+
+int32_t
+SimpleTextEditor::idleTimeoutMs() const
+{
+  float remaining = CURSOR_BLINK_SECONDS - cursorBlinkTime;
+  return std::max(1, (int32_t)(remaining * 1000.0f + 0.5f));
+}
+
+void
+SimpleTextEditor::setFrameStats(uint64_t rendered, uint64_t skipped)
+{
+  framesRendered = rendered;
+  framesSkipped = skipped;
 }
 
 void
@@ -1497,88 +1877,21 @@ SimpleTextEditor::autoScrollToCursor()
   scrollOffsetY = std::max(0.0f, std::min(scrollOffsetY, maxScrollOffsetY));
 }
 
-std::vector<WrappedLine>
-SimpleTextEditor::wrapText(const std::string& text)
+void
+SimpleTextEditor::updateScrollBounds()
 {
-  std::vector<WrappedLine> wrappedLines;
-  wrappedLines.reserve(1024 << 1);
-
-  float availableWidth = editorWidth - lineNumberWidth - 20.0f;
-
-  size_t textPos = 0;
-  size_t length = text.length();
-
-  size_t logicalLineIndex = 0;
-  size_t logicalLineStartPos = 0;
-
-  while (textPos < length) {
-    if (text[textPos] == '\n') {
-      WrappedLine line;
-      line.text = "";
-      line.startPos = textPos;
-      line.logicalLineIndex = logicalLineIndex;
-      line.logicalLineStartPos = logicalLineStartPos;
-      wrappedLines.emplace_back(line);
-
-      textPos++;
-
-      logicalLineIndex++;
-      logicalLineStartPos = textPos;
-      continue;
-    }
-
-    size_t lineStartPos = textPos;
-    float width = 0.0f;
-    size_t lineLength = 0;
-
-    while (textPos < length && text[textPos] != '\n') {
-      char c = text[textPos];
-      float charWidth = measureTextWidth(std::string(1, c));
-      if (width + charWidth > availableWidth && lineLength > 0) {
-        break;
-      }
-      width += charWidth;
-      textPos++;
-      lineLength++;
-    }
-
-    WrappedLine line;
-    line.text = text.substr(lineStartPos, lineLength);
-    line.startPos = lineStartPos;
-    line.logicalLineIndex = logicalLineIndex;
-    line.logicalLineStartPos = logicalLineStartPos;
-    wrappedLines.emplace_back(line);
-
-    if (textPos < length && text[textPos] == '\n') {
-      textPos++;
-      logicalLineIndex++;
-      logicalLineStartPos = textPos;
-    }
-  }
-
-  float totalContentHeight = wrappedLines.size() * lineHeight;
+  float totalContentHeight = layout.rowCount() * lineHeight;
   maxScrollOffsetY = std::max(0.0f, totalContentHeight - editorHeight);
-
-  return wrappedLines;
 }
 
 size_t
-SimpleTextEditor::getLineIndexAtPosition(size_t position,
-                                         const std::vector<WrappedLine>& lines)
-{
-  for (size_t i = 0; i < lines.size(); ++i) {
-    size_t lineStartPos = lines[i].startPos;
-    size_t lineEndPos = lineStartPos + lines[i].text.length();
-    if (position >= lineStartPos && position <= lineEndPos) {
-      return i;
-    }
-  }
-  return lines.size() - 1;
+SimpleTextEditor::getLineIndexAtPosition(size_t position)
+{
+  return layout.rowAt(position);
 }
 
 size_t
-SimpleTextEditor::getLineStartPosition(size_t lineIndex,
-                                       const std::vector<WrappedLine>& lines)
+SimpleTextEditor::getLineStartPosition(size_t lineIndex)
 {
-  return lines[lineIndex].startPos;
+  return layout.row(lineIndex).start;
 }
@@ -18,23 +18,23 @@
 
 #include "nlohmann/json.hpp"
 
+#include "EditorWorker.h"
+#include "GlyphRunCache.h"
+#include "LineIndex.h"
 #include "Math.h"
+#include "PieceTable.h"
 #include "Tokenizer.h"
+#include "UndoJournal.h"
+#include "WrapLayout.h"
 #include "backend/2d/Renderer.h"
 #include "backend/common.h"
 
-struct WrappedLine
-{
-  std::string text;
-  size_t startPos;
-  size_t logicalLineIndex;
-  size_t logicalLineStartPos;
-};
-
 class SimpleTextEditor
 {
 private:
-  std::string text;
+  PieceTable text;
+  LineIndex logicalLines;
+  WrapLayout layout{ text, logicalLines };
   std::string bufferName;
   std::string bufferExt;
   size_t cursorPosition = 0;
@@ -48,7 +48,21 @@ private:
   Vector4 lineNumberColor;
   float cursorBlinkTime;
   bool showCursor;
+
+  // set by whatever changes what's on screen, cleared by render()
+  bool frameDirty = true;
+  uint64_t renderedWorkerVersion = 0;
+  uint64_t framesRendered = 0;
+  uint64_t framesSkipped = 0;
+  uint64_t uploadBytes = 0;
+  float frameP50 = 0.0f; // ms of CPU work a drawn frame
+  float frameP99 = 0.0f;
+  float gpuFrameP50 = 0.0f; // ms of the render pass, 0 when not timed
+  float gpuFrameP99 = 0.0f;
+  static constexpr float CURSOR_BLINK_SECONDS = 0.1f;
   stbtt_fontinfo* fontInfo;
+  BatchRenderer::Font* font;
+  const GlyphMetrics* glyphs = nullptr;
 
   Vector2 cursorVisualPosition;
   Vector2 cursorTargetPosition;
@@ -62,15 +76,94 @@ private:
   float editorHeight;
   float editorWidth;
   float lineNumberWidth = 0.0f;
-
-  bool textChanged = true;
-  std::vector<SyntaxToken> tokens;
+  std::vector<float> rowX; // prefix widths of the row being drawn
+  GlyphRunCache glyphRuns;  // token glyphs of the rows drawn lately
+  std::string tokenScratch; // token text that spans two pieces
+  TokenList plainTokens;    // one token for a line drawn without colours
+
+  float wrapWidth = 0.0f;
+
+  // stale lines wrapped per frame after a resize or font size change
+  static constexpr size_t LAYOUT_SETTLE_LINES = 8192;
+
+  // lines of an edit wrapped right away, the rest of a big paste is left to
+  // the worker
+  static constexpr size_t EAGER_LAYOUT_LINES = 256;
+
+  // tokens and the layout of off-screen lines come from the worker
+  struct SubmittedEdits
+  {
+    uint64_t version;
+    EditRange edits;
+    bool rebuild;
+  };
+  EditorWorker worker{ wakeRenderLoop };
+  uint64_t editVersion = 0;
+  uint64_t submittedVersion = 0;
+  const GlyphMetrics* submittedGlyphs = nullptr;
+  float submittedWrapWidth = 0.0f;
+  EditRange pendingEdits; // since the last job
+  bool bufferReplaced = false;
+  std::vector<SubmittedEdits> unpublished;
+
+  static void wakeRenderLoop();
+  void replaceBuffer(std::string contents);
+  void submitToWorker();
+  bool unpublishedEdits(EditRange& edits);
+
+  // where a frame's rows get their tokens, see render()
+  struct RowColours
+  {
+    bool colored = false; // worker results are usable
+    bool stale = false;   // some lines were edited since
+    size_t firstStaleLine = 0;
+    size_t lastStaleLine = 0;
+    size_t workerLastStaleLine = 0;
+  };
+
+  // token glyphs of a row with its pen at the origin, from glyphRuns
+  const GlyphRunCache::Run& rowGlyphs(BatchRenderer& renderer,
+                                      const WrapLayout::Row& line,
+                                      const RowColours& colours,
+                                      bool measured);
+
+  // "gpu_scroll": line numbers and text stay uploaded in blocks of
+  // RESIDENT_BLOCK_ROWS rows around the viewport, scrolling only moves them
+  bool gpuScroll = false;
+  static constexpr size_t RESIDENT_BLOCK_ROWS = 64;
+
+  // blocks are laid out relative to this row rather than the document top,
+  // so glyph positions stay small floats in long files. It moves once the
+  // viewport is RESIDENT_ORIGIN_ROWS away.
+  static constexpr size_t RESIDENT_ORIGIN_ROWS = 4096;
+  size_t residentOriginRow = 0;
+
+  uint64_t residentStamp = 0;
+  uint64_t residentLayoutStamp = 0; // of residentStamp, without the colours
+  std::vector<QuadInstance> blockScratch;
+
+  void renderResident(BatchRenderer& renderer,
+                      size_t firstRow,
+                      const RowColours& colours,
+                      bool current);
 
   nlohmann::json projectConfig;
 
-  std::stack<std::string> undoStack;
-  std::stack<std::string> redoStack;
-  const size_t MAX_STACK_SIZE = 100;
+  static constexpr size_t MAX_UNDO_BYTES = 64 * 1024 * 1024;
+  UndoJournal undoJournal{ MAX_UNDO_BYTES };
+
+  // every buffer mutation goes through here, undo/redo included
+  void applyEdit(size_t position, size_t count, const std::string& inserted);
+
+  // journaled edits
+  void replaceText(size_t position,
+                   size_t count,
+                   const std::string& inserted,
+                   bool typing = false);
+  void insertText(size_t position,
+                  const std::string& inserted,
+                  bool typing = false);
+  void eraseText(size_t position, size_t count);
 
   std::string currentToken;
   std::unordered_map<std::string, std::string> tagDefinitions;
@@ -104,7 +197,7 @@ public:
 
   void renderBar(BatchRenderer& renderer);
 
-  const std::string& getText() const;
+  const PieceTable& getText() const;
 
   void handleCommandPaletteSelection(size_t position);
 
@@ -112,6 +205,9 @@ public:
 
   void loadProjectConfig();
 
+  // "msaa_samples" from the project config, MSAA_NUMBER_OF_SAMPLE by default
+  uint32_t msaaSamples() const;
+
   void executeBuildCommand();
 
   inline bool isSupportedLanguage();
@@ -125,7 +221,7 @@ public:
 
   void handleInput(SDL_Event& event);
 
-  void pushUndoState();
+  void beginUndoGroup();
 
   void undo();
 
@@ -193,14 +289,45 @@ public:
 
   void update(float deltaTime);
 
+  // true when the next loop iteration has to draw a frame
+  bool needsFrame() const { return frameDirty; }
+
+  // the last frame was drawn with the worker's results for every edit,
+  // headless runs wait for this before a frame is compared
+  bool settled() const
+  {
+    return submittedVersion == editVersion &&
+           renderedWorkerVersion == editVersion;
+  }
+
+  // how long the loop may sleep before the cursor blinks again
+  int32_t idleTimeoutMs() const;
+
+  void setFrameStats(uint64_t rendered, uint64_t skipped);
+
+  // vertex data the renderer uploaded for the last frame
+  void setUploadBytes(uint64_t bytes) { uploadBytes = bytes; }
+
+  // shown in the bar, from the rolling frame times
+  void setFrameTimes(float p50, float p99)
+  {
+    frameP50 = p50;
+    frameP99 = p99;
+  }
+
+  void setGpuFrameTimes(float p50, float p99)
+  {
+    gpuFrameP50 = p50;
+    gpuFrameP99 = p99;
+  }
+
   void autoScrollToCursor();
 
-  std::vector<WrappedLine> wrapText(const std::string& text);
+  void updateScrollBounds();
 
 public:
-  size_t getLineIndexAtPosition(size_t position,
-                                const std::vector<WrappedLine>& lines);
+  // visual (wrapped) rows
+  size_t getLineIndexAtPosition(size_t position);
 
-  size_t getLineStartPosition(size_t lineIndex,
-                              const std::vector<WrappedLine>& lines);
+  size_t getLineStartPosition(size_t lineIndex);
 };
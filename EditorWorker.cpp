@@ -0,0 +1,152 @@
+#include "EditorWorker.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <string>
+
+void
+EditRange::add(size_t position, size_t erased, size_t inserted)
+{
+  ptrdiff_t change =
+    static_cast<ptrdiff_t>(inserted) - static_cast<ptrdiff_t>(erased);
+  if (!touched) {
+    touched = true;
+    start = position;
+    end = position + inserted;
+    delta = change;
+    return;
+  }
+
+  // everything past the erased bytes moves by the change, the range end too
+  end = std::max(end, position + erased) + change;
+  start = std::min(start, position);
+  delta += change;
+}
+
+void
+EditRange::add(const EditRange& later)
+{
+  if (later.touched) {
+    size_t erased = later.end - later.delta - later.start;
+    add(later.start, erased, later.end - later.start);
+  }
+}
+
+EditorWorker::EditorWorker(std::function<void()> published)
+  : published(std::move(published))
+  , thread(&EditorWorker::run, this)
+{
+}
+
+EditorWorker::~EditorWorker()
+{
+  {
+    std::lock_guard<std::mutex> lock(jobMutex);
+    stopping = true;
+  }
+  jobReady.notify_one();
+  thread.join();
+}
+
+void
+EditorWorker::submit(Job job)
+{
+  {
+    std::lock_guard<std::mutex> lock(jobMutex);
+    if (hasPending) {
+      EditRange edits = pending.edits;
+      edits.add(job.edits);
+      job.edits = edits;
+      job.rebuild = job.rebuild || pending.rebuild;
+    }
+    pending = std::move(job);
+    hasPending = true;
+  }
+  jobReady.notify_one();
+}
+
+void
+EditorWorker::run()
+{
+  Profiler::SetThreadName("editor worker");
+  bool settled = true;
+  for (;;) {
+    Job job;
+    bool hasJob = false;
+    {
+      std::unique_lock<std::mutex> lock(jobMutex);
+      if (settled) {
+        jobReady.wait(lock, [&] { return stopping || hasPending; });
+      }
+      if (stopping) {
+        return;
+      }
+      if (hasPending) {
+        job = std::move(pending);
+        hasPending = false;
+        hasJob = true;
+      }
+    }
+
+    // new tokens, and the finished layout, are worth a frame
+    bool changed = hasJob;
+    {
+      std::lock_guard<std::mutex> lock(resultMutex);
+      if (hasJob) {
+        apply(job);
+      }
+      bool wasSettled = settled;
+      PROFILE_ZONE("wrap settle");
+      settled = workerLayout.settle(SETTLE_STEP);
+      changed = changed || (settled && !wasSettled);
+    }
+    if (changed && published) {
+      published();
+    }
+  }
+}
+
+void
+EditorWorker::apply(Job& job)
+{
+  PROFILE_ZONE("worker job");
+  text = std::move(job.text);
+
+  if (job.rebuild) {
+    workerLines.build(text);
+    workerLayout.invalidate();
+    workerLayout.setMetrics(job.metrics, job.wrapWidth);
+    PROFILE_ZONE("tokenize");
+    workerSyntax.rebuild();
+    publishedVersion = job.version;
+    return;
+  }
+
+  // the snapshot already has the new text, mirror the line structure of the
+  // edited span into the index
+  const EditRange& edits = job.edits;
+  if (edits.touched) {
+    std::string scratch;
+    size_t oldEnd = edits.end - edits.delta;
+    std::string_view inserted =
+      text.view(edits.start, edits.end - edits.start, scratch);
+    workerLines.erase(edits.start, oldEnd - edits.start);
+    workerLines.insert(edits.start, inserted.data(), inserted.size());
+  }
+  workerLayout.setMetrics(job.metrics, job.wrapWidth);
+
+  if (edits.touched) {
+    size_t firstLine = workerLines.lineAt(edits.start);
+    size_t lastLine = workerLines.lineAt(edits.end);
+    workerLayout.edited(firstLine);
+    {
+      PROFILE_ZONE("wrap");
+      for (size_t line = firstLine; line <= lastLine; ++line) {
+        workerLayout.layoutLine(line);
+      }
+    }
+    PROFILE_ZONE("tokenize");
+    workerSyntax.update(firstLine, lastLine);
+  }
+  publishedVersion = job.version;
+}
@@ -0,0 +1,100 @@
+/**
+ * $file EditorWorker.h
+ */
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+
+#include "GlyphMetrics.h"
+#include "LineIndex.h"
+#include "PieceTable.h"
+#include "SyntaxCache.h"
+#include "WrapLayout.h"
+
+// Span of the buffer touched by a run of edits: [start, end) of the current
+// text was [start, end - delta) before them.
+struct EditRange
+{
+  bool touched = false;
+  size_t start = 0;
+  size_t end = 0;
+  ptrdiff_t delta = 0;
+
+  // `erased` bytes at `position` were replaced by `inserted` bytes
+  void add(size_t position, size_t erased, size_t inserted);
+
+  // edits made after the ones already in this range
+  void add(const EditRange& later);
+};
+
+// Tokenizes and wraps the buffer on a thread of its own. The editor hands
+// over an immutable snapshot of the text with the edits since the previous
+// job, the worker mirrors them into its own line index, lexes and wraps the
+// touched lines and then settles the rest of the layout in small steps.
+//
+// Results are read while holding tryLock(), version() tells which edit
+// version they describe. The worker holds the same lock while it applies a
+// job, so a frame that can't get it draws without them instead of waiting.
+class EditorWorker
+{
+public:
+  struct Job
+  {
+    uint64_t version = 0;
+    PieceTable text;
+    EditRange edits;      // since the previous job
+    bool rebuild = false; // the whole buffer was replaced
+    GlyphMetrics metrics;
+    float wrapWidth = 0.0f;
+  };
+
+  // `published` is called on the worker thread whenever new results are
+  // ready to be read
+  explicit EditorWorker(std::function<void()> published);
+  ~EditorWorker();
+
+  EditorWorker(const EditorWorker&) = delete;
+  EditorWorker& operator=(const EditorWorker&) = delete;
+
+  // replaces a job the worker hasn't picked up yet, folding in its edits
+  void submit(Job job);
+
+  std::unique_lock<std::mutex> tryLock()
+  {
+    return std::unique_lock<std::mutex>(resultMutex, std::try_to_lock);
+  }
+
+  // only while holding tryLock(), 0 until the first job is done
+  uint64_t version() const { return publishedVersion; }
+  const LineIndex& lines() const { return workerLines; }
+  const WrapLayout& layout() const { return workerLayout; }
+  SyntaxCache& syntax() { return workerSyntax; }
+
+private:
+  // lines wrapped per step while settling, between steps the lock is free
+  static constexpr size_t SETTLE_STEP = 4096;
+
+  void run();
+  void apply(Job& job);
+
+  PieceTable text;
+  LineIndex workerLines;
+  WrapLayout workerLayout{ text, workerLines };
+  SyntaxCache workerSyntax{ text, workerLines };
+  uint64_t publishedVersion = 0;
+  std::mutex resultMutex;
+  std::function<void()> published;
+
+  std::mutex jobMutex;
+  std::condition_variable jobReady;
+  Job pending;
+  bool hasPending = false;
+  bool stopping = false;
+
+  std::thread thread; // last, starts once everything above exists
+};
@@ -0,0 +1,110 @@
+/**
+ * $file GlyphMetrics.h
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "Utf8.h"
+
+// Scaled advance widths at one pixel height, measured per codepoint the way
+// BatchRenderer::BuildText() draws UTF-8. ASCII comes from a table, other
+// codepoints from the font as they're met (stbtt only reads the font, so
+// that's fine from any thread). Widths are still indexed by byte: a
+// codepoint's advance is on its first byte and the bytes after it are zero
+// wide.
+struct GlyphMetrics
+{
+  // unscaled advance of a codepoint in the font
+  using FontAdvance = float (*)(const void* font, uint32_t codepoint);
+
+  float fontSize = 0.0f;
+  float advances[128] = {};
+
+  // without a font, codepoints past ASCII take the advance of '?'
+  const void* font = nullptr;
+  FontAdvance fontAdvance = nullptr;
+  float fontScale = 0.0f;
+
+  // non-zero when every ASCII character has the same advance, ASCII widths
+  // are then just count * monoAdvance
+  float monoAdvance = 0.0f;
+
+  void DetectMonospace()
+  {
+    monoAdvance = advances[0];
+    for (float advance : advances) {
+      if (advance != monoAdvance) {
+        monoAdvance = 0.0f;
+        return;
+      }
+    }
+  }
+
+  // same widths for every codepoint
+  bool SameAs(const GlyphMetrics& other) const
+  {
+    return font == other.font && fontAdvance == other.fontAdvance &&
+           fontScale == other.fontScale &&
+           memcmp(advances, other.advances, sizeof(advances)) == 0;
+  }
+
+  float CodepointAdvance(uint32_t c) const
+  {
+    if (c < 128) {
+      return advances[c];
+    }
+    if (!fontAdvance) {
+      return advances['?'];
+    }
+    return fontAdvance(font, c) * fontScale;
+  }
+
+  // advance of the codepoint at `text` with `left` bytes to go, `length` is
+  // set to the bytes it takes
+  template<typename It>
+  float Advance(It text, size_t left, size_t& length) const
+  {
+    unsigned char lead = static_cast<unsigned char>(*text);
+    if (lead < 0x80) {
+      length = 1;
+      return advances[lead];
+    }
+    return CodepointAdvance(DecodeUtf8At(text, left, length));
+  }
+
+  template<typename It>
+  float Width(It text, size_t count) const
+  {
+    float width = 0.0f;
+    for (size_t i = 0; i < count;) {
+      size_t length;
+      width += Advance(text, count - i, length);
+      for (size_t b = 0; b < length; ++b, ++text) {
+      }
+      i += length;
+    }
+    return width;
+  }
+
+  // prefix[i] is the width of the first i bytes, so column -> x is a
+  // lookup. prefix ends up with count + 1 entries, bytes inside a codepoint
+  // have the x after it.
+  template<typename It>
+  void PrefixWidths(It text, size_t count, std::vector<float>& prefix) const
+  {
+    prefix.resize(count + 1);
+    prefix[0] = 0.0f;
+    for (size_t i = 0; i < count;) {
+      size_t length;
+      float x = prefix[i] + Advance(text, count - i, length);
+      for (size_t b = 0; b < length; ++b, ++text) {
+        prefix[i + 1 + b] = x;
+      }
+      i += length;
+    }
+  }
+};
@@ -0,0 +1,74 @@
+#include "GlyphRunCache.h"
+
+const GlyphRunCache::Run*
+GlyphRunCache::find(LineIndex::LineKey key,
+                    uint32_t rowStart,
+                    uint64_t signature)
+{
+  if (key.slot < lines.size() && lines[key.slot].serial == key.serial) {
+    LineRuns& runs = lines[key.slot];
+    runs.usedFrame = frame;
+    for (const CachedRow& row : runs.rows) {
+      if (row.rowStart == rowStart && row.signature == signature) {
+        return &row.run;
+      }
+    }
+  }
+  return nullptr;
+}
+
+GlyphRunCache::Run&
+GlyphRunCache::store(LineIndex::LineKey key,
+                     uint32_t rowStart,
+                     uint64_t signature)
+{
+  if (key.slot >= lines.size()) {
+    lines.resize(key.slot + 1);
+  }
+  LineRuns& runs = lines[key.slot];
+  if (runs.serial != key.serial) {
+    runs.serial = key.serial;
+    runs.rows.clear();
+  }
+  runs.usedFrame = frame;
+  if (!runs.listed) {
+    runs.listed = true;
+    filled.push_back(key.slot);
+  }
+
+  for (CachedRow& row : runs.rows) {
+    if (row.rowStart == rowStart) {
+      row.signature = signature;
+      row.run.clear();
+      return row.run;
+    }
+  }
+  runs.rows.push_back({ rowStart, signature, Run() });
+  return runs.rows.back().run;
+}
+
+void
+GlyphRunCache::endFrame()
+{
+  if (++frame % EVICT_FRAMES != 0) {
+    return;
+  }
+  size_t kept = 0;
+  for (uint32_t slot : filled) {
+    LineRuns& runs = lines[slot];
+    if (frame - runs.usedFrame < EVICT_FRAMES) {
+      filled[kept++] = slot;
+    } else {
+      std::vector<CachedRow>().swap(runs.rows);
+      runs.listed = false;
+    }
+  }
+  filled.resize(kept);
+}
+
+void
+GlyphRunCache::clear()
+{
+  lines.clear();
+  filled.clear();
+}
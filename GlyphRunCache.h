@@ -0,0 +1,68 @@
+/**
+ * $file GlyphRunCache.h
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "LineIndex.h"
+#include "backend/2d/QuadBatch.h"
+
+// Glyph instances of the visual rows on screen, built with the row's pen at
+// the origin and drawn again with a translation, so scrolling and untouched
+// lines cost a copy instead of a glyph lookup per character. Rows are kept
+// per line slot of the LineIndex while the line's serial holds, an edit
+// drops only the rows of the lines it touched. Whatever else a row's glyphs
+// depend on (where it starts and ends in its line, the font size, its tokens
+// and their colours) goes into the signature it's looked up with.
+//
+// Lines that weren't drawn for EVICT_FRAMES frames give their runs back.
+class GlyphRunCache
+{
+public:
+  using Run = std::vector<QuadInstance>;
+
+  static constexpr uint64_t EVICT_FRAMES = 256;
+
+  // the run of the row starting `rowStart` into the line, nullptr when it
+  // has to be built
+  const Run* find(LineIndex::LineKey key,
+                  uint32_t rowStart,
+                  uint64_t signature);
+
+  // an empty run to build the row into, it replaces what was cached
+  Run& store(LineIndex::LineKey key, uint32_t rowStart, uint64_t signature);
+
+  // call once a frame, every EVICT_FRAMES frames old lines are dropped
+  void endFrame();
+  void clear();
+
+  // folds `value` into a signature
+  static uint64_t mix(uint64_t hash, uint64_t value)
+  {
+    hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    return hash * 0xff51afd7ed558ccdull;
+  }
+
+private:
+  struct CachedRow
+  {
+    uint32_t rowStart;
+    uint64_t signature;
+    Run run;
+  };
+
+  struct LineRuns
+  {
+    uint32_t serial = 0;
+    uint64_t usedFrame = 0;
+    bool listed = false; // in `filled`
+    std::vector<CachedRow> rows;
+  };
+
+  std::vector<LineRuns> lines; // by line slot
+  std::vector<uint32_t> filled; // slots that hold rows
+  uint64_t frame = 1;
+};
@@ -0,0 +1,455 @@
+#include "Headless.h"
+
+#include "Editor.h"
+#include "backend/2d/Renderer.h"
+#include "backend/RenderTarget.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+
+// a pixel differs when a channel is off by more than GOLDEN_TOLERANCE, the
+// frame matches while at most GOLDEN_MAX_DIFFERING of its pixels do
+static constexpr int32_t GOLDEN_TOLERANCE = 8;
+static constexpr double GOLDEN_MAX_DIFFERING = 0.001;
+
+// a settle that takes longer than this is reported and the script goes on
+static constexpr int32_t SETTLE_MAX_FRAMES = 1000;
+
+static constexpr float FRAME_SECONDS = 1.0f / 60.0f;
+
+struct ScriptAction
+{
+  enum Kind
+  {
+    Open,
+    Type,
+    Key,
+    Wheel,
+    Frame,
+    Settle
+  } kind;
+  size_t line;
+  std::string text; // Open, Type
+  SDL_Keycode key = SDLK_UNKNOWN;
+  SDL_Keymod mods = SDL_KMOD_NONE;
+  int32_t count = 1; // Key, Frame
+  float amount = 0.0f;
+};
+
+struct FrameTiming
+{
+  size_t line; // of the action that drew it, 0 without a script
+  double updateMs;
+  double renderMs; // editor, renderer and encoding
+  double submitMs;
+};
+
+bool
+ParseHeadlessSize(const char* text, HeadlessOptions& options)
+{
+  unsigned width = 0, height = 0;
+  char rest = 0;
+  if (sscanf(text, "%ux%u%c", &width, &height, &rest) != 2 || width == 0 ||
+      height == 0 || width > 16384 || height > 16384) {
+    return false;
+  }
+  options.width = width;
+  options.height = height;
+  return true;
+}
+
+static bool
+ParseKey(const std::string& chord, ScriptAction& action)
+{
+  // modifiers joined to the key name with '+'
+  size_t start = 0;
+  size_t plus;
+  while ((plus = chord.find('+', start)) != std::string::npos &&
+         plus + 1 < chord.size()) {
+    std::string mod = chord.substr(start, plus - start);
+    if (mod == "ctrl") {
+      action.mods |= SDL_KMOD_CTRL;
+    } else if (mod == "shift") {
+      action.mods |= SDL_KMOD_SHIFT;
+    } else if (mod == "alt") {
+      action.mods |= SDL_KMOD_ALT;
+    } else {
+      return false;
+    }
+    start = plus + 1;
+  }
+  action.key = SDL_GetKeyFromName(chord.substr(start).c_str());
+  return action.key != SDLK_UNKNOWN;
+}
+
+static bool
+LoadScript(const std::string& path, std::vector<ScriptAction>& actions)
+{
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    std::cerr << "Unable to open script " << path << "\n";
+    return false;
+  }
+
+  std::string line;
+  size_t lineNumber = 0;
+  while (std::getline(file, line)) {
+    lineNumber++;
+    std::istringstream words(line);
+    std::string command;
+    if (!(words >> command) || command[0] == '#') {
+      continue;
+    }
+
+    ScriptAction action = {};
+    action.line = lineNumber;
+    bool valid = true;
+    if (command == "open" || command == "type") {
+      action.kind = command == "open" ? ScriptAction::Open : ScriptAction::Type;
+      words.get(); // the space after the command
+      std::getline(words, action.text);
+      valid = !action.text.empty();
+    } else if (command == "key") {
+      action.kind = ScriptAction::Key;
+      std::string chord;
+      valid = (words >> chord) && ParseKey(chord, action);
+      if (valid && !(words >> action.count)) {
+        action.count = 1;
+      }
+    } else if (command == "wheel") {
+      action.kind = ScriptAction::Wheel;
+      valid = static_cast<bool>(words >> action.amount);
+    } else if (command == "frame") {
+      action.kind = ScriptAction::Frame;
+      if (!(words >> action.count)) {
+        action.count = 1;
+      }
+    } else if (command == "settle") {
+      action.kind = ScriptAction::Settle;
+    } else {
+      valid = false;
+    }
+
+    if (!valid || action.count < 1) {
+      std::cerr << path << ":" << lineNumber << ": invalid action: " << line
+                << "\n";
+      return false;
+    }
+    actions.push_back(std::move(action));
+  }
+  return true;
+}
+
+static bool
+ReadPpm(const std::string& path,
+        uint32_t& width,
+        uint32_t& height,
+        std::vector<uint8_t>& rgb)
+{
+  std::ifstream file(path, std::ios::binary);
+  std::string magic;
+  uint32_t maxValue = 0;
+  if (!(file >> magic >> width >> height >> maxValue) || magic != "P6" ||
+      maxValue != 255) {
+    return false;
+  }
+  file.get(); // the single whitespace before the pixels
+  rgb.resize(size_t(width) * height * 3);
+  return static_cast<bool>(
+    file.read(reinterpret_cast<char*>(rgb.data()), rgb.size()));
+}
+
+static bool
+WritePpm(const std::string& path,
+         uint32_t width,
+         uint32_t height,
+         const std::vector<uint8_t>& rgb)
+{
+  std::ofstream file(path, std::ios::binary);
+  file << "P6\n" << width << " " << height << "\n255\n";
+  file.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+  return static_cast<bool>(file);
+}
+
+static double
+Percentile(std::vector<double> values, double percentile)
+{
+  if (values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  size_t index = static_cast<size_t>(percentile * (values.size() - 1) + 0.5);
+  return values[index];
+}
+
+int
+RunHeadless(WGPUDevice device, WGPUQueue queue, const HeadlessOptions& options)
+{
+  std::vector<ScriptAction> actions;
+  if (!options.script.empty() && !LoadScript(options.script, actions)) {
+    return 1;
+  }
+  if (options.script.empty()) {
+    ScriptAction settle = {};
+    settle.kind = ScriptAction::Settle;
+    actions.push_back(settle);
+  }
+
+  RenderTarget renderTarget(
+    device, WGPUTextureFormat_BGRA8Unorm, options.width, options.height);
+
+  BatchRenderer batchRenderer(
+    device, queue, renderTarget.Width(), renderTarget.Height());
+  batchRenderer.Initialize();
+
+  // set up as main() does for the window
+  Vector2 editor_position = { 10.0f, 50.0f };
+  float fontSize = 23.0f;
+  Vector4 textColor = { 1.0f, 1.0f, 1.0f, 1.0f };
+  Vector4 cursorColor = LIME;
+  Vector4 selectionColor = { 0.0f, 0.5f, 1.0f, 0.5f };
+  Vector4 lineNumberColor = { 0.7f, 0.7f, 0.7f, 1.0f };
+
+  SimpleTextEditor editor(batchRenderer,
+                          editor_position,
+                          fontSize,
+                          textColor,
+                          cursorColor,
+                          selectionColor,
+                          lineNumberColor);
+
+  editor.projectConfigPath = "project_config.json";
+  editor.loadProjectConfig();
+  renderTarget.SetSampleCount(editor.msaaSamples());
+  batchRenderer.SetTarget(renderTarget.Format(), renderTarget.SampleCount());
+
+  if (!options.file.empty()) {
+    editor.loadTextFromFile(options.file);
+  }
+
+  // the status bar is left out, it shows frame statistics that differ from
+  // run to run
+  std::vector<FrameTiming> timings;
+  std::vector<double> gpu; // render pass times as they come back
+  batchRenderer.onGpuTime = [&](float ms) { gpu.push_back(ms); };
+  uint64_t frequency = SDL_GetPerformanceFrequency();
+  auto ms = [frequency](Uint64 from, Uint64 to) {
+    return (double)(to - from) * 1000.0 / frequency;
+  };
+  auto drawFrame = [&](float deltaTime, size_t line) {
+    // the worker's wakeups only matter to a loop that sleeps
+    SDL_Event e;
+    while (SDL_PollEvent(&e)) {
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    editor.update(deltaTime);
+    Uint64 updated = SDL_GetPerformanceCounter();
+
+    renderTarget.Acquire();
+    WGPUCommandEncoder encoder =
+      wgpuDeviceCreateCommandEncoder(device, nullptr);
+
+    Vector4 clearColor = RGBA32(0x2B2A33);
+    WGPURenderPassColorAttachment colorAttachment =
+      renderTarget.ColorAttachment(
+        { clearColor.x, clearColor.y, clearColor.z, clearColor.w });
+
+    WGPURenderPassDescriptor renderPassDesc = {};
+    renderPassDesc.colorAttachmentCount = 1;
+    renderPassDesc.colorAttachments = &colorAttachment;
+    renderPassDesc.timestampWrites = batchRenderer.PassTimestamps();
+
+    WGPURenderPassEncoder passEncoder =
+      wgpuCommandEncoderBeginRenderPass(encoder, &renderPassDesc);
+    editor.render(batchRenderer);
+    batchRenderer.Render(passEncoder);
+    wgpuRenderPassEncoderEnd(passEncoder);
+    wgpuRenderPassEncoderRelease(passEncoder);
+    batchRenderer.ResolveTimestamps(encoder);
+
+    WGPUCommandBufferDescriptor cmdBufferDesc = {};
+    WGPUCommandBuffer commandBuffer =
+      wgpuCommandEncoderFinish(encoder, &cmdBufferDesc);
+    Uint64 rendered = SDL_GetPerformanceCounter();
+
+    wgpuQueueSubmit(queue, 1, &commandBuffer);
+    batchRenderer.FrameSubmitted();
+    renderTarget.Present();
+    wgpuCommandBufferRelease(commandBuffer);
+    wgpuCommandEncoderRelease(encoder);
+
+    // there's no present to drive the device, fences are polled here
+    wgpuDevicePoll(device, false, nullptr);
+    Uint64 submitted = SDL_GetPerformanceCounter();
+
+    timings.push_back({ line,
+                        ms(start, updated),
+                        ms(updated, rendered),
+                        ms(rendered, submitted) });
+  };
+
+  bool settled = true;
+  for (const ScriptAction& action : actions) {
+    SDL_Event event = {};
+    switch (action.kind) {
+      case ScriptAction::Open:
+        editor.loadTextFromFile(action.text);
+        break;
+
+      case ScriptAction::Type:
+        event.type = SDL_EVENT_TEXT_INPUT;
+        event.text.text = action.text.c_str();
+        editor.handleInput(event);
+        break;
+
+      case ScriptAction::Key:
+        // the editor reads modifiers from the keyboard state
+        SDL_SetModState(action.mods);
+        event.type = SDL_EVENT_KEY_DOWN;
+        event.key.key = action.key;
+        event.key.mod = action.mods;
+        event.key.down = SDL_TRUE;
+        for (int32_t i = 0; i < action.count; ++i) {
+          editor.handleInput(event);
+        }
+        SDL_SetModState(SDL_KMOD_NONE);
+        break;
+
+      case ScriptAction::Wheel:
+        event.type = SDL_EVENT_MOUSE_WHEEL;
+        event.wheel.y = action.amount;
+        editor.handleInput(event);
+        break;
+
+      case ScriptAction::Frame:
+        for (int32_t i = 0; i < action.count; ++i) {
+          drawFrame(FRAME_SECONDS, action.line);
+        }
+        break;
+
+      case ScriptAction::Settle: {
+        // frames drawn while waiting don't move the clock, so the cursor
+        // blinks the same however long the worker takes
+        int32_t frames = 0;
+        do {
+          SDL_WaitEventTimeout(nullptr, 1);
+          drawFrame(0.0f, action.line);
+        } while (!editor.settled() && ++frames < SETTLE_MAX_FRAMES);
+        if (!editor.settled()) {
+          std::cerr << "Line " << action.line << ": the worker didn't settle"
+                    << "\n";
+          settled = false;
+        }
+      } break;
+    }
+  }
+
+  // the last frame against the golden image, as RGB
+  std::vector<uint8_t> pixels;
+  std::vector<uint8_t> rgb;
+  nlohmann::json golden = { { "path", options.golden } };
+  bool matched = true;
+  if (options.golden.empty()) {
+    golden["status"] = "skipped";
+  } else if (!renderTarget.ReadPixels(pixels)) {
+    golden["status"] = "unreadable";
+    matched = false;
+  } else {
+    bool bgra = renderTarget.Format() == WGPUTextureFormat_BGRA8Unorm ||
+                renderTarget.Format() == WGPUTextureFormat_BGRA8UnormSrgb;
+    rgb.resize(pixels.size() / 4 * 3);
+    for (size_t i = 0, o = 0; i < pixels.size(); i += 4, o += 3) {
+      rgb[o + 0] = pixels[i + (bgra ? 2 : 0)];
+      rgb[o + 1] = pixels[i + 1];
+      rgb[o + 2] = pixels[i + (bgra ? 0 : 2)];
+    }
+
+    uint32_t goldenWidth, goldenHeight;
+    std::vector<uint8_t> expected;
+    if (!std::filesystem::exists(options.golden)) {
+      golden["status"] = "recorded";
+      matched = WritePpm(
+        options.golden, renderTarget.Width(), renderTarget.Height(), rgb);
+    } else if (!ReadPpm(options.golden, goldenWidth, goldenHeight, expected) ||
+               goldenWidth != renderTarget.Width() ||
+               goldenHeight != renderTarget.Height()) {
+      golden["status"] = "size mismatch";
+      matched = false;
+    } else {
+      size_t differing = 0;
+      int32_t maxDifference = 0;
+      for (size_t i = 0; i < rgb.size(); i += 3) {
+        int32_t difference = 0;
+        for (size_t c = 0; c < 3; ++c) {
+          difference = std::max(difference, abs(rgb[i + c] - expected[i + c]));
+        }
+        maxDifference = std::max(maxDifference, difference);
+        differing += difference > GOLDEN_TOLERANCE;
+      }
+      size_t pixelCount = rgb.size() / 3;
+      matched = differing <= pixelCount * GOLDEN_MAX_DIFFERING;
+      golden["status"] = matched ? "match" : "mismatch";
+      golden["differing_pixels"] = differing;
+      golden["max_difference"] = maxDifference;
+    }
+
+    // what was drawn instead, to look at next to the golden image
+    if (!matched) {
+      std::string actual = options.golden + ".actual.ppm";
+      WritePpm(actual, renderTarget.Width(), renderTarget.Height(), rgb);
+      golden["actual"] = actual;
+    }
+  }
+
+  nlohmann::json frames = nlohmann::json::array();
+  std::vector<double> cpu;
+  for (const FrameTiming& timing : timings) {
+    double total = timing.updateMs + timing.renderMs + timing.submitMs;
+    cpu.push_back(total);
+    frames.push_back({ { "line", timing.line },
+                       { "update_ms", timing.updateMs },
+                       { "render_ms", timing.renderMs },
+                       { "submit_ms", timing.submitMs },
+                       { "cpu_ms", total } });
+  }
+
+  double sum = 0.0;
+  for (double value : cpu) {
+    sum += value;
+  }
+  nlohmann::json report = {
+    { "width", renderTarget.Width() },
+    { "height", renderTarget.Height() },
+    { "samples", renderTarget.SampleCount() },
+    { "file", options.file },
+    { "script", options.script },
+    { "settled", settled },
+    { "summary",
+      { { "frames", cpu.size() },
+        { "mean_ms", cpu.empty() ? 0.0 : sum / cpu.size() },
+        { "p50_ms", Percentile(cpu, 0.50) },
+        { "p99_ms", Percentile(cpu, 0.99) },
+        { "max_ms", Percentile(cpu, 1.0) },
+        { "gpu_frames", gpu.size() },
+        { "gpu_p50_ms", Percentile(gpu, 0.50) },
+        { "gpu_p99_ms", Percentile(gpu, 0.99) },
+        { "dropped_quads", batchRenderer.DroppedQuads() } } },
+    { "golden", golden },
+    { "frames", frames },
+  };
+
+  std::ofstream reportFile(options.report);
+  reportFile << report.dump(2) << "\n";
+  if (!reportFile) {
+    std::cerr << "Unable to write report " << options.report << "\n";
+    return 1;
+  }
+
+  std::cout << "headless: " << cpu.size() << " frames, p50 "
+            << Percentile(cpu, 0.50) << " ms, p99 " << Percentile(cpu, 0.99)
+            << " ms, golden " << golden["status"].get<std::string>()
+            << ", report in " << options.report << "\n";
+  return matched && settled ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+/**
+ * $file Headless.h
+ */
+#pragma once
+
+#include "webgpu/webgpu.h"
+#include "wgpu/wgpu.h"
+#include <stdint.h>
+#include <string>
+
+// `--headless WxH` runs the editor without a window, frames go into an
+// offscreen texture. A script of editor actions is replayed one per line,
+// blank lines and lines starting with # are skipped:
+//
+//   open PATH               loads a file
+//   type TEXT               text input, the rest of the line
+//   key [MOD+]...NAME [N]   key press N times, SDL key names (Return, Down,
+//                           D), modifiers ctrl, shift and alt
+//   wheel DY                mouse wheel
+//   frame [N]               draws N frames, 1/60 s apart
+//   settle                  draws frames without moving the clock until the
+//                           background worker caught up with every edit
+//
+// Without a script the file is drawn once settled. The frames' CPU timings
+// go into a JSON report and the last frame is compared with a golden image
+// (binary PPM), which is written when it doesn't exist yet.
+struct HeadlessOptions
+{
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::string file; // opened before the script runs, if any
+  std::string script;
+  std::string golden;
+  std::string report = "headless_report.json";
+};
+
+// "WxH" into the options, false when it isn't a size
+bool
+ParseHeadlessSize(const char* text, HeadlessOptions& options);
+
+// the exit code: 0 when the script ran and the last frame matches the
+// golden image
+int
+RunHeadless(WGPUDevice device, WGPUQueue queue, const HeadlessOptions& options);
@@ -0,0 +1,375 @@
+#include "LineIndex.h"
+
+#include <string.h>
+
+LineIndex::LineIndex()
+{
+  nodes.push_back({ 0, 0, 0, 0, 0, 0, 0, 0, 0 });
+  root = newNode(0);
+}
+
+uint32_t
+LineIndex::newNode(size_t length)
+{
+  // xorshift, treap priorities only need to be roughly uniform
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+
+  Node node = { 0, 0, seed, 1, length, length, nextSerial++, 1, 1 };
+  if (!freeNodes.empty()) {
+    uint32_t index = freeNodes.back();
+    freeNodes.pop_back();
+    nodes[index] = node;
+    return index;
+  }
+  nodes.push_back(node);
+  return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void
+LineIndex::freeTree(uint32_t node)
+{
+  if (!node) {
+    return;
+  }
+  freeTree(nodes[node].left);
+  freeTree(nodes[node].right);
+  freeNodes.push_back(node);
+}
+
+void
+LineIndex::update(uint32_t node)
+{
+  Node& n = nodes[node];
+  n.count = 1 + nodes[n.left].count + nodes[n.right].count;
+  n.sum = n.length + nodes[n.left].sum + nodes[n.right].sum;
+  n.rowSum = n.rows + nodes[n.left].rowSum + nodes[n.right].rowSum;
+}
+
+uint32_t
+LineIndex::merge(uint32_t a, uint32_t b)
+{
+  if (!a || !b) {
+    return a ? a : b;
+  }
+  if (nodes[a].priority > nodes[b].priority) {
+    nodes[a].right = merge(nodes[a].right, b);
+    update(a);
+    return a;
+  }
+  nodes[b].left = merge(a, nodes[b].left);
+  update(b);
+  return b;
+}
+
+// first `count` lines go to a, the rest to b
+void
+LineIndex::split(uint32_t node, size_t count, uint32_t& a, uint32_t& b)
+{
+  if (!node) {
+    a = b = 0;
+    return;
+  }
+  size_t leftCount = nodes[nodes[node].left].count;
+  if (count <= leftCount) {
+    split(nodes[node].left, count, a, nodes[node].left);
+    b = node;
+  } else {
+    split(nodes[node].right, count - leftCount - 1, nodes[node].right, b);
+    a = node;
+  }
+  update(node);
+}
+
+uint32_t
+LineIndex::buildFromLengths(const std::vector<size_t>& lengths)
+{
+  // cartesian tree over the priorities, O(n) for an already ordered list.
+  // The stack is the right spine, a node popped off it is complete.
+  std::vector<uint32_t> stack;
+
+  for (size_t length : lengths) {
+    uint32_t node = newNode(length);
+
+    uint32_t last = 0;
+    while (!stack.empty() &&
+           nodes[stack.back()].priority < nodes[node].priority) {
+      last = stack.back();
+      update(last);
+      stack.pop_back();
+    }
+    nodes[node].left = last;
+    if (!stack.empty()) {
+      nodes[stack.back()].right = node;
+    }
+    stack.push_back(node);
+  }
+
+  for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+    update(*it);
+  }
+  return stack.empty() ? 0 : stack.front();
+}
+
+void
+LineIndex::build(const PieceTable& text)
+{
+  freeTree(root);
+
+  std::vector<size_t> lengths;
+  size_t lineLength = 0;
+  text.forEachChunk([&](const char* data, size_t count) {
+    const char* end = data + count;
+    while (data < end) {
+      const char* newline =
+        static_cast<const char*>(memchr(data, '\n', end - data));
+      if (!newline) {
+        lineLength += end - data;
+        break;
+      }
+      lengths.push_back(lineLength + (newline + 1 - data));
+      lineLength = 0;
+      data = newline + 1;
+    }
+  });
+  lengths.push_back(lineLength);
+
+  root = buildFromLengths(lengths);
+}
+
+size_t
+LineIndex::lineCount() const
+{
+  return nodes[root].count;
+}
+
+size_t
+LineIndex::length() const
+{
+  return nodes[root].sum;
+}
+
+size_t
+LineIndex::lineAt(size_t position) const
+{
+  if (position >= length()) {
+    return lineCount() - 1;
+  }
+
+  size_t line = 0;
+  uint32_t node = root;
+  while (node) {
+    const Node& n = nodes[node];
+    if (position < nodes[n.left].sum) {
+      node = n.left;
+      continue;
+    }
+    position -= nodes[n.left].sum;
+    line += nodes[n.left].count;
+    if (position < n.length) {
+      return line;
+    }
+    position -= n.length;
+    line++;
+    node = n.right;
+  }
+  return lineCount() - 1;
+}
+
+size_t
+LineIndex::lineStart(size_t line) const
+{
+  size_t start = 0;
+  uint32_t node = root;
+  while (node) {
+    const Node& n = nodes[node];
+    size_t leftCount = nodes[n.left].count;
+    if (line < leftCount) {
+      node = n.left;
+    } else if (line == leftCount) {
+      return start + nodes[n.left].sum;
+    } else {
+      start += nodes[n.left].sum + n.length;
+      line -= leftCount + 1;
+      node = n.right;
+    }
+  }
+  return length();
+}
+
+size_t
+LineIndex::lineLength(size_t line) const
+{
+  uint32_t node = root;
+  while (node) {
+    const Node& n = nodes[node];
+    size_t leftCount = nodes[n.left].count;
+    if (line < leftCount) {
+      node = n.left;
+    } else if (line == leftCount) {
+      return n.length;
+    } else {
+      line -= leftCount + 1;
+      node = n.right;
+    }
+  }
+  return 0;
+}
+
+size_t
+LineIndex::lineEnd(size_t line) const
+{
+  size_t end = lineStart(line) + lineLength(line);
+  return line + 1 < lineCount() ? end - 1 : end;
+}
+
+LineIndex::LineKey
+LineIndex::lineKey(size_t line) const
+{
+  uint32_t node = root;
+  while (node) {
+    const Node& n = nodes[node];
+    size_t leftCount = nodes[n.left].count;
+    if (line < leftCount) {
+      node = n.left;
+    } else if (line == leftCount) {
+      return { node, n.serial };
+    } else {
+      line -= leftCount + 1;
+      node = n.right;
+    }
+  }
+  return { 0, 0 };
+}
+
+size_t
+LineIndex::rowCount() const
+{
+  return nodes[root].rowSum;
+}
+
+size_t
+LineIndex::firstRow(size_t line) const
+{
+  size_t row = 0;
+  uint32_t node = root;
+  while (node) {
+    const Node& n = nodes[node];
+    size_t leftCount = nodes[n.left].count;
+    if (line < leftCount) {
+      node = n.left;
+    } else if (line == leftCount) {
+      return row + nodes[n.left].rowSum;
+    } else {
+      row += nodes[n.left].rowSum + n.rows;
+      line -= leftCount + 1;
+      node = n.right;
+    }
+  }
+  return rowCount();
+}
+
+size_t
+LineIndex::lineAtRow(size_t row) const
+{
+  if (row >= rowCount()) {
+    return lineCount() - 1;
+  }
+
+  size_t line = 0;
+  uint32_t node = root;
+  while (node) {
+    const Node& n = nodes[node];
+    if (row < nodes[n.left].rowSum) {
+      node = n.left;
+      continue;
+    }
+    row -= nodes[n.left].rowSum;
+    line += nodes[n.left].count;
+    if (row < n.rows) {
+      return line;
+    }
+    row -= n.rows;
+    line++;
+    node = n.right;
+  }
+  return lineCount() - 1;
+}
+
+void
+LineIndex::setRows(uint32_t node, size_t line, uint32_t rows)
+{
+  Node& n = nodes[node];
+  size_t leftCount = nodes[n.left].count;
+  if (line < leftCount) {
+    setRows(n.left, line, rows);
+  } else if (line == leftCount) {
+    n.rows = rows;
+  } else {
+    setRows(n.right, line - leftCount - 1, rows);
+  }
+  update(node);
+}
+
+void
+LineIndex::setLineRows(size_t line, uint32_t rows)
+{
+  if (line < lineCount()) {
+    setRows(root, line, rows);
+  }
+}
+
+void
+LineIndex::insert(size_t position, const char* s, size_t count)
+{
+  if (count == 0) {
+    return;
+  }
+
+  size_t line = lineAt(position);
+  size_t offset = position - lineStart(line);
+  size_t oldLength = lineLength(line);
+
+  std::vector<size_t> lengths;
+  size_t segmentStart = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (s[i] == '\n') {
+      lengths.push_back(i + 1 - segmentStart);
+      segmentStart = i + 1;
+    }
+  }
+
+  if (lengths.empty()) {
+    lengths.push_back(oldLength + count);
+  } else {
+    lengths.front() += offset;
+    lengths.push_back((count - segmentStart) + (oldLength - offset));
+  }
+
+  uint32_t head, rest, old, tail;
+  split(root, line, head, rest);
+  split(rest, 1, old, tail);
+  freeTree(old);
+  root = merge(merge(head, buildFromLengths(lengths)), tail);
+}
+
+void
+LineIndex::erase(size_t position, size_t count)
+{
+  if (count == 0) {
+    return;
+  }
+
+  size_t first = lineAt(position);
+  size_t last = lineAt(position + count);
+  size_t firstStart = lineStart(first);
+  size_t lastEnd = lineStart(last) + lineLength(last);
+  size_t merged = lastEnd - firstStart - count;
+
+  uint32_t head, rest, old, tail;
+  split(root, first, head, rest);
+  split(rest, last - first + 1, old, tail);
+  freeTree(old);
+  root = merge(merge(head, newNode(merged)), tail);
+}
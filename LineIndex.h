@@ -0,0 +1,86 @@
+/**
+ * $file LineIndex.h
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "PieceTable.h"
+
+// Logical line starts of the editor buffer, kept in an implicit treap keyed by
+// line order with subtree byte sums. Position<->line queries and the updates
+// done on every insert/erase are O(log n) and never touch the buffer itself.
+//
+// Every line owns its '\n', so a buffer with k newlines has k + 1 lines and
+// the last one may be empty.
+class LineIndex
+{
+public:
+  LineIndex();
+
+  void build(const PieceTable& text);
+
+  // mirror every buffer edit, positions are in the coordinates the buffer
+  // had right before that edit
+  void insert(size_t position, const char* s, size_t count);
+  void erase(size_t position, size_t count);
+
+  size_t lineCount() const;
+  size_t length() const;
+
+  size_t lineAt(size_t position) const;
+  size_t lineStart(size_t line) const;
+  size_t lineLength(size_t line) const; // including the '\n'
+
+  // position of the line's '\n', or the buffer end for the last line
+  size_t lineEnd(size_t line) const;
+
+  // Identity of a line's current contents. The slot is stable while the line
+  // is untouched, every edit of the line gives it a new serial, so side
+  // tables indexed by slot can tell when their entry went stale.
+  struct LineKey
+  {
+    uint32_t slot;
+    uint32_t serial;
+  };
+  LineKey lineKey(size_t line) const;
+  size_t slotCount() const { return nodes.size(); }
+
+  // visual rows per line as set by the wrap layout, lines that were never
+  // laid out count as one row
+  size_t rowCount() const;
+  size_t firstRow(size_t line) const;
+  size_t lineAtRow(size_t row) const;
+  void setLineRows(size_t line, uint32_t rows);
+
+private:
+  struct Node
+  {
+    uint32_t left;
+    uint32_t right;
+    uint32_t priority;
+    uint32_t count; // lines in this subtree
+    size_t length;  // bytes of this line
+    size_t sum;     // bytes in this subtree
+    uint32_t serial;
+    uint32_t rows;  // visual rows of this line
+    size_t rowSum;  // visual rows in this subtree
+  };
+
+  uint32_t newNode(size_t length);
+  void freeTree(uint32_t node);
+  void update(uint32_t node);
+  uint32_t merge(uint32_t a, uint32_t b);
+  void split(uint32_t node, size_t count, uint32_t& a, uint32_t& b);
+  void setRows(uint32_t node, size_t line, uint32_t rows);
+  uint32_t buildFromLengths(const std::vector<size_t>& lengths);
+
+  // node 0 is the null sentinel
+  std::vector<Node> nodes;
+  std::vector<uint32_t> freeNodes;
+  uint32_t root = 0;
+  uint32_t seed = 0x9E3779B9u;
+  uint32_t nextSerial = 1;
+};
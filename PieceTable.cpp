@@ -0,0 +1,258 @@
+#include "PieceTable.h"
+
+#include <algorithm>
+#include <string.h>
+
+PieceTable::Iterator&
+PieceTable::Iterator::operator++()
+{
+  pos++;
+  offset++;
+  if (offset >= table->pieces[piece].length) {
+    piece++;
+    offset = 0;
+  }
+  return *this;
+}
+
+PieceTable::Iterator&
+PieceTable::Iterator::operator--()
+{
+  pos--;
+  if (offset == 0) {
+    piece--;
+    offset = table->pieces[piece].length;
+  }
+  offset--;
+  return *this;
+}
+
+PieceTable::PieceTable()
+  : original(std::make_shared<const std::string>())
+{
+}
+
+PieceTable::PieceTable(std::string original)
+{
+  assign(std::move(original));
+}
+
+void
+PieceTable::assign(std::string text)
+{
+  original = std::make_shared<const std::string>(std::move(text));
+  appendBlocks.clear();
+  pieces.clear();
+  starts.clear();
+  totalLength = original->size();
+
+  if (totalLength > 0) {
+    pieces.push_back({ original->data(), totalLength });
+    starts.push_back(0);
+  }
+}
+
+PieceTable
+PieceTable::snapshot() const
+{
+  PieceTable copy;
+  copy.original = original;
+  copy.appendBlocks = appendBlocks;
+  copy.pieces = pieces;
+  copy.starts = starts;
+  copy.totalLength = totalLength;
+
+  // this table keeps appending to its last block, the copy must not
+  if (!copy.appendBlocks.empty()) {
+    copy.appendBlocks.back().capacity = copy.appendBlocks.back().size;
+  }
+  return copy;
+}
+
+// index of the piece holding pos, pieces.size() when pos is the end
+size_t
+PieceTable::findPiece(size_t pos) const
+{
+  if (pos >= totalLength) {
+    return pieces.size();
+  }
+  if (lastPiece < pieces.size() && pos >= starts[lastPiece] &&
+      pos < starts[lastPiece] + pieces[lastPiece].length) {
+    return lastPiece;
+  }
+  auto it = std::upper_bound(starts.begin(), starts.end(), pos);
+  lastPiece = static_cast<size_t>(it - starts.begin()) - 1;
+  return lastPiece;
+}
+
+const char*
+PieceTable::append(const char* s, size_t count)
+{
+  if (appendBlocks.empty() ||
+      appendBlocks.back().size + count > appendBlocks.back().capacity) {
+    size_t capacity = std::max(count, APPEND_BLOCK_SIZE);
+    appendBlocks.push_back(
+      { std::shared_ptr<char[]>(new char[capacity]), 0, capacity });
+  }
+
+  Block& block = appendBlocks.back();
+  char* dst = block.data.get() + block.size;
+  memcpy(dst, s, count);
+  block.size += count;
+  return dst;
+}
+
+void
+PieceTable::updateStarts(size_t fromPiece)
+{
+  starts.resize(pieces.size());
+  size_t offset = fromPiece > 0
+                    ? starts[fromPiece - 1] + pieces[fromPiece - 1].length
+                    : 0;
+  for (size_t i = fromPiece; i < pieces.size(); ++i) {
+    starts[i] = offset;
+    offset += pieces[i].length;
+  }
+}
+
+char
+PieceTable::at(size_t pos) const
+{
+  size_t i = findPiece(pos);
+  return pieces[i].data[pos - starts[i]];
+}
+
+std::string
+PieceTable::substr(size_t pos, size_t count) const
+{
+  if (pos >= totalLength) {
+    return std::string();
+  }
+  count = std::min(count, totalLength - pos);
+
+  std::string result;
+  result.reserve(count);
+
+  size_t i = findPiece(pos);
+  size_t offset = pos - starts[i];
+  while (count > 0) {
+    size_t n = std::min(count, pieces[i].length - offset);
+    result.append(pieces[i].data + offset, n);
+    count -= n;
+    offset = 0;
+    i++;
+  }
+  return result;
+}
+
+std::string_view
+PieceTable::view(size_t pos, size_t count, std::string& scratch) const
+{
+  if (pos >= totalLength) {
+    return std::string_view();
+  }
+  count = std::min(count, totalLength - pos);
+
+  size_t i = findPiece(pos);
+  size_t offset = pos - starts[i];
+  if (count <= pieces[i].length - offset) {
+    return std::string_view(pieces[i].data + offset, count);
+  }
+
+  scratch.clear();
+  while (count > 0) {
+    size_t n = std::min(count, pieces[i].length - offset);
+    scratch.append(pieces[i].data + offset, n);
+    count -= n;
+    offset = 0;
+    i++;
+  }
+  return scratch;
+}
+
+void
+PieceTable::insert(size_t pos, const char* s, size_t count)
+{
+  if (count == 0) {
+    return;
+  }
+  pos = std::min(pos, totalLength);
+
+  size_t i = findPiece(pos);
+  size_t offset = i < pieces.size() ? pos - starts[i] : 0;
+
+  // typing right after the previous insertion just grows that piece
+  if (offset == 0 && i > 0 && !appendBlocks.empty()) {
+    Piece& prev = pieces[i - 1];
+    const Block& block = appendBlocks.back();
+    if (prev.data + prev.length == block.data.get() + block.size &&
+        block.size + count <= block.capacity) {
+      append(s, count);
+      prev.length += count;
+      totalLength += count;
+      updateStarts(i);
+      return;
+    }
+  }
+
+  Piece inserted = { append(s, count), count };
+
+  if (offset == 0) {
+    pieces.insert(pieces.begin() + i, inserted);
+  } else {
+    Piece left = { pieces[i].data, offset };
+    Piece right = { pieces[i].data + offset, pieces[i].length - offset };
+    pieces[i] = left;
+    Piece tail[2] = { inserted, right };
+    pieces.insert(pieces.begin() + i + 1, tail, tail + 2);
+  }
+
+  totalLength += count;
+  updateStarts(i);
+}
+
+void
+PieceTable::erase(size_t pos, size_t count)
+{
+  if (pos >= totalLength || count == 0) {
+    return;
+  }
+  count = std::min(count, totalLength - pos);
+  size_t end = pos + count;
+
+  size_t first = findPiece(pos);
+  size_t last = findPiece(end - 1);
+
+  size_t headLength = pos - starts[first];
+  size_t tailOffset = end - starts[last];
+
+  Piece head = { pieces[first].data, headLength };
+  Piece tail = { pieces[last].data + tailOffset,
+                 pieces[last].length - tailOffset };
+
+  Piece keep[2];
+  size_t keepCount = 0;
+  if (head.length > 0) {
+    keep[keepCount++] = head;
+  }
+  if (tail.length > 0) {
+    keep[keepCount++] = tail;
+  }
+
+  pieces.erase(pieces.begin() + first, pieces.begin() + last + 1);
+  pieces.insert(pieces.begin() + first, keep, keep + keepCount);
+
+  totalLength -= count;
+  updateStarts(first);
+}
+
+PieceTable::Iterator
+PieceTable::iteratorAt(size_t pos) const
+{
+  Iterator it;
+  it.table = this;
+  it.pos = std::min(pos, totalLength);
+  it.piece = findPiece(it.pos);
+  it.offset = it.piece < pieces.size() ? it.pos - starts[it.piece] : 0;
+  return it;
+}
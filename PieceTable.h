@@ -0,0 +1,149 @@
+/**
+ * $file PieceTable.h
+ */
+#pragma once
+
+#include <iterator>
+#include <memory>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Text storage for the editor buffer. The loaded file lives untouched in the
+// original block, everything typed afterwards goes to an append-only buffer
+// and the document is described by a list of pieces pointing into either.
+// Edits only touch the piece list, so their cost does not depend on the file
+// size.
+class PieceTable
+{
+public:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  class Iterator
+  {
+  public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = char;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const char*;
+    using reference = const char&;
+
+    Iterator() = default;
+
+    reference operator*() const { return table->pieces[piece].data[offset]; }
+    size_t position() const { return pos; }
+
+    Iterator& operator++();
+    Iterator& operator--();
+    Iterator operator++(int)
+    {
+      Iterator it = *this;
+      ++*this;
+      return it;
+    }
+    Iterator operator--(int)
+    {
+      Iterator it = *this;
+      --*this;
+      return it;
+    }
+
+    bool operator==(const Iterator& other) const { return pos == other.pos; }
+    bool operator!=(const Iterator& other) const { return pos != other.pos; }
+
+  private:
+    friend class PieceTable;
+
+    const PieceTable* table = nullptr;
+    size_t piece = 0;
+    size_t offset = 0;
+    size_t pos = 0;
+  };
+
+  PieceTable();
+  explicit PieceTable(std::string original);
+
+  // pieces point into blocks owned by this table, copies would alias them
+  PieceTable(const PieceTable&) = delete;
+  PieceTable& operator=(const PieceTable&) = delete;
+  PieceTable(PieceTable&&) = default;
+  PieceTable& operator=(PieceTable&&) = default;
+
+  // Read-only copy of the current document for another thread. It shares the
+  // blocks, which only ever grow past what the snapshot points at, and
+  // copies just the piece list. Inserting into the snapshot starts blocks of
+  // its own.
+  PieceTable snapshot() const;
+
+  // replaces the whole document, dropping the edit history of the pieces
+  void assign(std::string original);
+
+  size_t length() const { return totalLength; }
+  bool empty() const { return totalLength == 0; }
+
+  char at(size_t pos) const;
+  char operator[](size_t pos) const { return at(pos); }
+
+  std::string substr(size_t pos, size_t count = npos) const;
+
+  // points straight into the buffer when the range sits in one piece,
+  // otherwise the range is copied into `scratch`
+  std::string_view view(size_t pos,
+                        size_t count,
+                        std::string& scratch) const;
+
+  void insert(size_t pos, const char* s, size_t count);
+  void insert(size_t pos, const char* s) { insert(pos, s, strlen(s)); }
+  void insert(size_t pos, const std::string& s)
+  {
+    insert(pos, s.data(), s.size());
+  }
+  void erase(size_t pos, size_t count);
+
+  // calls fn(const char* data, size_t count) for each contiguous run
+  template<typename Fn>
+  void forEachChunk(Fn&& fn) const
+  {
+    for (const Piece& piece : pieces) {
+      fn(piece.data, piece.length);
+    }
+  }
+
+  Iterator begin() const { return iteratorAt(0); }
+  Iterator end() const { return iteratorAt(totalLength); }
+  Iterator iteratorAt(size_t pos) const;
+
+  size_t pieceCount() const { return pieces.size(); }
+
+private:
+  struct Piece
+  {
+    const char* data;
+    size_t length;
+  };
+
+  // blocks never reallocate once created, so pieces can keep raw pointers
+  struct Block
+  {
+    std::shared_ptr<char[]> data;
+    size_t size;
+    size_t capacity;
+  };
+
+  static constexpr size_t APPEND_BLOCK_SIZE = 64 * 1024;
+
+  size_t findPiece(size_t pos) const;
+  const char* append(const char* s, size_t count);
+  void updateStarts(size_t fromPiece);
+
+  std::shared_ptr<const std::string> original;
+  std::vector<Block> appendBlocks;
+  std::vector<Piece> pieces;
+  std::vector<size_t> starts; // document offset of every piece
+  size_t totalLength = 0;
+
+  // sequential at() calls mostly land in the same piece as the last one
+  mutable size_t lastPiece = 0;
+};
@@ -0,0 +1,123 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+
+std::mutex Profiler::threadsMutex;
+std::vector<std::unique_ptr<Profiler::ThreadZones>> Profiler::threads;
+
+uint64_t
+Profiler::Now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+Profiler::ThreadZones&
+Profiler::Local()
+{
+  thread_local ThreadZones* local = nullptr;
+  if (!local) {
+    auto zones = std::make_unique<ThreadZones>();
+    zones->zones.resize(ZONES_PER_THREAD);
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    zones->id = static_cast<uint32_t>(threads.size() + 1);
+    local = zones.get();
+    threads.push_back(std::move(zones));
+  }
+  return *local;
+}
+
+void
+Profiler::Record(const char* name, uint64_t start, uint64_t end)
+{
+  ThreadZones& local = Local();
+  uint64_t written = local.written.load(std::memory_order_relaxed);
+  local.zones[written % ZONES_PER_THREAD] = { name, start, end };
+  local.written.store(written + 1, std::memory_order_release);
+}
+
+void
+Profiler::SetThreadName(const char* name)
+{
+  ThreadZones& local = Local();
+  std::lock_guard<std::mutex> lock(threadsMutex);
+  local.name = name;
+}
+
+bool
+Profiler::WriteTrace(const std::string& path)
+{
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(threadsMutex);
+
+  // timestamps go out in microseconds from the oldest zone
+  std::vector<std::vector<Zone>> copies(threads.size());
+  uint64_t origin = UINT64_MAX;
+  for (size_t t = 0; t < threads.size(); ++t) {
+    ThreadZones& zones = *threads[t];
+    uint64_t end = zones.written.load(std::memory_order_acquire);
+    uint64_t begin = end > ZONES_PER_THREAD ? end - ZONES_PER_THREAD : 0;
+    std::vector<Zone>& copy = copies[t];
+    for (uint64_t i = begin; i < end; ++i) {
+      copy.push_back(zones.zones[i % ZONES_PER_THREAD]);
+    }
+
+    // the thread kept writing, zones it went round onto are dropped, and
+    // so is the one it may be writing right now
+    uint64_t after = zones.written.load(std::memory_order_acquire);
+    if (after + 1 > ZONES_PER_THREAD && after + 1 - ZONES_PER_THREAD > begin) {
+      size_t lapped =
+        std::min<uint64_t>(after + 1 - ZONES_PER_THREAD - begin, copy.size());
+      copy.erase(copy.begin(), copy.begin() + lapped);
+    }
+    for (const Zone& zone : copy) {
+      origin = std::min(origin, zone.start);
+    }
+  }
+
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  bool first = true;
+  for (size_t t = 0; t < threads.size(); ++t) {
+    const ThreadZones& zones = *threads[t];
+    std::string name =
+      zones.name.empty() ? "thread " + std::to_string(zones.id) : zones.name;
+    fprintf(file,
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+            "\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",\n",
+            zones.id,
+            name.c_str());
+    first = false;
+    for (const Zone& zone : copies[t]) {
+      fprintf(file,
+              ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+              "\"ts\":%.3f,\"dur\":%.3f}",
+              zone.name,
+              zones.id,
+              (zone.start - origin) / 1000.0,
+              (zone.end - zone.start) / 1000.0);
+    }
+  }
+  fprintf(file, "\n]}\n");
+  return fclose(file) == 0;
+}
+
+float
+FrameSeries::Percentile(float percentile) const
+{
+  if (count == 0) {
+    return 0.0f;
+  }
+  float sorted[WINDOW];
+  std::copy(samples, samples + count, sorted);
+  size_t index = static_cast<size_t>(percentile * (count - 1) + 0.5f);
+  std::nth_element(sorted, sorted + index, sorted + count);
+  return sorted[index];
+}
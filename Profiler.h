@@ -0,0 +1,113 @@
+/**
+ * $file Profiler.h
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+// Scoped zones, PROFILE_ZONE("name") times the rest of the enclosing block.
+// Every thread writes its zones into a ring of ZONES_PER_THREAD of its own,
+// a store and a release of the count a zone, no locks. The ring is
+// registered once per thread and kept for the program's lifetime, so zones
+// of threads that are gone still make it into the trace.
+//
+// WriteTrace() copies what the rings hold into Chrome trace JSON
+// (chrome://tracing, ui.perfetto.dev). A zone overwritten while it's copied
+// is dropped.
+class Profiler
+{
+public:
+  static constexpr size_t ZONES_PER_THREAD = 1 << 16;
+
+  struct Zone
+  {
+    const char* name; // a literal, zones keep the pointer
+    uint64_t start;   // ns
+    uint64_t end;
+  };
+
+  static uint64_t Now();
+  static void Record(const char* name, uint64_t start, uint64_t end);
+
+  // shown for the calling thread in the trace
+  static void SetThreadName(const char* name);
+
+  static bool WriteTrace(const std::string& path);
+
+private:
+  struct ThreadZones
+  {
+    uint32_t id;
+    std::string name;
+    std::vector<Zone> zones;
+    std::atomic<uint64_t> written{ 0 };
+  };
+
+  static ThreadZones& Local();
+
+  // rings of every thread that recorded a zone, the mutex is only taken
+  // when a thread records its first one and by WriteTrace()
+  static std::mutex threadsMutex;
+  static std::vector<std::unique_ptr<ThreadZones>> threads;
+};
+
+class ProfileZone
+{
+public:
+  explicit ProfileZone(const char* name)
+    : name(name)
+    , start(Profiler::Now())
+  {
+  }
+  ~ProfileZone() { Profiler::Record(name, start, Profiler::Now()); }
+
+  ProfileZone(const ProfileZone&) = delete;
+  ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+  const char* name;
+  uint64_t start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#if PROFILER_ENABLED
+#define PROFILE_ZONE(name)                                                     \
+  ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+// The last WINDOW samples of a per-frame measure, in milliseconds
+class FrameSeries
+{
+public:
+  static constexpr size_t WINDOW = 240;
+
+  void Add(float ms)
+  {
+    samples[next] = ms;
+    next = (next + 1) % WINDOW;
+    count = count < WINDOW ? count + 1 : WINDOW;
+  }
+
+  // 0 without samples
+  float Percentile(float percentile) const;
+  size_t Count() const { return count; }
+
+private:
+  float samples[WINDOW] = {};
+  size_t next = 0;
+  size_t count = 0;
+};
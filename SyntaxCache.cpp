@@ -0,0 +1,81 @@
+#include "SyntaxCache.h"
+
+SyntaxCache::SyntaxCache(const PieceTable& text, const LineIndex& lines)
+  : text(text)
+  , lines(lines)
+{
+}
+
+SyntaxCache::LineSyntax&
+SyntaxCache::entryOf(size_t line)
+{
+  if (entries.size() < lines.slotCount()) {
+    entries.resize(lines.slotCount());
+  }
+  return entries[lines.lineKey(line).slot];
+}
+
+bool
+SyntaxCache::isCurrent(size_t line, LexState startState)
+{
+  LineSyntax& entry = entryOf(line);
+  return entry.serial == lines.lineKey(line).serial &&
+         entry.startState == startState;
+}
+
+LexState
+SyntaxCache::lexLine(size_t line, LexState startState)
+{
+  LineSyntax& entry = entryOf(line);
+  entry.serial = lines.lineKey(line).serial;
+  entry.startState = startState;
+
+  // lex a contiguous copy only when the line spans pieces
+  size_t length = lines.lineLength(line);
+  std::string_view source = text.view(lines.lineStart(line), length, scratch);
+
+  // the scratch list grows once to the longest line, entries only hold
+  // their own tokens
+  lexed.clear();
+  entry.endState = tokenizeLine(source, 0, length, startState, lexed);
+  entry.tokens.assignFitted(lexed);
+  return entry.endState;
+}
+
+void
+SyntaxCache::rebuild()
+{
+  LexState state = LexState::Normal;
+  for (size_t line = 0; line < lines.lineCount(); ++line) {
+    state = lexLine(line, state);
+  }
+}
+
+void
+SyntaxCache::update(size_t firstLine, size_t lastLine)
+{
+  size_t count = lines.lineCount();
+  LexState state =
+    firstLine > 0 ? entryOf(firstLine - 1).endState : LexState::Normal;
+
+  size_t line = firstLine;
+  for (; line <= lastLine && line < count; ++line) {
+    state = lexLine(line, state);
+  }
+
+  // the edit may have opened or closed a comment or string, carry the new
+  // state down until a line already starts in it
+  for (; line < count && !isCurrent(line, state); ++line) {
+    state = lexLine(line, state);
+  }
+}
+
+const TokenList&
+SyntaxCache::lineTokens(size_t line)
+{
+  LineSyntax& entry = entryOf(line);
+  if (entry.serial != lines.lineKey(line).serial) {
+    update(line, line);
+  }
+  return entryOf(line).tokens;
+}
@@ -0,0 +1,51 @@
+/**
+ * $file SyntaxCache.h
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "LineIndex.h"
+#include "PieceTable.h"
+#include "Tokenizer.h"
+
+// Tokens of every logical line together with the lexer state the line starts
+// and ends in, cached per line slot of the LineIndex. After an edit only the
+// touched lines are lexed again, followed by the lines below them until the
+// state at a line start matches what the cache already has.
+class SyntaxCache
+{
+public:
+  SyntaxCache(const PieceTable& text, const LineIndex& lines);
+
+  // lexes the whole buffer, after it was replaced
+  void rebuild();
+
+  // lines [firstLine, lastLine] were just edited
+  void update(size_t firstLine, size_t lastLine);
+
+  // token positions are relative to the line start
+  const TokenList& lineTokens(size_t line);
+
+private:
+  struct LineSyntax
+  {
+    uint32_t serial = 0;
+    LexState startState = LexState::Normal;
+    LexState endState = LexState::Normal;
+    TokenList tokens;
+  };
+
+  LineSyntax& entryOf(size_t line);
+  bool isCurrent(size_t line, LexState startState);
+  LexState lexLine(size_t line, LexState startState);
+
+  const PieceTable& text;
+  const LineIndex& lines;
+  std::vector<LineSyntax> entries; // by line slot
+  std::string scratch;
+  TokenList lexed; // a line's tokens before they're copied into its entry
+};
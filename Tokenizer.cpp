@@ -1,6 +1,6 @@
 #include "Tokenizer.h"
+#include "CharScan.h"
 #include <map>
-#include <unordered_set>
 
 std::map<SyntaxElementType, SyntaxStyle> syntaxStyles = {
   { SyntaxElementType::Keyword, { { 0.93f, 0.79f, 0.22f, 1.0f } } },
@@ -14,176 +14,244 @@ std::map<SyntaxElementType, SyntaxStyle> syntaxStyles = {
   { SyntaxElementType::Default, { { 0.78f, 0.78f, 0.78f, 1.0f } } }
 };
 
-inline const std::unordered_set<std::string> cKeywords = {
-  "auto",       "break",     "case",           "char",
-  "const",      "continue",  "default",        "do",
-  "double",     "else",      "enum",           "extern",
-  "float",      "for",       "goto",           "if",
-  "inline",     "int",       "long",           "register",
-  "restrict",   "return",    "short",          "signed",
-  "sizeof",     "static",    "struct",         "switch",
-  "typedef",    "union",     "unsigned",       "void",
-  "volatile",   "while",     "_Alignas",       "_Alignof",
-  "_Atomic",    "_Bool",     "_Complex",       "_Generic",
-  "_Imaginary", "_Noreturn", "_Static_assert", "_Thread_local",
-};
+// Scans a string or char literal body up to its closing quote, returns
+// false if the line ends first.
+template<typename Scan>
+static bool
+scanQuoted(std::string_view text, size_t& pos, size_t end, char quote)
+{
+  while (pos < end) {
+    pos += Scan::findEither(text.data() + pos, end - pos, quote, '\\');
+    if (pos == end) {
+      return false;
+    }
+    if (text[pos] == quote) {
+      pos++;
+      return true;
+    }
+    pos = pos + 1 < end ? pos + 2 : end; // skip the escaped character
+  }
+  return false;
+}
 
-inline const std::unordered_set<char> cOperators = {
-  '+', '-', '*', '/', '%', '=', '<', '>', '!', '&', '|', '^',
-  '~', '?', ':', '.', ',', ';', '(', ')', '{', '}', '[', ']'
-};
+// Moves `pos` past the '*/' closing a block comment, returns false and
+// stops at `end` if the line has none.
+static bool
+closeComment(std::string_view text, size_t& pos, size_t end)
+{
+  while (pos + 1 < end) {
+    const void* star = memchr(text.data() + pos, '*', end - pos - 1);
+    if (!star) {
+      break;
+    }
+    pos = static_cast<const char*>(star) - text.data();
+    if (text[pos + 1] == '/') {
+      pos += 2;
+      return true;
+    }
+    pos++;
+  }
+  pos = end;
+  return false;
+}
 
-std::vector<SyntaxToken>
-tokenize(const std::string& text)
+// A token never crosses the line's end, the editor lexes each line on its
+// own. `Scan` provides the character runs, see CharScan.h.
+template<typename Scan>
+static LexState
+lexLine(std::string_view text,
+        size_t start,
+        size_t end,
+        LexState state,
+        TokenList& tokens)
 {
-  std::vector<SyntaxToken> tokens;
-  size_t length = text.length();
-  size_t pos = 0;
+  auto push = [&](SyntaxElementType type, size_t from, size_t to) {
+    if (to > from) {
+      tokens.push(type, from - start, to - from);
+    }
+  };
 
-  while (pos < length) {
+  // content of the line before the '\n', for tokens that stop at it
+  size_t contentEnd = end;
+  if (contentEnd > start && text[contentEnd - 1] == '\n') {
+    contentEnd--;
+  }
+
+  size_t pos = start;
+
+  // finish whatever the previous line left open
+  switch (state) {
+    case LexState::BlockComment:
+      if (!closeComment(text, pos, end)) {
+        push(SyntaxElementType::Comment, start, end);
+        return LexState::BlockComment;
+      }
+      push(SyntaxElementType::Comment, start, pos);
+      break;
+    case LexState::String:
+    case LexState::CharLiteral: {
+      bool string = state == LexState::String;
+      bool closed = scanQuoted<Scan>(text, pos, end, string ? '"' : '\'');
+      push(string ? SyntaxElementType::String : SyntaxElementType::CharLiteral,
+           start,
+           pos);
+      if (!closed) {
+        return state;
+      }
+      break;
+    }
+    case LexState::Preprocessor:
+      push(SyntaxElementType::Preprocessor, start, contentEnd);
+      pos = contentEnd;
+      if (contentEnd > start && text[contentEnd - 1] == '\\' &&
+          contentEnd < end) {
+        push(SyntaxElementType::Default, contentEnd, end);
+        return LexState::Preprocessor;
+      }
+      break;
+    case LexState::Normal:
+      break;
+  }
+
+  while (pos < end) {
     char c = text[pos];
+    uint8_t cls = charClasses[c];
 
     // skip whitespace
-    if (isspace(c)) {
-      size_t start = pos;
-      while (pos < length && isspace(text[pos])) {
-        pos++;
-      }
-      tokens.push_back(
-        { SyntaxElementType::Default, text.substr(start, pos - start), start });
+    if (cls & CHAR_SPACE) {
+      size_t from = pos;
+      pos += Scan::spaceRun(text.data() + pos, end - pos);
+      push(SyntaxElementType::Default, from, pos);
       continue;
     }
 
-    // comments
-    if (c == '/') {
-      if (pos + 1 < length) {
-        if (text[pos + 1] == '/') {
-          // single-line comment
-          size_t start = pos;
-          pos += 2;
-          while (pos < length && text[pos] != '\n') {
-            pos++;
-          }
-          tokens.push_back({ SyntaxElementType::Comment,
-                             text.substr(start, pos - start),
-                             start });
-          continue;
-        } else if (text[pos + 1] == '*') {
-          // multi-line comment
-          size_t start = pos;
-          pos += 2;
-          while (pos + 1 < length &&
-                 !(text[pos] == '*' && text[pos + 1] == '/')) {
-            pos++;
-          }
-          pos += 2; // skip '*/'
-          tokens.push_back({ SyntaxElementType::Comment,
-                             text.substr(start, pos - start),
-                             start });
-          continue;
-        }
-      }
+    // identifiers and keywords
+    if (cls & CHAR_IDENT_START) {
+      size_t from = pos;
+      pos += 1 + Scan::identifierRun(text.data() + pos + 1, end - pos - 1);
+      push(isKeyword(text.substr(from, pos - from))
+             ? SyntaxElementType::Keyword
+             : SyntaxElementType::Identifier,
+           from,
+           pos);
+      continue;
     }
 
-    // strings
-    if (c == '"') {
-      size_t start = pos;
-      pos++;
-      while (pos < length) {
-        if (text[pos] == '\\' && pos + 1 < length) {
-          pos += 2;
-        } else if (text[pos] == '"') {
-          pos++;
-          break;
-        } else {
-          pos++;
-        }
-      }
-      tokens.push_back(
-        { SyntaxElementType::String, text.substr(start, pos - start), start });
+    // number
+    if (cls & CHAR_DIGIT) {
+      size_t from = pos;
+      pos += 1 + Scan::numberRun(text.data() + pos + 1, end - pos - 1);
+      push(SyntaxElementType::Number, from, pos);
       continue;
     }
 
-    // characters
-    if (c == '\'') {
-      size_t start = pos;
-      pos++;
-      while (pos < length) {
-        if (text[pos] == '\\' && pos + 1 < length) {
-          pos += 2;
-        } else if (text[pos] == '\'') {
-          pos++;
-          break;
-        } else {
-          pos++;
+    // comments
+    if (c == '/' && pos + 1 < end) {
+      if (text[pos + 1] == '/') {
+        // single-line comment
+        push(SyntaxElementType::Comment, pos, contentEnd);
+        pos = contentEnd;
+        continue;
+      } else if (text[pos + 1] == '*') {
+        // multi-line comment
+        size_t from = pos;
+        pos += 2;
+        bool closed = closeComment(text, pos, end);
+        push(SyntaxElementType::Comment, from, pos);
+        if (!closed) {
+          return LexState::BlockComment;
         }
+        continue;
       }
-      tokens.push_back({ SyntaxElementType::CharLiteral,
-                         text.substr(start, pos - start),
-                         start });
-      continue;
     }
 
-    // preprocessor
-    if (c == '#' && (pos == 0 || text[pos - 1] == '\n')) {
-      size_t start = pos;
+    // strings and characters
+    if (c == '"' || c == '\'') {
+      size_t from = pos;
       pos++;
-      while (pos < length && text[pos] != '\n') {
-        pos++;
+      bool closed = scanQuoted<Scan>(text, pos, end, c);
+      bool string = c == '"';
+      push(string ? SyntaxElementType::String : SyntaxElementType::CharLiteral,
+           from,
+           pos);
+      if (!closed) {
+        return string ? LexState::String : LexState::CharLiteral;
       }
-      tokens.push_back({ SyntaxElementType::Preprocessor,
-                         text.substr(start, pos - start),
-                         start });
       continue;
     }
 
-    // identifiers and keywords
-    if (isalpha(c) || c == '_') {
-      size_t start = pos;
-      pos++;
-      while (pos < length && (isalnum(text[pos]) || text[pos] == '_')) {
-        pos++;
-      }
-      std::string word = text.substr(start, pos - start);
-      if (cKeywords.find(word) != cKeywords.end()) {
-        tokens.push_back({ SyntaxElementType::Keyword, word, start });
-      } else {
-        tokens.push_back({ SyntaxElementType::Identifier, word, start });
+    // preprocessor, a trailing '\' continues it on the next line
+    if (c == '#' && pos == start) {
+      push(SyntaxElementType::Preprocessor, pos, contentEnd);
+      pos = contentEnd;
+      if (text[contentEnd - 1] == '\\' && contentEnd < end) {
+        push(SyntaxElementType::Default, contentEnd, end);
+        return LexState::Preprocessor;
       }
       continue;
     }
 
-    // number
-    if (isdigit(c)) {
-      size_t start = pos;
+    if (cls & CHAR_OPERATOR) {
+      size_t from = pos;
       pos++;
-      bool isFloat = false;
-      while (pos < length && (isdigit(text[pos]) || text[pos] == '.')) {
-        if (text[pos] == '.')
-          isFloat = true;
+      if (pos < end && (charClasses[text[pos]] & CHAR_OPERATOR)) {
         pos++;
       }
-      (void*)isFloat;
-      tokens.push_back(
-        { SyntaxElementType::Number, text.substr(start, pos - start), start });
+      push(SyntaxElementType::Operator, from, pos);
       continue;
     }
 
-    if (cOperators.find(c) != cOperators.end()) {
-      size_t start = pos;
-      pos++;
-      if (pos < length && cOperators.find(text[pos]) != cOperators.end()) {
+    // text past ASCII stays in one token, whole codepoints are drawn from it
+    if (static_cast<unsigned char>(c) >= 0x80) {
+      size_t from = pos;
+      while (pos < end && static_cast<unsigned char>(text[pos]) >= 0x80) {
         pos++;
       }
-      tokens.push_back({ SyntaxElementType::Operator,
-                         text.substr(start, pos - start),
-                         start });
+      push(SyntaxElementType::Default, from, pos);
       continue;
     }
 
     // Any other character
-    tokens.push_back({ SyntaxElementType::Default, std::string(1, c), pos });
+    push(SyntaxElementType::Default, pos, pos + 1);
     pos++;
   }
+  return LexState::Normal;
+}
+
+LexState
+tokenizeLine(std::string_view text,
+             size_t start,
+             size_t end,
+             LexState state,
+             TokenList& tokens)
+{
+  return lexLine<TokenScan>(text, start, end, state, tokens);
+}
+
+LexState
+tokenizeLineScalar(std::string_view text,
+                   size_t start,
+                   size_t end,
+                   LexState state,
+                   TokenList& tokens)
+{
+  return lexLine<ScalarScan>(text, start, end, state, tokens);
+}
+
+TokenList
+tokenize(std::string_view text)
+{
+  TokenList tokens;
+  LexState state = LexState::Normal;
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = text.find('\n', start);
+    end = end == std::string_view::npos ? text.size() : end + 1;
+
+    size_t first = tokens.size();
+    state = tokenizeLine(text, start, end, state, tokens);
+    tokens.shift(first, start);
+    start = end;
+  }
   return tokens;
-}
\ No newline at end of file
+}
@@ -1,11 +1,13 @@
 #pragma once
 
+#include <stdint.h>
 #include <string.h>
 
 #include "Math.h"
+#include <string_view>
 #include <vector>
 
-enum class SyntaxElementType
+enum class SyntaxElementType : uint8_t
 {
   Keyword,
   Identifier,
@@ -26,9 +28,118 @@ struct SyntaxStyle
 struct SyntaxToken
 {
   SyntaxElementType type;
-  std::string text;
   size_t startPos;
+  size_t length;
 };
 
-std::vector<SyntaxToken>
-tokenize(const std::string& text);
+// Tokens kept as parallel arrays of type, start and length. Nothing is
+// allocated per token, cleared lists keep their capacity for the next run.
+// Positions are 32 bit, lists hold one line or a buffer below 4 GB.
+class TokenList
+{
+public:
+  size_t size() const { return types.size(); }
+  bool empty() const { return types.empty(); }
+
+  void reserve(size_t count)
+  {
+    types.reserve(count);
+    starts.reserve(count);
+    lengths.reserve(count);
+  }
+
+  void clear()
+  {
+    types.clear();
+    starts.clear();
+    lengths.clear();
+  }
+
+  void push(SyntaxElementType type, size_t start, size_t length)
+  {
+    types.push_back(type);
+    starts.push_back(static_cast<uint32_t>(start));
+    lengths.push_back(static_cast<uint32_t>(length));
+  }
+
+  SyntaxToken operator[](size_t i) const
+  {
+    return { types[i], starts[i], lengths[i] };
+  }
+
+  // copies `other` into arrays of exactly its size, for lists that are
+  // kept around. Arrays that already fit are reused.
+  void assignFitted(const TokenList& other)
+  {
+    if (types.capacity() == other.size()) {
+      types.assign(other.types.begin(), other.types.end());
+      starts.assign(other.starts.begin(), other.starts.end());
+      lengths.assign(other.lengths.begin(), other.lengths.end());
+      return;
+    }
+    types = std::vector<SyntaxElementType>(other.types);
+    starts = std::vector<uint32_t>(other.starts);
+    lengths = std::vector<uint32_t>(other.lengths);
+  }
+
+  // moves tokens [first, size()) by `offset`
+  void shift(size_t first, size_t offset)
+  {
+    for (size_t i = first; i < starts.size(); ++i) {
+      starts[i] += static_cast<uint32_t>(offset);
+    }
+  }
+
+  // index of the first token ending after `position`
+  size_t firstEndingAfter(size_t position) const
+  {
+    size_t lo = 0;
+    size_t hi = starts.size();
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (starts[mid] + lengths[mid] <= position) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+private:
+  std::vector<SyntaxElementType> types;
+  std::vector<uint32_t> starts;
+  std::vector<uint32_t> lengths;
+};
+
+// what the lexer is still inside of at a line boundary
+enum class LexState : uint8_t
+{
+  Normal,
+  BlockComment,
+  String,
+  CharLiteral,
+  Preprocessor
+};
+
+TokenList
+tokenize(std::string_view text);
+
+// Lexes the line [start, end), `end` is just past its '\n' (or the buffer
+// end). Appends tokens with positions relative to `start` and returns the
+// state the next line starts in. Runs are scanned with TokenScan.
+LexState
+tokenizeLine(std::string_view text,
+             size_t start,
+             size_t end,
+             LexState state,
+             TokenList& tokens);
+
+// Same lexer on the plain per-byte scanner, for benchmarks and checking the
+// vector paths against.
+LexState
+tokenizeLineScalar(std::string_view text,
+                   size_t start,
+                   size_t end,
+                   LexState state,
+                   TokenList& tokens);
@@ -0,0 +1,293 @@
+#include "UndoJournal.h"
+
+#include <algorithm>
+#include <string_view>
+
+// per group bookkeeping, so a flood of tiny edits is still bounded
+static constexpr size_t UNDO_GROUP_OVERHEAD = sizeof(UndoGroup);
+static constexpr size_t UNDO_EDIT_OVERHEAD = sizeof(UndoEdit);
+
+UndoJournal::UndoJournal(size_t maxBytes)
+  : maxBytes(maxBytes)
+{
+}
+
+void
+UndoJournal::seal()
+{
+  groupOpen = false;
+}
+
+void
+UndoJournal::record(size_t position,
+                    std::string removed,
+                    std::string inserted,
+                    size_t cursorBefore,
+                    bool typing)
+{
+  for (const UndoGroup& group : redoGroups) {
+    totalBytes -= group.bytes;
+  }
+  redoGroups.clear();
+
+  size_t editBytes = removed.size() + inserted.size();
+
+  if (groupOpen && !undoGroups.empty()) {
+    UndoGroup& group = undoGroups.back();
+    UndoEdit& last = group.edits.back();
+    bool adjacent = position == last.position + last.inserted.size();
+
+    if (typing && group.typing && adjacent) {
+      if (removed.empty()) {
+        last.inserted += inserted;
+      } else {
+        group.edits.push_back(
+          { position, std::move(removed), std::move(inserted) });
+        editBytes += UNDO_EDIT_OVERHEAD;
+      }
+      group.bytes += editBytes;
+      totalBytes += editBytes;
+      trim();
+      return;
+    }
+
+    if (!typing && !group.typing) {
+      group.edits.push_back(
+        { position, std::move(removed), std::move(inserted) });
+      editBytes += UNDO_EDIT_OVERHEAD;
+      group.bytes += editBytes;
+      totalBytes += editBytes;
+      trim();
+      return;
+    }
+  }
+
+  UndoGroup group;
+  group.edits.push_back({ position, std::move(removed), std::move(inserted) });
+  group.cursorBefore = cursorBefore;
+  group.typing = typing;
+  group.bytes = editBytes + UNDO_GROUP_OVERHEAD + UNDO_EDIT_OVERHEAD;
+
+  totalBytes += group.bytes;
+  undoGroups.push_back(std::move(group));
+  groupOpen = true;
+  trim();
+}
+
+const UndoGroup*
+UndoJournal::undo()
+{
+  groupOpen = false;
+  if (undoGroups.empty()) {
+    return nullptr;
+  }
+  redoGroups.push_back(std::move(undoGroups.back()));
+  undoGroups.pop_back();
+  return &redoGroups.back();
+}
+
+const UndoGroup*
+UndoJournal::redo()
+{
+  groupOpen = false;
+  if (redoGroups.empty()) {
+    return nullptr;
+  }
+  undoGroups.push_back(std::move(redoGroups.back()));
+  redoGroups.pop_back();
+  return &undoGroups.back();
+}
+
+void
+UndoJournal::clear()
+{
+  undoGroups.clear();
+  redoGroups.clear();
+  groupOpen = false;
+  totalBytes = 0;
+}
+
+void
+UndoJournal::trim()
+{
+  // the group being recorded is always kept, even if it alone is too big
+  while (totalBytes > maxBytes && undoGroups.size() > 1) {
+    totalBytes -= undoGroups.front().bytes;
+    undoGroups.pop_front();
+  }
+}
+
+// [diff]
+
+// beyond this many differing lines the diff falls back to one big hunk
+static constexpr int MAX_DIFF_DISTANCE = 4096;
+
+static std::vector<std::string_view>
+splitLines(const std::string& text)
+{
+  std::vector<std::string_view> lines;
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = text.find('\n', start);
+    end = end == std::string::npos ? text.size() : end + 1;
+    lines.emplace_back(text.data() + start, end - start);
+    start = end;
+  }
+  return lines;
+}
+
+// Myers' O((N+M)D) shortest edit script on the lines in [0, n) x [0, m).
+// Marks deleted lines of a and inserted lines of b, false if the scripts
+// distance exceeds MAX_DIFF_DISTANCE.
+static bool
+diffLines(const std::string_view* a,
+          int n,
+          const std::string_view* b,
+          int m,
+          std::vector<bool>& deleted,
+          std::vector<bool>& inserted)
+{
+  const int max = std::min(n + m, MAX_DIFF_DISTANCE);
+  const int offset = max + 1;
+  std::vector<int> v(2 * max + 3, 0);
+
+  // trace[d] holds v[-(d-1)..(d-1)] as it was before round d
+  std::vector<std::vector<int>> trace;
+  int distance = -1;
+
+  for (int d = 0; d <= max && distance < 0; ++d) {
+    if (d > 0) {
+      trace.emplace_back(v.begin() + offset - (d - 1),
+                         v.begin() + offset + d);
+    } else {
+      trace.emplace_back();
+    }
+
+    for (int k = -d; k <= d; k += 2) {
+      int x;
+      if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) {
+        x = v[offset + k + 1];
+      } else {
+        x = v[offset + k - 1] + 1;
+      }
+      int y = x - k;
+      while (x < n && y < m && a[x] == b[y]) {
+        x++;
+        y++;
+      }
+      v[offset + k] = x;
+      if (x >= n && y >= m) {
+        distance = d;
+        break;
+      }
+    }
+  }
+
+  if (distance < 0) {
+    return false;
+  }
+
+  auto traceAt = [&](int d, int k) { return trace[d][k + (d - 1)]; };
+
+  int x = n;
+  int y = m;
+  for (int d = distance; d > 0; --d) {
+    int k = x - y;
+    int prevK;
+    if (k == -d || (k != d && traceAt(d, k - 1) < traceAt(d, k + 1))) {
+      prevK = k + 1;
+    } else {
+      prevK = k - 1;
+    }
+    int prevX = traceAt(d, prevK);
+    int prevY = prevX - prevK;
+
+    while (x > prevX && y > prevY) {
+      x--;
+      y--;
+    }
+    if (x == prevX) {
+      inserted[prevY] = true;
+    } else {
+      deleted[prevX] = true;
+    }
+    x = prevX;
+    y = prevY;
+  }
+  return true;
+}
+
+std::vector<UndoEdit>
+diffText(const std::string& before, const std::string& after)
+{
+  std::vector<UndoEdit> edits;
+  if (before == after) {
+    return edits;
+  }
+
+  std::vector<std::string_view> a = splitLines(before);
+  std::vector<std::string_view> b = splitLines(after);
+
+  size_t prefix = 0;
+  while (prefix < a.size() && prefix < b.size() && a[prefix] == b[prefix]) {
+    prefix++;
+  }
+  size_t suffix = 0;
+  while (suffix < a.size() - prefix && suffix < b.size() - prefix &&
+         a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix]) {
+    suffix++;
+  }
+
+  int n = static_cast<int>(a.size() - prefix - suffix);
+  int m = static_cast<int>(b.size() - prefix - suffix);
+
+  std::vector<bool> deleted(n, false);
+  std::vector<bool> inserted(m, false);
+  if (!diffLines(
+        a.data() + prefix, n, b.data() + prefix, m, deleted, inserted)) {
+    std::fill(deleted.begin(), deleted.end(), true);
+    std::fill(inserted.begin(), inserted.end(), true);
+  }
+
+  auto offsetOf = [](const std::string& text,
+                     const std::vector<std::string_view>& lines,
+                     size_t index) {
+    return index < lines.size()
+             ? static_cast<size_t>(lines[index].data() - text.data())
+             : text.size();
+  };
+
+  // walk both sides in lockstep, unchanged lines pair up one to one
+  int i = 0;
+  int j = 0;
+  while (i < n || j < m) {
+    if (i < n && j < m && !deleted[i] && !inserted[j]) {
+      i++;
+      j++;
+      continue;
+    }
+
+    int aStart = i;
+    int bStart = j;
+    while (i < n && deleted[i]) {
+      i++;
+    }
+    while (j < m && inserted[j]) {
+      j++;
+    }
+
+    size_t removeFrom = offsetOf(before, a, prefix + aStart);
+    size_t removeTo = offsetOf(before, a, prefix + i);
+    size_t insertFrom = offsetOf(after, b, prefix + bStart);
+    size_t insertTo = offsetOf(after, b, prefix + j);
+
+    edits.push_back({ removeFrom,
+                      before.substr(removeFrom, removeTo - removeFrom),
+                      after.substr(insertFrom, insertTo - insertFrom) });
+  }
+
+  std::reverse(edits.begin(), edits.end());
+  return edits;
+}
+
+// [/diff]
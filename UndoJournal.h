@@ -0,0 +1,71 @@
+/**
+ * $file UndoJournal.h
+ */
+#pragma once
+
+#include <deque>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// A single replacement: `removed` was taken out at `position` and `inserted`
+// was put in its place. Pure insertions/deletions leave the other side empty.
+struct UndoEdit
+{
+  size_t position;
+  std::string removed;
+  std::string inserted;
+};
+
+// Everything one user action did to the buffer, undone/redone as a unit.
+struct UndoGroup
+{
+  std::vector<UndoEdit> edits;
+  size_t cursorBefore;
+  bool typing;
+  size_t bytes;
+};
+
+// Undo history that stores edit deltas instead of buffer snapshots. History
+// is bounded by the number of bytes it holds, oldest groups are dropped
+// first.
+class UndoJournal
+{
+public:
+  explicit UndoJournal(size_t maxBytes);
+
+  // closes the current group, the next record() starts a new one
+  void seal();
+
+  // consecutive typing at the end of the previous edit is merged into one
+  // group, everything else goes to the open group until seal()
+  void record(size_t position,
+              std::string removed,
+              std::string inserted,
+              size_t cursorBefore,
+              bool typing);
+
+  // the returned group stays valid until the journal is modified again
+  const UndoGroup* undo();
+  const UndoGroup* redo();
+
+  void clear();
+
+  size_t bytes() const { return totalBytes; }
+  size_t undoCount() const { return undoGroups.size(); }
+  size_t redoCount() const { return redoGroups.size(); }
+
+private:
+  void trim();
+
+  std::deque<UndoGroup> undoGroups;
+  std::vector<UndoGroup> redoGroups;
+  bool groupOpen = false;
+  size_t totalBytes = 0;
+  size_t maxBytes;
+};
+
+// Line based diff of two buffers. The edits are ordered bottom-up so each
+// one can be applied to the result of the previous ones.
+std::vector<UndoEdit>
+diffText(const std::string& before, const std::string& after);
@@ -0,0 +1,110 @@
+/**
+ * $file Utf8.h
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Next codepoint of UTF-8 text in [*text, end), *text moves past it.
+// Malformed sequences come out as U+FFFD a byte at a time.
+inline uint32_t
+DecodeUtf8(const char** text, const char* end)
+{
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(*text);
+  uint32_t c = *p++;
+  *text = reinterpret_cast<const char*>(p);
+  if (c < 0x80) {
+    return c;
+  }
+
+  // continuation bytes that follow the lead byte
+  uint32_t length = c < 0xc2   ? 0
+                    : c < 0xe0 ? 1
+                    : c < 0xf0 ? 2
+                    : c < 0xf5 ? 3
+                               : 0;
+  if (length == 0 || end - *text < static_cast<ptrdiff_t>(length)) {
+    return 0xfffd;
+  }
+  c &= 0x3f >> length;
+  for (uint32_t i = 0; i < length; ++i) {
+    if ((p[i] & 0xc0) != 0x80) {
+      return 0xfffd;
+    }
+    c = (c << 6) | (p[i] & 0x3f);
+  }
+
+  // overlong, a surrogate or past the last plane
+  static const uint32_t minimum[4] = { 0, 0x80, 0x800, 0x10000 };
+  if (c < minimum[length] || (c >= 0xd800 && c < 0xe000) || c > 0x10ffff) {
+    return 0xfffd;
+  }
+  *text += length;
+  return c;
+}
+
+// DecodeUtf8() over any byte iterator with `left` bytes to go (at least
+// one), `length` is set to the bytes the codepoint takes
+template<typename It>
+uint32_t
+DecodeUtf8At(It text, size_t left, size_t& length)
+{
+  char bytes[4];
+  size_t count = left < 4 ? left : 4;
+  for (size_t i = 0; i < count; ++i, ++text) {
+    bytes[i] = *text;
+  }
+  const char* p = bytes;
+  uint32_t c = DecodeUtf8(&p, bytes + count);
+  length = static_cast<size_t>(p - bytes);
+  return c;
+}
+
+// Codepoint boundaries of a text with at(pos) and length() (std::string,
+// PieceTable), the way DecodeUtf8() steps through it. A malformed byte is a
+// codepoint of its own.
+
+// start of the codepoint after the one at `position`
+template<typename Text>
+size_t
+NextCodepoint(const Text& text, size_t position)
+{
+  size_t left = text.length() - position;
+  if (left == 0) {
+    return position;
+  }
+  char bytes[4];
+  size_t count = left < 4 ? left : 4;
+  for (size_t i = 0; i < count; ++i) {
+    bytes[i] = text.at(position + i);
+  }
+  const char* p = bytes;
+  DecodeUtf8(&p, bytes + count);
+  return position + static_cast<size_t>(p - bytes);
+}
+
+// start of the codepoint `position` falls in, `position` itself when it's
+// on a boundary
+template<typename Text>
+size_t
+CodepointStart(const Text& text, size_t position)
+{
+  // a lead byte is at most three continuation bytes back
+  for (size_t back = 1; back <= 3 && back <= position; ++back) {
+    unsigned char c = static_cast<unsigned char>(text.at(position - back));
+    if ((c & 0xc0) != 0x80) {
+      size_t lead = position - back;
+      return NextCodepoint(text, lead) > position ? lead : position;
+    }
+  }
+  return position;
+}
+
+// start of the codepoint before `position`, which is on a boundary
+template<typename Text>
+size_t
+PreviousCodepoint(const Text& text, size_t position)
+{
+  return position > 0 ? CodepointStart(text, position - 1) : 0;
+}
@@ -0,0 +1,218 @@
+#include "WrapLayout.h"
+
+#include <algorithm>
+#include <string.h>
+
+WrapLayout::WrapLayout(const PieceTable& text, LineIndex& lines)
+  : text(text)
+  , lines(lines)
+{
+}
+
+void
+WrapLayout::setMetrics(const GlyphMetrics& metrics, float wrapWidth)
+{
+  if (this->wrapWidth == wrapWidth && this->metrics.SameAs(metrics)) {
+    return;
+  }
+  this->metrics = metrics;
+  this->wrapWidth = wrapWidth;
+
+  // every monospace ASCII row holds the same number of characters, count them
+  // with the same float steps the per-character loop takes
+  monoRowLength = 0;
+  if (metrics.monoAdvance > 0.0f) {
+    float x = 0.0f;
+    do {
+      x += metrics.monoAdvance;
+      monoRowLength++;
+    } while (x + metrics.monoAdvance <= wrapWidth);
+  }
+  invalidate();
+}
+
+void
+WrapLayout::invalidate()
+{
+  // old row counts stay in the index as estimates until settle() gets there
+  epoch++;
+  settleLine = 0;
+  settled = false;
+}
+
+WrapLayout::LineWrap&
+WrapLayout::wrapOf(size_t line)
+{
+  LineIndex::LineKey key = lines.lineKey(line);
+  if (wraps.size() < lines.slotCount()) {
+    wraps.resize(lines.slotCount());
+  }
+
+  LineWrap& wrap = wraps[key.slot];
+  if (wrap.serial == key.serial && wrap.epoch == epoch) {
+    return wrap;
+  }
+
+  wrap.serial = key.serial;
+  wrap.epoch = epoch;
+  wrap.breaks.clear();
+
+  size_t start = lines.lineStart(line);
+  size_t length = lines.lineEnd(line) - start;
+
+  // rows only break between codepoints, anything past ASCII is measured
+  bool ascii = monoRowLength > 0;
+  if (ascii) {
+    auto it = text.iteratorAt(start);
+    for (size_t i = 0; i < length && ascii; ++i, ++it) {
+      ascii = static_cast<unsigned char>(*it) < 0x80;
+    }
+  }
+
+  if (ascii) {
+    for (size_t i = monoRowLength; i < length; i += monoRowLength) {
+      wrap.breaks.push_back(static_cast<uint32_t>(i));
+    }
+  } else {
+    float x = 0.0f;
+    bool rowEmpty = true;
+    auto it = text.iteratorAt(start);
+    for (size_t i = 0; i < length;) {
+      size_t bytes;
+      float w = metrics.Advance(it, length - i, bytes);
+      if (x + w > wrapWidth && !rowEmpty) {
+        wrap.breaks.push_back(static_cast<uint32_t>(i));
+        x = 0.0f;
+      }
+      x += w;
+      rowEmpty = false;
+      for (size_t b = 0; b < bytes; ++b, ++it) {
+      }
+      i += bytes;
+    }
+  }
+
+  lines.setLineRows(line, static_cast<uint32_t>(wrap.breaks.size() + 1));
+  return wrap;
+}
+
+void
+WrapLayout::layoutLine(size_t line)
+{
+  wrapOf(line);
+}
+
+const WrapLayout::LineWrap*
+WrapLayout::currentWrap(size_t line) const
+{
+  LineIndex::LineKey key = lines.lineKey(line);
+  if (key.slot >= wraps.size()) {
+    return nullptr;
+  }
+  const LineWrap& wrap = wraps[key.slot];
+  return wrap.serial == key.serial && wrap.epoch == epoch ? &wrap : nullptr;
+}
+
+bool
+WrapLayout::adoptLine(const WrapLayout& source, size_t line)
+{
+  if (currentWrap(line)) {
+    return true;
+  }
+  const LineWrap* from = source.currentWrap(line);
+  if (!from) {
+    return false;
+  }
+
+  LineIndex::LineKey key = lines.lineKey(line);
+  if (wraps.size() < lines.slotCount()) {
+    wraps.resize(lines.slotCount());
+  }
+  LineWrap& wrap = wraps[key.slot];
+  wrap.serial = key.serial;
+  wrap.epoch = epoch;
+  wrap.breaks = from->breaks;
+  lines.setLineRows(line, static_cast<uint32_t>(wrap.breaks.size() + 1));
+  return true;
+}
+
+void
+WrapLayout::edited(size_t line)
+{
+  if (!settled) {
+    settleLine = std::min(settleLine, line);
+  }
+}
+
+void
+WrapLayout::defer(size_t line)
+{
+  settleLine = std::min(settleLine, line);
+  settled = false;
+}
+
+bool
+WrapLayout::settle(size_t budget, const WrapLayout* source)
+{
+  if (source && (source->wrapWidth != wrapWidth ||
+                 !source->metrics.SameAs(metrics))) {
+    return false;
+  }
+
+  size_t count = lines.lineCount();
+  while (budget > 0 && settleLine < count) {
+    if (!source) {
+      wrapOf(settleLine);
+    } else if (!adoptLine(*source, settleLine)) {
+      return false;
+    }
+    settleLine++;
+    budget--;
+  }
+  settled = settleLine >= count;
+  return settled;
+}
+
+WrapLayout::Row
+WrapLayout::row(size_t row)
+{
+  // wrapping a stale line can change its row count, so look the row up again
+  // until it lands on a line that is already laid out
+  size_t line = lines.lineAtRow(row);
+  LineIndex::LineKey key = lines.lineKey(line);
+  while (key.slot >= wraps.size() || wraps[key.slot].serial != key.serial ||
+         wraps[key.slot].epoch != epoch) {
+    wrapOf(line);
+    line = lines.lineAtRow(row);
+    key = lines.lineKey(line);
+  }
+
+  const std::vector<uint32_t>& breaks = wraps[key.slot].breaks;
+  size_t lineStart = lines.lineStart(line);
+  size_t index = std::min(row - std::min(row, lines.firstRow(line)),
+                          breaks.size());
+
+  Row result;
+  result.line = line;
+  result.start = lineStart + (index > 0 ? breaks[index - 1] : 0);
+  result.end =
+    index < breaks.size() ? lineStart + breaks[index] : lines.lineEnd(line);
+  return result;
+}
+
+size_t
+WrapLayout::rowAt(size_t position)
+{
+  size_t line = lines.lineAt(position);
+  const std::vector<uint32_t>& breaks = wrapOf(line).breaks;
+  size_t offset = position - std::min(position, lines.lineStart(line));
+  size_t index =
+    std::lower_bound(breaks.begin(), breaks.end(), offset) - breaks.begin();
+  return lines.firstRow(line) + index;
+}
+
+float
+WrapLayout::width(size_t start, size_t end) const
+{
+  return metrics.Width(text.iteratorAt(start), end - start);
+}
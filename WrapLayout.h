@@ -0,0 +1,86 @@
+/**
+ * $file WrapLayout.h
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "GlyphMetrics.h"
+#include "LineIndex.h"
+#include "PieceTable.h"
+
+// Soft wrap breaks of every logical line, cached per line slot of the
+// LineIndex. A line is wrapped again only after it was edited or after
+// invalidate(), its row count is written back into the index so visual rows
+// map to lines in O(log n). Nothing here builds per-row strings.
+class WrapLayout
+{
+public:
+  // a visual row is [start, end) of the buffer, end never includes the '\n'
+  struct Row
+  {
+    size_t line;
+    size_t start;
+    size_t end;
+  };
+
+  WrapLayout(const PieceTable& text, LineIndex& lines);
+
+  // any change of the glyph advances or of the wrap width invalidates the
+  // whole layout
+  void setMetrics(const GlyphMetrics& metrics, float wrapWidth);
+  void invalidate();
+
+  // wraps `line` now if its cached breaks are stale
+  void layoutLine(size_t line);
+
+  // Lines from `line` down were edited. While settle() is still on its way
+  // through the buffer it starts over from there, the edit may have moved
+  // lines it hadn't reached above its position.
+  void edited(size_t line);
+
+  // lines from `line` down were edited without being wrapped, settle()
+  // goes back for them
+  void defer(size_t line);
+
+  // Wraps at most `budget` stale lines, picking up where the last call
+  // stopped. Returns true once every line is laid out.
+  //
+  // With a `source` laid out over the same text and metrics in another
+  // index, its breaks are copied instead of computed and settling stops at
+  // the first line the source doesn't have yet.
+  bool settle(size_t budget, const WrapLayout* source = nullptr);
+
+  size_t rowCount() const { return lines.rowCount(); }
+  Row row(size_t row);
+
+  // visual row of a buffer position, a position right on a soft wrap
+  // belongs to the end of the upper row
+  size_t rowAt(size_t position);
+
+  float width(size_t start, size_t end) const;
+
+private:
+  struct LineWrap
+  {
+    uint32_t serial = 0;
+    uint32_t epoch = 0;
+    std::vector<uint32_t> breaks; // line offsets where rows 2.. start
+  };
+
+  LineWrap& wrapOf(size_t line);
+  const LineWrap* currentWrap(size_t line) const;
+  bool adoptLine(const WrapLayout& source, size_t line);
+
+  const PieceTable& text;
+  LineIndex& lines;
+  std::vector<LineWrap> wraps; // by line slot
+  GlyphMetrics metrics;
+  float wrapWidth = 0.0f;
+  size_t monoRowLength = 0; // characters per row for monospace fonts
+  uint32_t epoch = 1;
+  size_t settleLine = 0;
+  bool settled = false;
+};
@@ -0,0 +1,445 @@
+#include "GlyphAtlas.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+
+// cache file layout, a header, a record per field and then the texels of
+// all of them, found by the records' offsets
+struct SdfCacheHeader
+{
+  char magic[4];
+  uint32_t version;
+  float pixelHeight;
+  uint32_t padding;
+  uint32_t onEdge;
+  float distanceScale;
+  uint32_t count;
+};
+
+struct SdfCacheRecord
+{
+  uint32_t codepoint;
+  int16_t width, height;
+  int16_t x, y;
+  float advance;
+  uint32_t offset; // of the texels from the start of the file
+};
+
+static SdfCacheHeader
+CurrentHeader(uint32_t count)
+{
+  return { { 'G', 'S', 'D', 'F' },
+           GlyphAtlas::CACHE_VERSION,
+           GlyphAtlas::PIXEL_HEIGHT,
+           GlyphAtlas::SDF_PADDING,
+           GlyphAtlas::ON_EDGE,
+           GlyphAtlas::DISTANCE_SCALE,
+           count };
+}
+
+static uint16_t
+PageCoord(uint32_t pixel)
+{
+  return static_cast<uint16_t>(
+    static_cast<float>(pixel) / GlyphAtlas::PAGE_SIZE * 65535.0f + 0.5f);
+}
+
+GlyphAtlas::GlyphAtlas(WGPUDevice device, WGPUQueue queue)
+  : device(device)
+  , queue(queue)
+{
+}
+
+GlyphAtlas::~GlyphAtlas()
+{
+  SaveCache();
+  if (view)
+    wgpuTextureViewRelease(view);
+  if (texture)
+    wgpuTextureRelease(texture);
+}
+
+void
+GlyphAtlas::SetFont(const stbtt_fontinfo* font, const std::string& cachePath)
+{
+  SaveCache();
+  this->font = font;
+  this->cachePath = cachePath;
+  scale = stbtt_ScaleForPixelHeight(font, PIXEL_HEIGHT);
+  glyphs.clear();
+  fields.clear();
+  cacheFile = MappedFile();
+  shelves.clear();
+  pages.clear();
+  generation++;
+  AddPage();
+  LoadCache();
+}
+
+const GlyphAtlas::Field&
+GlyphAtlas::FieldOf(uint32_t codepoint)
+{
+  auto found = fields.find(codepoint);
+  if (found != fields.end()) {
+    return found->second;
+  }
+
+  // codepoints the font doesn't have get its missing glyph
+  int32_t index = stbtt_FindGlyphIndex(font, codepoint);
+  int32_t advance, lsb;
+  stbtt_GetGlyphHMetrics(font, index, &advance, &lsb);
+  int32_t width = 0, height = 0, x = 0, y = 0;
+  uint8_t* sdf = stbtt_GetGlyphSDF(font,
+                                   scale,
+                                   index,
+                                   SDF_PADDING,
+                                   ON_EDGE,
+                                   DISTANCE_SCALE,
+                                   &width,
+                                   &height,
+                                   &x,
+                                   &y);
+
+  Field field;
+  field.width = static_cast<int16_t>(sdf ? width : 0);
+  field.height = static_cast<int16_t>(sdf ? height : 0);
+  field.x = static_cast<int16_t>(x);
+  field.y = static_cast<int16_t>(y);
+  field.advance = advance * scale;
+  if (sdf) {
+    field.made.assign(sdf, sdf + width * height);
+    stbtt_FreeSDF(sdf, nullptr);
+  }
+  cacheDirty = true;
+  Field& made = fields.emplace(codepoint, std::move(field)).first->second;
+  made.texels = made.made.empty() ? nullptr : made.made.data();
+  return made;
+}
+
+const GlyphAtlas::Glyph*
+GlyphAtlas::Get(uint32_t codepoint)
+{
+  auto found = glyphs.find(codepoint);
+  if (found != glyphs.end()) {
+    if (found->second.shelf != NO_SHELF) {
+      shelves[found->second.shelf].usedFrame = frame;
+    }
+    return &found->second;
+  }
+  if (!font) {
+    return nullptr;
+  }
+
+  const Field& field = FieldOf(codepoint);
+  Glyph glyph = {};
+  glyph.x0 = field.x;
+  glyph.y0 = field.y;
+  glyph.x1 = field.x + field.width;
+  glyph.y1 = field.y + field.height;
+  glyph.advance = field.advance;
+  glyph.shelf = NO_SHELF;
+  if (!field.texels) {
+    return &glyphs.emplace(codepoint, glyph).first->second;
+  }
+
+  uint32_t width = field.width;
+  uint32_t height = field.height;
+  uint32_t cellWidth = width + 2 * PADDING;
+  uint32_t cellHeight = height + 2 * PADDING;
+  Shelf* shelf = Place(cellWidth, cellHeight);
+  if (!shelf && pages.size() < MAX_PAGES) {
+    AddPage();
+    shelf = Place(cellWidth, cellHeight);
+  }
+  if (!shelf) {
+    shelf = Evict(cellHeight);
+  }
+  if (!shelf) {
+    return nullptr;
+  }
+
+  Page& page = pages[shelf->page];
+  uint32_t x = shelf->x + PADDING;
+  uint32_t y = shelf->y + PADDING;
+  for (uint32_t row = 0; row < height; ++row) {
+    memcpy(&page.pixels[(y + row) * PAGE_SIZE + x],
+           &field.texels[row * width],
+           width);
+  }
+  MarkDirty(page, x, y, x + width, y + height);
+
+  glyph.uv[0] = PageCoord(x);
+  glyph.uv[1] = PageCoord(y);
+  glyph.uv[2] = PageCoord(x + width);
+  glyph.uv[3] = PageCoord(y + height);
+  glyph.page = shelf->page;
+  glyph.shelf = static_cast<uint32_t>(shelf - shelves.data());
+
+  shelf->x += cellWidth;
+  shelf->usedFrame = frame;
+  shelf->codepoints.push_back(codepoint);
+  return &glyphs.emplace(codepoint, glyph).first->second;
+}
+
+void
+GlyphAtlas::LoadCache()
+{
+  cacheFile = MappedFile(cachePath.c_str());
+  const uint8_t* data = cacheFile.Data();
+  size_t size = cacheFile.Size();
+
+  // fields made with other parameters would draw wrong, they're made again
+  SdfCacheHeader header;
+  SdfCacheHeader current = CurrentHeader(0);
+  if (size < sizeof(header)) {
+    return;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(&header, &current, offsetof(SdfCacheHeader, count)) != 0 ||
+      header.count > (size - sizeof(header)) / sizeof(SdfCacheRecord)) {
+    return;
+  }
+
+  fields.reserve(header.count);
+  for (uint32_t i = 0; i < header.count; ++i) {
+    SdfCacheRecord record;
+    memcpy(&record,
+           data + sizeof(header) + i * sizeof(SdfCacheRecord),
+           sizeof(record));
+    size_t texels = size_t(record.width) * size_t(record.height);
+    if (record.width < 0 || record.height < 0 || record.offset > size ||
+        texels > size - record.offset) {
+      break;
+    }
+    Field field;
+    field.width = record.width;
+    field.height = record.height;
+    field.x = record.x;
+    field.y = record.y;
+    field.advance = record.advance;
+    field.texels = texels ? data + record.offset : nullptr;
+    fields.emplace(record.codepoint, std::move(field));
+  }
+}
+
+void
+GlyphAtlas::SaveCache()
+{
+  if (!cacheDirty || cachePath.empty()) {
+    return;
+  }
+  cacheDirty = false;
+
+  // written aside and moved over, a reader never sees half a file
+  std::error_code error;
+  std::filesystem::path path(cachePath);
+  if (path.has_parent_path()) {
+    std::filesystem::create_directories(path.parent_path(), error);
+  }
+  std::string partial = cachePath + ".tmp";
+  FILE* file = fopen(partial.c_str(), "wb");
+  if (!file) {
+    std::cerr << "Failed to write glyph cache " << cachePath << std::endl;
+    return;
+  }
+
+  // the records first, the texels follow in the same order
+  SdfCacheHeader header = CurrentHeader(static_cast<uint32_t>(fields.size()));
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+  size_t offset = sizeof(header) + fields.size() * sizeof(SdfCacheRecord);
+  for (const auto& [codepoint, field] : fields) {
+    SdfCacheRecord record = { codepoint,    field.width, field.height,
+                              field.x,      field.y,     field.advance,
+                              uint32_t(offset) };
+    written = written && fwrite(&record, sizeof(record), 1, file) == 1;
+    if (field.texels) {
+      offset += size_t(field.width) * field.height;
+    }
+  }
+  for (const auto& [codepoint, field] : fields) {
+    size_t texels = size_t(field.width) * field.height;
+    written = written && (!field.texels ||
+                          fwrite(field.texels, 1, texels, file) == texels);
+  }
+  written = fclose(file) == 0 && written;
+
+  if (written) {
+    std::filesystem::rename(partial, path, error);
+  }
+  if (!written || error) {
+    std::cerr << "Failed to write glyph cache " << cachePath << std::endl;
+    std::filesystem::remove(partial, error);
+  }
+}
+
+GlyphAtlas::Shelf*
+GlyphAtlas::Place(uint32_t width, uint32_t height)
+{
+  height = (height + SHELF_STEP - 1) / SHELF_STEP * SHELF_STEP;
+  for (Shelf& shelf : shelves) {
+    if (shelf.height == height && PAGE_SIZE - shelf.x >= width) {
+      return &shelf;
+    }
+  }
+
+  // a new shelf under the last one of the first page with room
+  for (size_t i = 0; i < pages.size(); ++i) {
+    Page& page = pages[i];
+    if (PAGE_SIZE - page.shelvesEnd >= height) {
+      Shelf shelf;
+      shelf.page = static_cast<uint32_t>(i);
+      shelf.y = page.shelvesEnd;
+      shelf.height = height;
+      page.shelvesEnd += height;
+      shelves.push_back(std::move(shelf));
+      return &shelves.back();
+    }
+  }
+  return nullptr;
+}
+
+GlyphAtlas::Shelf*
+GlyphAtlas::Evict(uint32_t height)
+{
+  // glyphs drawn this frame stay, their instances are already out
+  Shelf* oldest = nullptr;
+  for (Shelf& shelf : shelves) {
+    if (shelf.height >= height && shelf.usedFrame != frame &&
+        (!oldest || shelf.usedFrame < oldest->usedFrame)) {
+      oldest = &shelf;
+    }
+  }
+  if (!oldest) {
+    std::cerr << "Glyph atlas is full with glyphs of this frame" << std::endl;
+    return nullptr;
+  }
+
+  for (uint32_t codepoint : oldest->codepoints) {
+    glyphs.erase(codepoint);
+  }
+  oldest->codepoints.clear();
+  oldest->x = 0;
+
+  Page& page = pages[oldest->page];
+  memset(&page.pixels[oldest->y * PAGE_SIZE], 0, oldest->height * PAGE_SIZE);
+  MarkDirty(page, 0, oldest->y, PAGE_SIZE, oldest->y + oldest->height);
+  generation++;
+  return oldest;
+}
+
+void
+GlyphAtlas::AddPage()
+{
+  pages.emplace_back();
+  pages.back().pixels.assign(PAGE_SIZE * PAGE_SIZE, 0);
+  if (pages.size() > textureLayers) {
+    CreateTexture();
+  }
+}
+
+void
+GlyphAtlas::CreateTexture()
+{
+  if (view)
+    wgpuTextureViewRelease(view);
+  if (texture)
+    wgpuTextureRelease(texture);
+
+  textureLayers = static_cast<uint32_t>(pages.size());
+
+  WGPUTextureDescriptor textureDesc = {};
+  textureDesc.label = "Glyph atlas";
+  textureDesc.size.width = PAGE_SIZE;
+  textureDesc.size.height = PAGE_SIZE;
+  textureDesc.size.depthOrArrayLayers = textureLayers;
+  textureDesc.mipLevelCount = 1;
+  textureDesc.sampleCount = 1;
+  textureDesc.dimension = WGPUTextureDimension_2D;
+  textureDesc.format = WGPUTextureFormat_R8Unorm; // single channel
+  textureDesc.usage =
+    WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst;
+  texture = wgpuDeviceCreateTexture(device, &textureDesc);
+
+  WGPUTextureViewDescriptor viewDesc = {};
+  viewDesc.format = WGPUTextureFormat_R8Unorm;
+  viewDesc.dimension = WGPUTextureViewDimension_2DArray;
+  viewDesc.baseMipLevel = 0;
+  viewDesc.mipLevelCount = 1;
+  viewDesc.baseArrayLayer = 0;
+  viewDesc.arrayLayerCount = textureLayers;
+  viewDesc.aspect = WGPUTextureAspect_All;
+  view = wgpuTextureCreateView(texture, &viewDesc);
+  recreated = true;
+
+  // the new texture starts out empty, pages already in use go up again
+  for (Page& page : pages) {
+    if (page.shelvesEnd) {
+      MarkDirty(page, 0, 0, PAGE_SIZE, page.shelvesEnd);
+    }
+  }
+}
+
+void
+GlyphAtlas::MarkDirty(Page& page,
+                      uint32_t x0,
+                      uint32_t y0,
+                      uint32_t x1,
+                      uint32_t y1)
+{
+  page.dirty[0] = std::min(page.dirty[0], x0);
+  page.dirty[1] = std::min(page.dirty[1], y0);
+  page.dirty[2] = std::max(page.dirty[2], x1);
+  page.dirty[3] = std::max(page.dirty[3], y1);
+}
+
+bool
+GlyphAtlas::Flush()
+{
+  for (size_t i = 0; i < pages.size(); ++i) {
+    Page& page = pages[i];
+    uint32_t x0 = page.dirty[0];
+    uint32_t y0 = page.dirty[1];
+    uint32_t x1 = page.dirty[2];
+    uint32_t y1 = page.dirty[3];
+    if (x1 <= x0 || y1 <= y0) {
+      continue;
+    }
+
+    WGPUImageCopyTexture copyTexture = {
+      .texture = texture,
+      .mipLevel = 0,
+      .origin = { x0, y0, static_cast<uint32_t>(i) },
+      .aspect = WGPUTextureAspect_All,
+    };
+
+    // rows of the rectangle are read out of the whole page
+    WGPUTextureDataLayout textureDataLayout = {
+      .offset = y0 * PAGE_SIZE + x0,
+      .bytesPerRow = PAGE_SIZE,
+      .rowsPerImage = y1 - y0,
+    };
+
+    WGPUExtent3D textureExtent3D{
+      .width = x1 - x0,
+      .height = y1 - y0,
+      .depthOrArrayLayers = 1,
+    };
+
+    wgpuQueueWriteTexture(queue,
+                          &copyTexture,
+                          page.pixels.data(),
+                          page.pixels.size(),
+                          &textureDataLayout,
+                          &textureExtent3D);
+
+    page.dirty[0] = page.dirty[1] = PAGE_SIZE;
+    page.dirty[2] = page.dirty[3] = 0;
+  }
+
+  bool changed = recreated;
+  recreated = false;
+  return changed;
+}
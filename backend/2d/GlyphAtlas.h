@@ -0,0 +1,147 @@
+/**
+ * $file backend/2d/GlyphAtlas.h
+ */
+#pragma once
+
+#include "../../Utf8.h"
+#include "../MappedFile.h"
+#include "stb/stb_truetype.h"
+#include "webgpu/webgpu.h"
+#include "wgpu/wgpu.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Glyphs as signed distance fields, made on first use at PIXEL_HEIGHT and
+// drawn at any size from there, the fragment shader turns distance into
+// coverage. A texel holds ON_EDGE on the outline and moves by DISTANCE_SCALE
+// a pixel, out to SDF_PADDING pixels around the glyph.
+//
+// Fields are packed onto shelves in R8 pages of a texture array, one shelf
+// per field height rounded up to SHELF_STEP. Pages are kept on the CPU as
+// well, Flush() uploads what changed since the last one as a rectangle a
+// page. A full atlas grows by a page, up to MAX_PAGES. Past that the least
+// recently used shelf that wasn't used in the frame is cleared for the new
+// glyph, and Generation() changes: instances built before may point at
+// glyphs that are gone.
+//
+// Making a field is slow, every field made is kept (evicted or not) and
+// written to the cache file given to SetFont() by SaveCache(), the next
+// start maps it instead. Only its table of fields is read at startup, the
+// texels of a field are read from the mapping when the glyph is placed.
+class GlyphAtlas
+{
+public:
+  static constexpr float PIXEL_HEIGHT = 48.0f;
+  static constexpr uint32_t SDF_PADDING = 5;
+  static constexpr uint8_t ON_EDGE = 128;
+  static constexpr float DISTANCE_SCALE = float(ON_EDGE) / SDF_PADDING;
+  static constexpr uint32_t CACHE_VERSION = 2;
+
+  static constexpr uint32_t PAGE_SIZE = 1024;
+  static constexpr uint32_t MAX_PAGES = 4;
+  static constexpr uint32_t SHELF_STEP = 8;
+  static constexpr uint32_t PADDING = 1; // around every field
+  static constexpr uint32_t NO_SHELF = UINT32_MAX;
+
+  struct Glyph
+  {
+    float x0, y0, x1, y1; // field around the pen at PIXEL_HEIGHT
+    float advance;        // at PIXEL_HEIGHT
+    uint16_t uv[4];       // u0, v0, u1, v1 in the page as unorm16
+    uint32_t page;
+    uint32_t shelf; // NO_SHELF when there's nothing to draw
+  };
+
+  GlyphAtlas(WGPUDevice device, WGPUQueue queue);
+  ~GlyphAtlas();
+
+  GlyphAtlas(const GlyphAtlas&) = delete;
+  GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+
+  // starts over with the glyphs of `font`, which has to outlive the atlas,
+  // and the fields cached for it in `cachePath` if they were made with the
+  // same parameters
+  void SetFont(const stbtt_fontinfo* font, const std::string& cachePath);
+
+  // writes every field made so far to the cache file, if there are new ones
+  void SaveCache();
+
+  // the glyph of `codepoint`, rasterised now if it isn't in the atlas.
+  // nullptr only when there's no room left in this frame.
+  const Glyph* Get(uint32_t codepoint);
+
+  // uploads the dirty rectangles, call before the frame's draws are
+  // submitted. Returns true when the texture was recreated and the views
+  // bound to it have to follow.
+  bool Flush();
+
+  void EndFrame() { frame++; }
+
+  WGPUTextureView View() const { return view; }
+  uint64_t Generation() const { return generation; }
+  uint32_t PageCount() const { return static_cast<uint32_t>(pages.size()); }
+  size_t GlyphCount() const { return glyphs.size(); }
+
+private:
+  struct Shelf
+  {
+    uint32_t page;
+    uint32_t y;
+    uint32_t height;
+    uint32_t x = 0; // where the next glyph goes
+    uint64_t usedFrame = 0;
+    std::vector<uint32_t> codepoints;
+  };
+
+  // a glyph's field, whether it's in the atlas or not
+  struct Field
+  {
+    int16_t width, height;
+    int16_t x, y; // offset from the pen
+    float advance;
+    const uint8_t* texels = nullptr; // in `made` or the cache mapping
+    std::vector<uint8_t> made;
+  };
+
+  struct Page
+  {
+    std::vector<uint8_t> pixels;
+    uint32_t shelvesEnd = 0; // y below the last shelf
+    uint32_t dirty[4] = { PAGE_SIZE, PAGE_SIZE, 0, 0 }; // x0, y0, x1, y1
+  };
+
+  // a shelf with room for `width` x `height`, nullptr when there's none
+  Shelf* Place(uint32_t width, uint32_t height);
+  Shelf* Evict(uint32_t height);
+  const Field& FieldOf(uint32_t codepoint);
+  void LoadCache();
+  void AddPage();
+  void CreateTexture();
+  void MarkDirty(Page& page,
+                 uint32_t x0,
+                 uint32_t y0,
+                 uint32_t x1,
+                 uint32_t y1);
+
+  WGPUDevice device;
+  WGPUQueue queue;
+  WGPUTexture texture = nullptr;
+  WGPUTextureView view = nullptr;
+  uint32_t textureLayers = 0;
+  bool recreated = false;
+
+  const stbtt_fontinfo* font = nullptr;
+  float scale = 0.0f;
+  std::unordered_map<uint32_t, Glyph> glyphs;
+  std::unordered_map<uint32_t, Field> fields;
+  std::string cachePath;
+  MappedFile cacheFile; // fields read from the cache point into it
+  bool cacheDirty = false;
+  std::vector<Shelf> shelves;
+  std::vector<Page> pages;
+  uint64_t frame = 1;
+  uint64_t generation = 0;
+};
@@ -0,0 +1,171 @@
+#include "GpuTimer.h"
+
+// query resolves land on 256 byte boundaries
+static constexpr uint64_t RESOLVE_STRIDE = 256;
+static constexpr uint64_t SLOT_BYTES = 2 * sizeof(uint64_t);
+
+GpuTimer::GpuTimer(WGPUDevice device)
+  : device(device)
+{
+  // the destructor polls the device, it has to outlive whoever owns this
+  wgpuDeviceReference(device);
+  for (Slot& slot : slots) {
+    slot.timer = this;
+  }
+  if (!wgpuDeviceHasFeature(device, WGPUFeatureName_TimestampQuery)) {
+    return;
+  }
+
+  WGPUQuerySetDescriptor queryDesc = {};
+  queryDesc.label = "Pass timestamps";
+  queryDesc.type = WGPUQueryType_Timestamp;
+  queryDesc.count = 2 * SLOTS;
+  querySet = wgpuDeviceCreateQuerySet(device, &queryDesc);
+
+  WGPUBufferDescriptor bufferDesc = {};
+  bufferDesc.label = "Timestamp resolve";
+  bufferDesc.size = RESOLVE_STRIDE * SLOTS;
+  bufferDesc.usage = WGPUBufferUsage_QueryResolve | WGPUBufferUsage_CopySrc;
+  resolveBuffer = wgpuDeviceCreateBuffer(device, &bufferDesc);
+
+  bufferDesc.label = "Timestamp readback";
+  bufferDesc.size = SLOT_BYTES;
+  bufferDesc.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+  for (Slot& slot : slots) {
+    slot.readback = wgpuDeviceCreateBuffer(device, &bufferDesc);
+  }
+
+  // timing stays off unless everything was created
+  bool created = querySet && resolveBuffer;
+  for (Slot& slot : slots) {
+    created = created && slot.readback;
+  }
+  if (!created && querySet) {
+    wgpuQuerySetRelease(querySet);
+    querySet = nullptr;
+  }
+}
+
+GpuTimer::~GpuTimer()
+{
+  // OnMapped holds on to the slots, let the mappings finish first
+  while (mapping > 0) {
+    wgpuDevicePoll(device, true, nullptr);
+  }
+  for (Slot& slot : slots) {
+    if (slot.readback) {
+      wgpuBufferRelease(slot.readback);
+    }
+  }
+  if (resolveBuffer) {
+    wgpuBufferRelease(resolveBuffer);
+  }
+  if (querySet) {
+    wgpuQuerySetRelease(querySet);
+  }
+  wgpuDeviceRelease(device);
+}
+
+const WGPURenderPassTimestampWrites*
+GpuTimer::BeginFrame()
+{
+  // the last frame's slot is still ours when it was never submitted
+  if (current != SLOTS) {
+    slots[current].state = SlotState::Free;
+    current = SLOTS;
+  }
+  if (!querySet) {
+    return nullptr;
+  }
+  for (uint32_t i = 0; i < SLOTS; ++i) {
+    if (slots[i].state == SlotState::Free) {
+      current = i;
+      break;
+    }
+  }
+  if (current == SLOTS) {
+    return nullptr;
+  }
+
+  slots[current].state = SlotState::Written;
+  writes.querySet = querySet;
+  writes.beginningOfPassWriteIndex = 2 * current;
+  writes.endOfPassWriteIndex = 2 * current + 1;
+  return &writes;
+}
+
+void
+GpuTimer::Resolve(WGPUCommandEncoder encoder)
+{
+  if (current == SLOTS) {
+    return;
+  }
+  Slot& slot = slots[current];
+  wgpuCommandEncoderResolveQuerySet(encoder,
+                                    querySet,
+                                    2 * current,
+                                    2,
+                                    resolveBuffer,
+                                    RESOLVE_STRIDE * current);
+  wgpuCommandEncoderCopyBufferToBuffer(encoder,
+                                       resolveBuffer,
+                                       RESOLVE_STRIDE * current,
+                                       slot.readback,
+                                       0,
+                                       SLOT_BYTES);
+  slot.state = SlotState::Resolved;
+}
+
+void
+GpuTimer::Submitted()
+{
+  if (current == SLOTS) {
+    return;
+  }
+  Slot& slot = slots[current];
+  current = SLOTS;
+
+  // a pass that was never resolved wrote into a slot nothing reads
+  if (slot.state != SlotState::Resolved) {
+    slot.state = SlotState::Free;
+    return;
+  }
+  slot.state = SlotState::Mapping;
+  mapping++;
+  wgpuBufferMapAsync(
+    slot.readback, WGPUMapMode_Read, 0, SLOT_BYTES, OnMapped, &slot);
+}
+
+void
+GpuTimer::OnMapped(WGPUBufferMapAsyncStatus status, void* userdata)
+{
+  Slot* slot = static_cast<Slot*>(userdata);
+  slot->state = status == WGPUBufferMapAsyncStatus_Success ? SlotState::Mapped
+                                                           : SlotState::Failed;
+  slot->timer->mapping--;
+}
+
+void
+GpuTimer::Collect(std::vector<float>& times)
+{
+  if (mapping > 0) {
+    // callbacks only run while the device is polled
+    wgpuDevicePoll(device, false, nullptr);
+  }
+
+  // timestamps are in nanoseconds, a pass that went backwards (a clock
+  // reset on some drivers) is dropped
+  for (Slot& slot : slots) {
+    if (slot.state == SlotState::Mapped) {
+      const uint64_t* stamps = static_cast<const uint64_t*>(
+        wgpuBufferGetConstMappedRange(slot.readback, 0, SLOT_BYTES));
+      if (stamps && stamps[1] > stamps[0]) {
+        times.push_back((stamps[1] - stamps[0]) / 1e6f);
+      }
+      wgpuBufferUnmap(slot.readback);
+      slot.state = SlotState::Free;
+    } else if (slot.state == SlotState::Failed) {
+      slot.state = SlotState::Free;
+    }
+  }
+}
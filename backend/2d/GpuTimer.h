@@ -0,0 +1,73 @@
+/**
+ * $file backend/2d/GpuTimer.h
+ */
+#pragma once
+
+#include "webgpu/webgpu.h"
+#include "wgpu/wgpu.h"
+#include <stdint.h>
+#include <vector>
+
+// GPU time of the frame's render pass, from timestamps written at its start
+// and end. A frame takes one of SLOTS slots: its pair of queries is resolved
+// and copied into the slot's readback buffer, which is mapped once the frame
+// is submitted. Collect() picks up whatever finished mapping, a few frames
+// later, and never waits. A frame that finds every slot still in flight
+// goes untimed.
+//
+// Without the timestamp-query feature on the device nothing is written and
+// nothing comes out.
+class GpuTimer
+{
+public:
+  static constexpr uint32_t SLOTS = 4;
+
+  GpuTimer(WGPUDevice device);
+  ~GpuTimer();
+
+  GpuTimer(const GpuTimer&) = delete;
+  GpuTimer& operator=(const GpuTimer&) = delete;
+
+  bool Enabled() const { return querySet != nullptr; }
+
+  // for WGPURenderPassDescriptor::timestampWrites, nullptr when the frame
+  // isn't timed
+  const WGPURenderPassTimestampWrites* BeginFrame();
+
+  // after the pass ended, before the encoder is finished
+  void Resolve(WGPUCommandEncoder encoder);
+
+  // after the queue submit
+  void Submitted();
+
+  // pass times in milliseconds that came back since the last call
+  void Collect(std::vector<float>& times);
+
+private:
+  enum class SlotState
+  {
+    Free,
+    Written, // the pass writes its queries
+    Resolved,
+    Mapping,
+    Mapped,
+    Failed
+  };
+
+  struct Slot
+  {
+    GpuTimer* timer;
+    WGPUBuffer readback = nullptr;
+    SlotState state = SlotState::Free;
+  };
+
+  static void OnMapped(WGPUBufferMapAsyncStatus status, void* userdata);
+
+  WGPUDevice device;
+  WGPUQuerySet querySet = nullptr;
+  WGPUBuffer resolveBuffer = nullptr;
+  Slot slots[SLOTS];
+  uint32_t current = SLOTS; // the frame's slot, SLOTS when it has none
+  uint32_t mapping = 0;     // slots waiting on their map callback
+  WGPURenderPassTimestampWrites writes = {};
+};
@@ -0,0 +1,163 @@
+#include "QuadBatch.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+QuadBatch::QuadBatch(size_t initialQuads, size_t maxQuads)
+  : maxQuads(maxQuads)
+  , keys(initialQuads)
+  , instances(initialQuads)
+  , vertices(initialQuads * VERTICES_PER_QUAD)
+{
+}
+
+template<typename T>
+bool
+QuadBatch::Grow(std::vector<T>& storage, size_t perQuad)
+{
+  size_t quads = storage.size() / perQuad;
+  if (quads >= maxQuads) {
+    dropped++;
+    return false;
+  }
+  quads = std::min(std::max<size_t>(quads * 2, 64), maxQuads);
+  storage.resize(quads * perQuad);
+  return true;
+}
+
+template bool
+QuadBatch::Grow(std::vector<QuadInstance>&, size_t);
+template bool
+QuadBatch::Grow(std::vector<Vertex>&, size_t);
+
+void
+SortQuadKeys(QuadKey* keys, size_t count, std::vector<QuadKey>& scratch)
+{
+  if (count < 2) {
+    return;
+  }
+  int32_t lowest = keys[0].drawOrder;
+  int32_t highest = keys[0].drawOrder;
+  for (size_t i = 1; i < count; ++i) {
+    lowest = std::min(lowest, keys[i].drawOrder);
+    highest = std::max(highest, keys[i].drawOrder);
+  }
+  if (static_cast<int64_t>(highest) - lowest >= COUNTING_SORT_RANGE) {
+    std::stable_sort(
+      keys, keys + count, [](const QuadKey& a, const QuadKey& b) {
+        return a.drawOrder < b.drawOrder;
+      });
+    return;
+  }
+
+  // where each draw order starts in the output, keys keep their relative
+  // order within one
+  uint32_t starts[COUNTING_SORT_RANGE + 1] = {};
+  for (size_t i = 0; i < count; ++i) {
+    starts[keys[i].drawOrder - lowest + 1]++;
+  }
+  for (int32_t order = 1; order <= highest - lowest; ++order) {
+    starts[order] += starts[order - 1];
+  }
+
+  if (scratch.size() < count) {
+    scratch.resize(count);
+  }
+  for (size_t i = 0; i < count; ++i) {
+    scratch[starts[keys[i].drawOrder - lowest]++] = keys[i];
+  }
+  std::copy(scratch.begin(), scratch.begin() + count, keys);
+}
+
+void
+QuadBatch::Sort()
+{
+  auto byOrder = [](const QuadKey& a, const QuadKey& b) {
+    return a.drawOrder < b.drawOrder;
+  };
+  auto first = keys.begin();
+  auto last = keys.begin() + keyCount;
+
+  // most frames are submitted layer by layer already, then the data is in
+  // draw order where it was written
+  bool inOrder = std::is_sorted(first, last, byOrder);
+  if (!inOrder) {
+    SortQuadKeys(keys.data(), keyCount, keyScratch);
+  }
+  if (!inOrder) {
+    if (instanceScratch.size() < instanceCount) {
+      instanceScratch.resize(instances.size());
+    }
+    if (vertexScratch.size() < vertexQuadCount * VERTICES_PER_QUAD) {
+      vertexScratch.resize(vertices.size());
+    }
+  }
+  sortedInstances = inOrder ? instances.data() : instanceScratch.data();
+  sortedVertices = inOrder ? vertices.data() : vertexScratch.data();
+
+  runs.clear();
+  uint32_t instanceOut = 0;
+  uint32_t quadOut = 0;
+  for (auto key = first; key != last; ++key) {
+    bool instanced = !(key->item & VERTEX_QUAD);
+    if (runs.empty() || runs.back().instanced != instanced ||
+        runs.back().drawOrder != key->drawOrder) {
+      runs.push_back(
+        { instanced, key->drawOrder, instanced ? instanceOut : quadOut, 0 });
+    }
+    runs.back().count++;
+
+    if (instanced) {
+      if (!inOrder) {
+        instanceScratch[instanceOut] = instances[key->item];
+      }
+      instanceOut++;
+    } else {
+      if (!inOrder) {
+        memcpy(&vertexScratch[quadOut * VERTICES_PER_QUAD],
+               &vertices[key->item & ~VERTEX_QUAD],
+               sizeof(Vertex) * VERTICES_PER_QUAD);
+      }
+      quadOut++;
+    }
+  }
+}
+
+std::vector<uint16_t>
+QuadBatch::QuadIndices(size_t quads)
+{
+  std::vector<uint16_t> indices(quads * INDICES_PER_QUAD);
+  for (size_t i = 0; i < quads; ++i) {
+    uint16_t base = static_cast<uint16_t>(i * VERTICES_PER_QUAD);
+    uint16_t* quad = &indices[i * INDICES_PER_QUAD];
+    quad[0] = base;
+    quad[1] = base + 1;
+    quad[2] = base + 2;
+    quad[3] = base;
+    quad[4] = base + 2;
+    quad[5] = base + 3;
+  }
+  return indices;
+}
+
+static uint32_t
+packUnorm8(float value)
+{
+  value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+  return static_cast<uint32_t>(lroundf(value * 255.0f));
+}
+
+uint32_t
+QuadBatch::PackColor(Vector4 color)
+{
+  return packUnorm8(color.x) | packUnorm8(color.y) << 8 |
+         packUnorm8(color.z) << 16 | packUnorm8(color.w) << 24;
+}
+
+uint16_t
+QuadBatch::PackUnorm16(float value)
+{
+  value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+  return static_cast<uint16_t>(lroundf(value * 65535.0f));
+}
@@ -0,0 +1,161 @@
+/**
+ * $file backend/2d/QuadBatch.h
+ */
+#pragma once
+
+#include "../../Math.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+struct Vertex
+{
+  Vector2 position; // relative to the origin
+  Vector4 color;
+  Vector2 texCoord;
+  float rotation; // angle in radians
+  uint32_t texIndex;
+  Vector2 translation; // per quad translation
+  float padding;       // align to 16 bytes
+};
+
+// An axis aligned quad drawn as one instance, the vertex shader expands the
+// corners from vertex_index. Corner 0 is (x0, y1) with (u0, v1) and they go
+// around as the Vertex path does: (x1, y1), (x1, y0), (x0, y0).
+struct QuadInstance
+{
+  Vector2 translation; // rotation pivot
+  Vector4 rect;        // x0, y0, x1, y1 around the pivot
+  uint16_t uv[4];      // u0, v0, u1, v1 as unorm16
+  uint32_t color;      // RGBA8
+  float rotation;      // angle in radians
+  uint32_t texIndex;
+};
+
+static_assert(sizeof(QuadInstance) == 44, "instance layout is in the shader");
+
+// ordering of one quad, its data stays where it was written
+struct QuadKey
+{
+  int32_t drawOrder;
+  uint32_t item; // instance, or first vertex | VERTEX_QUAD
+};
+
+// Stable sort of `count` keys by draw order. Draw orders are a handful of
+// layers, so this counts them and scatters the keys in one pass through
+// `scratch` when they span at most COUNTING_SORT_RANGE values and falls back
+// to std::stable_sort otherwise.
+constexpr int32_t COUNTING_SORT_RANGE = 256;
+
+void
+SortQuadKeys(QuadKey* keys, size_t count, std::vector<QuadKey>& scratch);
+
+// consecutive quads of one draw order that go through the same pipeline
+struct QuadRun
+{
+  bool instanced;
+  int32_t drawOrder;
+  uint32_t first; // instance, or quad of the vertex stream
+  uint32_t count;
+};
+
+// Flat per-frame arena for quads. Most quads are instances, anything that
+// isn't an axis aligned rectangle (lines) is 4 full vertices. Both are
+// written in submission order into storage that doubles when a frame needs
+// more and is kept for the next ones, only the small keys are sorted by
+// draw order. Vertex quads are indexed 0, 1, 2, 0, 2, 3 from their first
+// vertex, so that index data never changes and is built once
+// (QuadIndices()) for QUADS_PER_INDEXED_DRAW quads, the most 16 bit indices
+// reach. Longer runs are drawn in pieces from a base vertex.
+//
+// Past maxQuads of either kind quads are dropped and counted in Dropped().
+class QuadBatch
+{
+public:
+  static constexpr uint32_t VERTICES_PER_QUAD = 4;
+  static constexpr uint32_t INDICES_PER_QUAD = 6;
+  static constexpr uint32_t VERTEX_QUAD = 1u << 31;
+  static constexpr uint32_t QUADS_PER_INDEXED_DRAW =
+    65536 / VERTICES_PER_QUAD;
+
+  QuadBatch(size_t initialQuads, size_t maxQuads);
+
+  // a new instance, nullptr when the frame is full
+  QuadInstance* PushInstance(int32_t drawOrder)
+  {
+    if (instanceCount == instances.size() && !Grow(instances, 1)) {
+      return nullptr;
+    }
+    uint32_t index = static_cast<uint32_t>(instanceCount++);
+    PushKey({ drawOrder, index });
+    return &instances[index];
+  }
+
+  // the 4 vertices of a new quad, nullptr when the frame is full
+  Vertex* PushVertices(int32_t drawOrder)
+  {
+    if (vertexQuadCount * VERTICES_PER_QUAD == vertices.size() &&
+        !Grow(vertices, VERTICES_PER_QUAD)) {
+      return nullptr;
+    }
+    uint32_t first =
+      static_cast<uint32_t>(vertexQuadCount++ * VERTICES_PER_QUAD);
+    PushKey({ drawOrder, first | VERTEX_QUAD });
+    return &vertices[first];
+  }
+
+  // orders everything pushed this frame by draw order, stable, after which
+  // Instances(), Vertices() and Runs() describe the frame
+  void Sort();
+
+  const QuadInstance* Instances() const { return sortedInstances; }
+  const Vertex* Vertices() const { return sortedVertices; }
+  const std::vector<QuadRun>& Runs() const { return runs; }
+
+  size_t InstanceCount() const { return instanceCount; }
+  size_t VertexQuadCount() const { return vertexQuadCount; }
+  size_t Size() const { return keyCount; }
+  size_t MaxQuads() const { return maxQuads; }
+
+  // quads that didn't fit since the last Clear()
+  size_t Dropped() const { return dropped; }
+
+  void Clear() { keyCount = instanceCount = vertexQuadCount = dropped = 0; }
+
+  // indices for `quads` quads of 4 consecutive vertices each
+  static std::vector<uint16_t> QuadIndices(size_t quads);
+
+  // RGBA8 with red in the lowest byte, as unorm8x4 reads it
+  static uint32_t PackColor(Vector4 color);
+  static uint16_t PackUnorm16(float value);
+
+private:
+  void PushKey(QuadKey key)
+  {
+    if (keyCount == keys.size()) {
+      keys.resize(keys.empty() ? 64 : keys.size() * 2);
+    }
+    keys[keyCount++] = key;
+  }
+
+  // doubles `storage` of `perQuad` items a quad up to maxQuads quads,
+  // counts a dropped quad when it can't
+  template<typename T>
+  bool Grow(std::vector<T>& storage, size_t perQuad);
+
+  size_t maxQuads;
+  size_t dropped = 0;
+  size_t keyCount = 0;
+  size_t instanceCount = 0;
+  size_t vertexQuadCount = 0;
+  std::vector<QuadKey> keys;
+  std::vector<QuadKey> keyScratch;
+  std::vector<QuadInstance> instances;
+  std::vector<Vertex> vertices;
+
+  std::vector<QuadInstance> instanceScratch;
+  std::vector<Vertex> vertexScratch;
+  const QuadInstance* sortedInstances = nullptr;
+  const Vertex* sortedVertices = nullptr;
+  std::vector<QuadRun> runs;
+};
@@ -1,3 +1,4 @@
+#include "../../Profiler.h"
 #include "../common.h"
 #include "Renderer.h"
 
@@ -10,6 +11,7 @@
 #include <algorithm>
 #include <iostream>
 #include <math.h>
+#include <string.h>
 
 BatchRenderer::BatchRenderer(WGPUDevice device,
                              WGPUQueue queue,
@@ -19,12 +21,25 @@ BatchRenderer::BatchRenderer(WGPUDevice device,
   , queue(queue)
   , windowWidth(width)
   , windowHeight(height)
-  , numQuads(0)
-  , vertexBuffer(nullptr)
+  , uploads(device, queue, sizeof(QuadInstance) * INITIAL_QUADS)
+  , residents(device, queue)
+  , gpuTimer(device)
+  , scroll({ 0.0f, 0.0f })
+  , scrollClip({ { 0.0f, 0.0f }, { 0.0f, 0.0f } })
+  , batch(INITIAL_QUADS, MAX_QUADS)
+  , droppedQuads(0)
+  , glyphAtlas(device, queue)
+  , textureRegistry(device, queue)
+  , textureSampler(nullptr)
+  , fontSampler(nullptr)
   , indexBuffer(nullptr)
   , uniformBuffer(nullptr)
   , pipeline(nullptr)
+  , instancePipeline(nullptr)
+  , targetFormat(WGPUTextureFormat_BGRA8Unorm)
+  , targetSamples(MSAA_NUMBER_OF_SAMPLE)
   , vertexShaderModule(nullptr)
+  , instanceShaderModule(nullptr)
   , fragmentShaderModule(nullptr)
   , bindGroupLayout(nullptr)
   , bindGroup(nullptr)
@@ -33,32 +48,28 @@ BatchRenderer::BatchRenderer(WGPUDevice device,
 
 BatchRenderer::~BatchRenderer()
 {
-  if (vertexBuffer)
-    wgpuBufferRelease(vertexBuffer);
   if (indexBuffer)
     wgpuBufferRelease(indexBuffer);
   if (pipeline)
     wgpuRenderPipelineRelease(pipeline);
+  if (instancePipeline)
+    wgpuRenderPipelineRelease(instancePipeline);
   if (vertexShaderModule)
     wgpuShaderModuleRelease(vertexShaderModule);
+  if (instanceShaderModule)
+    wgpuShaderModuleRelease(instanceShaderModule);
   if (fragmentShaderModule)
     wgpuShaderModuleRelease(fragmentShaderModule);
   if (bindGroupLayout)
     wgpuBindGroupLayoutRelease(bindGroupLayout);
   if (bindGroup)
     wgpuBindGroupRelease(bindGroup);
-  for (int32_t i = 0; i < 2; ++i) {
-    if (textures[i].texture)
-      wgpuTextureRelease(textures[i].texture);
-    if (textures[i].textureView)
-      wgpuTextureViewRelease(textures[i].textureView);
-    if (textures[i].sampler)
-      wgpuSamplerRelease(textures[i].sampler);
-  }
+  if (textureSampler)
+    wgpuSamplerRelease(textureSampler);
+  if (fontSampler)
+    wgpuSamplerRelease(fontSampler);
   if (fontData.fontBuffer)
     delete[] fontData.fontBuffer;
-  if (fontData.bitmap)
-    delete[] fontData.bitmap;
 }
 
 void
@@ -66,17 +77,32 @@ BatchRenderer::Initialize()
 {
   CreatePipeline();
   CreateBuffers();
-  LoadTexture("res/spritesheet.png", 0);
-  LoadFont("res/JetBrainsMono-Regular.ttf"); // this will be bound to 1
+  CreateSamplers();
+  RegisterTexture("res/spritesheet.png"); // layer 0
+  LoadFont("res/JetBrainsMono-Regular.ttf");
   CreateBindGroup();
 }
 
+void
+BatchRenderer::SetTarget(WGPUTextureFormat format, uint32_t sampleCount)
+{
+  if (format == targetFormat && sampleCount == targetSamples) {
+    return;
+  }
+  targetFormat = format;
+  targetSamples = sampleCount;
+  if (pipeline) {
+    CreatePipeline();
+  }
+}
+
 void
 BatchRenderer::CreatePipeline()
 {
   const char* vertexShaderCode = R"(
       struct Uniforms {
           uTime: f32,
+          uScroll: vec2<f32>,
           uProjection: mat4x4<f32>,
       };
 
@@ -113,7 +139,8 @@ BatchRenderer::CreatePipeline()
           let rotatedPosition = rotationMatrix * input.position;
 
           // translation
-          let translatedPosition = rotatedPosition + input.translation;
+          let translatedPosition =
+              rotatedPosition + input.translation + uniforms.uScroll;
 
           // projection
           var output: VertexOutput;
@@ -125,10 +152,75 @@ BatchRenderer::CreatePipeline()
       }
     )";
 
+  // one QuadInstance per quad, the corners come from vertex_index
+  const char* instanceShaderCode = R"(
+      struct Uniforms {
+          uTime: f32,
+          uScroll: vec2<f32>,
+          uProjection: mat4x4<f32>,
+      };
+
+      @group(0) @binding(4) var<uniform> uniforms: Uniforms;
+
+      struct InstanceInput {
+          @location(0) translation : vec2<f32>,
+          @location(1) rect        : vec4<f32>,
+          @location(2) uvRect      : vec4<f32>,
+          @location(3) color       : vec4<f32>,
+          @location(4) rotation    : f32,
+          @location(5) texIndex    : u32,
+      };
+
+      struct VertexOutput {
+          @builtin(position) Position : vec4<f32>,
+          @location(0) color          : vec4<f32>,
+          @location(1) texCoord       : vec2<f32>,
+          @location(2) texIndex       : u32,
+      };
+
+      @vertex
+      fn main(
+          input : InstanceInput,
+          @builtin(vertex_index) vertexIndex : u32
+      ) -> VertexOutput {
+          // two triangles over corners 0 1 2 and 0 2 3, going around from
+          // (x0, y1) as the vertex path does
+          var corners = array<u32, 6>(0u, 1u, 2u, 0u, 2u, 3u);
+          let corner = corners[vertexIndex];
+          let right = corner == 1u || corner == 2u;
+          let top = corner < 2u;
+
+          let position = vec2<f32>(
+              select(input.rect.x, input.rect.z, right),
+              select(input.rect.y, input.rect.w, top)
+          );
+
+          let cosTheta = cos(input.rotation);
+          let sinTheta = sin(input.rotation);
+          let rotationMatrix = mat2x2<f32>(
+              cosTheta, -sinTheta,
+              sinTheta, cosTheta
+          );
+          let translatedPosition =
+              rotationMatrix * position + input.translation + uniforms.uScroll;
+
+          var output: VertexOutput;
+          output.Position =
+              uniforms.uProjection * vec4<f32>(translatedPosition, 0.0, 1.0);
+          output.color = input.color;
+          output.texCoord = vec2<f32>(
+              select(input.uvRect.x, input.uvRect.z, right),
+              select(input.uvRect.y, input.uvRect.w, top)
+          );
+          output.texIndex = input.texIndex;
+          return output;
+      }
+    )";
+
   const char* fragmentShaderCode = R"(
-      @group(0) @binding(0) var myTexture0: texture_2d<f32>;
+      @group(0) @binding(0) var myTexture0: texture_2d_array<f32>;
       @group(0) @binding(1) var mySampler0: sampler;
-      @group(0) @binding(2) var myTexture1: texture_2d<f32>;
+      @group(0) @binding(2) var myTexture1: texture_2d_array<f32>;
       @group(0) @binding(3) var mySampler1: sampler;
 
       @fragment
@@ -137,23 +229,34 @@ BatchRenderer::CreatePipeline()
           @location(1) texCoord : vec2<f32>,
           @location(2) texIndex : u32
       ) -> @location(0) vec4<f32> {
-          var finalColor: vec4<f32>;
-          if (texIndex == 2u) {
-              // Sample the font texture and use the red channel as alpha
-              let sampledAlpha = textureSample(myTexture1, mySampler1, texCoord).r;
-              finalColor = vec4<f32>(color.rgb, color.a * sampledAlpha);
-          } else if (texIndex == 1u) {
-              let texColor = textureSample(myTexture0, mySampler0, texCoord);
-              finalColor = texColor * color;
-          } else {
-              finalColor = color;
-          }
-          return finalColor;
+          // the kind of quad in the low byte, the texture layer or glyph
+          // page above it. Both arrays are sampled up front, fwidth needs
+          // uniform control flow.
+          let kind = texIndex & 0xffu;
+          let layer = i32(texIndex >> 8u);
+          let texColor = textureSample(myTexture0, mySampler0, texCoord, layer);
+          let field = textureSample(myTexture1, mySampler1, texCoord, layer).r;
+
+          // the font is a signed distance field with the outline at 128,
+          // smoothed over about a pixel at whatever size it's drawn
+          let edge = 128.0 / 255.0;
+          let smoothing = max(fwidth(field) * 0.7, 1.0 / 255.0);
+          let coverage = smoothstep(edge - smoothing, edge + smoothing, field);
+
+          // solid quads multiply by white
+          var sampled = select(vec4<f32>(1.0), texColor, kind == 1u);
+          sampled = select(sampled, vec4<f32>(1.0, 1.0, 1.0, coverage),
+                           kind == 2u);
+          return color * sampled;
       }
     )";
 
-  vertexShaderModule = createShaderModule(device, vertexShaderCode);
-  fragmentShaderModule = createShaderModule(device, fragmentShaderCode);
+  // shaders and layouts outlive pipelines rebuilt for a new target
+  if (!vertexShaderModule) {
+    vertexShaderModule = createShaderModule(device, vertexShaderCode);
+    instanceShaderModule = createShaderModule(device, instanceShaderCode);
+    fragmentShaderModule = createShaderModule(device, fragmentShaderCode);
+  }
 
   WGPUVertexAttribute attributes[6];
   attributes[0] = { WGPUVertexFormat_Float32x2, offsetof(Vertex, position), 0 };
@@ -186,12 +289,38 @@ BatchRenderer::CreatePipeline()
   vertexBufferLayout.attributes = attributes;
   vertexBufferLayout.stepMode = WGPUVertexStepMode_Vertex;
 
+  WGPUVertexAttribute instanceAttributes[6];
+  instanceAttributes[0] = { WGPUVertexFormat_Float32x2,
+                            offsetof(QuadInstance, translation),
+                            0 };
+  instanceAttributes[1] = { WGPUVertexFormat_Float32x4,
+                            offsetof(QuadInstance, rect),
+                            1 };
+  instanceAttributes[2] = { WGPUVertexFormat_Unorm16x4,
+                            offsetof(QuadInstance, uv),
+                            2 };
+  instanceAttributes[3] = { WGPUVertexFormat_Unorm8x4,
+                            offsetof(QuadInstance, color),
+                            3 };
+  instanceAttributes[4] = { WGPUVertexFormat_Float32,
+                            offsetof(QuadInstance, rotation),
+                            4 };
+  instanceAttributes[5] = { WGPUVertexFormat_Uint32,
+                            offsetof(QuadInstance, texIndex),
+                            5 };
+
+  WGPUVertexBufferLayout instanceBufferLayout = {};
+  instanceBufferLayout.arrayStride = sizeof(QuadInstance);
+  instanceBufferLayout.attributeCount = 6;
+  instanceBufferLayout.attributes = instanceAttributes;
+  instanceBufferLayout.stepMode = WGPUVertexStepMode_Instance;
+
   // bind group layout
   WGPUBindGroupLayoutEntry bglEntries[5] = {};
   bglEntries[0].binding = 0;
   bglEntries[0].visibility = WGPUShaderStage_Fragment;
   bglEntries[0].texture.sampleType = WGPUTextureSampleType_Float;
-  bglEntries[0].texture.viewDimension = WGPUTextureViewDimension_2D;
+  bglEntries[0].texture.viewDimension = WGPUTextureViewDimension_2DArray;
   bglEntries[0].texture.multisampled = false;
 
   bglEntries[1].binding = 1;
@@ -201,7 +330,7 @@ BatchRenderer::CreatePipeline()
   bglEntries[2].binding = 2;
   bglEntries[2].visibility = WGPUShaderStage_Fragment;
   bglEntries[2].texture.sampleType = WGPUTextureSampleType_Float;
-  bglEntries[2].texture.viewDimension = WGPUTextureViewDimension_2D;
+  bglEntries[2].texture.viewDimension = WGPUTextureViewDimension_2DArray;
   bglEntries[2].texture.multisampled = false;
 
   bglEntries[3].binding = 3;
@@ -211,13 +340,16 @@ BatchRenderer::CreatePipeline()
   bglEntries[4].binding = 4;
   bglEntries[4].visibility = WGPUShaderStage_Vertex;
   bglEntries[4].buffer.type = WGPUBufferBindingType_Uniform;
+  bglEntries[4].buffer.hasDynamicOffset = true;
   bglEntries[4].buffer.minBindingSize = sizeof(Uniforms);
 
   WGPUBindGroupLayoutDescriptor bglDesc = {};
   bglDesc.entryCount = 5;
   bglDesc.entries = bglEntries;
 
-  bindGroupLayout = wgpuDeviceCreateBindGroupLayout(device, &bglDesc);
+  if (!bindGroupLayout) {
+    bindGroupLayout = wgpuDeviceCreateBindGroupLayout(device, &bglDesc);
+  }
 
   // pipeline layout
   WGPUPipelineLayoutDescriptor pipelineLayoutDesc = {};
@@ -236,7 +368,7 @@ BatchRenderer::CreatePipeline()
   blendState.alpha.operation = WGPUBlendOperation_Add;
 
   WGPUColorTargetState colorTargetState = {};
-  colorTargetState.format = WGPUTextureFormat_BGRA8Unorm;
+  colorTargetState.format = targetFormat;
   colorTargetState.blend = &blendState;
   colorTargetState.writeMask = WGPUColorWriteMask_All;
 
@@ -262,38 +394,47 @@ BatchRenderer::CreatePipeline()
   pipelineDesc.primitive.frontFace = WGPUFrontFace_CCW;
   pipelineDesc.primitive.cullMode = WGPUCullMode_None;
 
-  pipelineDesc.multisample.count = MSAA_NUMBER_OF_SAMPLE;
+  pipelineDesc.multisample.count = targetSamples;
   pipelineDesc.multisample.mask = ~0u;
   pipelineDesc.multisample.alphaToCoverageEnabled = false;
 
+  if (pipeline) {
+    wgpuRenderPipelineRelease(pipeline);
+  }
   pipeline = wgpuDeviceCreateRenderPipeline(device, &pipelineDesc);
 
+  // same state, the vertices come from instances
+  pipelineDesc.vertex.module = instanceShaderModule;
+  pipelineDesc.vertex.buffers = &instanceBufferLayout;
+
+  if (instancePipeline) {
+    wgpuRenderPipelineRelease(instancePipeline);
+  }
+  instancePipeline = wgpuDeviceCreateRenderPipeline(device, &pipelineDesc);
+
   wgpuPipelineLayoutRelease(pipelineLayout);
 }
 
 void
 BatchRenderer::CreateBuffers()
 {
-  const size_t maxVertices = MAX_QUADS * 4;
-  const size_t maxIndices = MAX_QUADS * 6;
-
-  // vbo
-  WGPUBufferDescriptor vertexBufferDesc = {};
-  vertexBufferDesc.size = sizeof(Vertex) * maxVertices;
-  vertexBufferDesc.usage = WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst;
-  vertexBufferDesc.mappedAtCreation = false;
-  vertexBuffer = wgpuDeviceCreateBuffer(device, &vertexBufferDesc);
+  // vertices and instances go through the upload ring
 
-  // ibo
+  // ibo, every quad uses the same pattern so it's written once, longer
+  // runs are drawn in pieces
+  std::vector<uint16_t> indices =
+    QuadBatch::QuadIndices(QuadBatch::QUADS_PER_INDEXED_DRAW);
   WGPUBufferDescriptor indexBufferDesc = {};
-  indexBufferDesc.size = sizeof(uint16_t) * maxIndices;
+  indexBufferDesc.size = sizeof(uint16_t) * indices.size();
   indexBufferDesc.usage = WGPUBufferUsage_Index | WGPUBufferUsage_CopyDst;
   indexBufferDesc.mappedAtCreation = false;
   indexBuffer = wgpuDeviceCreateBuffer(device, &indexBufferDesc);
+  wgpuQueueWriteBuffer(
+    queue, indexBuffer, 0, indices.data(), indices.size() * sizeof(uint16_t));
 
   // Uniform buffer
   WGPUBufferDescriptor uniformBufferDesc = {};
-  uniformBufferDesc.size = sizeof(Uniforms);
+  uniformBufferDesc.size = UNIFORM_STRIDE + sizeof(Uniforms);
   uniformBufferDesc.usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst;
   uniformBufferDesc.mappedAtCreation = false;
   uniformBuffer = wgpuDeviceCreateBuffer(device, &uniformBufferDesc);
@@ -308,91 +449,54 @@ BatchRenderer::CreateBuffers()
 
   wgpuQueueWriteBuffer(
     queue, uniformBuffer, 0, &initialUniforms, sizeof(Uniforms));
+  wgpuQueueWriteBuffer(
+    queue, uniformBuffer, UNIFORM_STRIDE, &initialUniforms, sizeof(Uniforms));
 }
 
-void
-BatchRenderer::LoadTexture(const char* filePath, int32_t textureIndex)
+uint32_t
+BatchRenderer::RegisterTexture(const char* filePath)
 {
   int32_t texWidth, texHeight, texChannels;
   stbi_uc* pixels =
     stbi_load(filePath, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
   if (!pixels) {
     std::cout << "Failed to load texture: " << filePath << std::endl;
-    return;
+    return TextureRegistry::NO_TEXTURE;
   }
 
-  textures[textureIndex].width = texWidth;
-  textures[textureIndex].height = texHeight;
-
-  // texture
-  WGPUTextureDescriptor textureDesc = {};
-  textureDesc.size.width = texWidth;
-  textureDesc.size.height = texHeight;
-  textureDesc.size.depthOrArrayLayers = 1;
-  textureDesc.mipLevelCount = 1;
-  textureDesc.sampleCount = 1;
-  textureDesc.dimension = WGPUTextureDimension_2D;
-  textureDesc.format = WGPUTextureFormat_RGBA8Unorm;
-  textureDesc.usage =
-    WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst;
-
-  textures[textureIndex].texture =
-    wgpuDeviceCreateTexture(device, &textureDesc);
-
-  // load data to texture
-  WGPUImageCopyTexture copyTexture = {
-    .texture = textures[textureIndex].texture,
-    .mipLevel = 0,
-    .origin = { 0, 0, 0 },
-    .aspect = WGPUTextureAspect_All,
-  };
-
-  WGPUTextureDataLayout textureDataLayout = {
-    .offset = 0,
-    .bytesPerRow = (uint32_t)(texWidth * 4),
-    .rowsPerImage = (uint32_t)texHeight,
-  };
-
-  WGPUExtent3D textureExtent3D{
-    .width = (uint32_t)texWidth,
-    .height = (uint32_t)texHeight,
-    .depthOrArrayLayers = 1,
-  };
-  wgpuQueueWriteTexture(queue,
-                        &copyTexture,
-                        pixels,
-                        texWidth * texHeight * 4,
-                        &textureDataLayout,
-                        &textureExtent3D);
-
+  uint32_t layer =
+    RegisterTexture(pixels, (uint32_t)texWidth, (uint32_t)texHeight);
   stbi_image_free(pixels);
+  return layer;
+}
 
-  // texture view
-  WGPUTextureViewDescriptor viewDesc = {};
-  viewDesc.format = WGPUTextureFormat_RGBA8Unorm;
-  viewDesc.dimension = WGPUTextureViewDimension_2D;
-  viewDesc.baseMipLevel = 0;
-  viewDesc.mipLevelCount = 1;
-  viewDesc.baseArrayLayer = 0;
-  viewDesc.arrayLayerCount = 1;
-  viewDesc.aspect = WGPUTextureAspect_All;
-
-  textures[textureIndex].textureView =
-    wgpuTextureCreateView(textures[textureIndex].texture, &viewDesc);
+uint32_t
+BatchRenderer::RegisterTexture(const uint8_t* pixels,
+                               uint32_t width,
+                               uint32_t height)
+{
+  return textureRegistry.Register(pixels, width, height);
+}
 
-  // sampler
+void
+BatchRenderer::CreateSamplers()
+{
+  // textures clamp, coordinates past a texture would read the rest of its
+  // layer
   WGPUSamplerDescriptor samplerDesc = {};
-  samplerDesc.addressModeU = WGPUAddressMode_Repeat;
-  samplerDesc.addressModeV = WGPUAddressMode_Repeat;
-  samplerDesc.addressModeW = WGPUAddressMode_Repeat;
+  samplerDesc.addressModeU = WGPUAddressMode_ClampToEdge;
+  samplerDesc.addressModeV = WGPUAddressMode_ClampToEdge;
+  samplerDesc.addressModeW = WGPUAddressMode_ClampToEdge;
   samplerDesc.magFilter = WGPUFilterMode_Nearest;
   samplerDesc.minFilter = WGPUFilterMode_Nearest;
   samplerDesc.lodMinClamp = 0.0f;
   samplerDesc.lodMaxClamp = 32.0f;
   samplerDesc.maxAnisotropy = 1;
+  textureSampler = wgpuDeviceCreateSampler(device, &samplerDesc);
 
-  textures[textureIndex].sampler =
-    wgpuDeviceCreateSampler(device, &samplerDesc);
+  samplerDesc.magFilter = WGPUFilterMode_Linear;
+  samplerDesc.minFilter = WGPUFilterMode_Linear;
+  fontSampler = wgpuDeviceCreateSampler(device, &samplerDesc);
 }
 
 Vector4
@@ -426,95 +530,22 @@ BatchRenderer::LoadFont(const char* fontFilePath)
                  fontData.fontBuffer,
                  stbtt_GetFontOffsetForIndex(fontData.fontBuffer, 0));
 
-  // bitmap atlas
-  const int32_t bitmapWidth = 512;
-  const int32_t bitmapHeight = 512;
-  fontData.bitmap = new unsigned char[bitmapWidth * bitmapHeight];
-
-  // bake tha font bitmap braw
-  float pixelHeight = 90.0f;
-  int32_t result = stbtt_BakeFontBitmap(fontData.fontBuffer,
-                                        0,
-                                        pixelHeight,
-                                        fontData.bitmap,
-                                        bitmapWidth,
-                                        bitmapHeight,
-                                        32,
-                                        96,
-                                        fontData.cdata);
-  if (result <= 0) {
-    std::cout << "Failed to bake font bitmap." << std::endl;
-    return;
+  // glyph fields go into the atlas as they're drawn, ASCII up front. They
+  // are cached per font file, named by a hash of its contents.
+  uint64_t fontHash = 0xcbf29ce484222325ull;
+  for (long i = 0; i < fontSize; ++i) {
+    fontHash = (fontHash ^ fontData.fontBuffer[i]) * 0x100000001b3ull;
   }
-
-  WGPUTextureDescriptor textureDesc = {};
-  textureDesc.size.width = bitmapWidth;
-  textureDesc.size.height = bitmapHeight;
-  textureDesc.size.depthOrArrayLayers = 1;
-  textureDesc.mipLevelCount = 1;
-  textureDesc.sampleCount = 1;
-  textureDesc.dimension = WGPUTextureDimension_2D;
-  textureDesc.format = WGPUTextureFormat_R8Unorm; // single channel
-  textureDesc.usage =
-    WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst;
-
-  WGPUTexture fontTexture = wgpuDeviceCreateTexture(device, &textureDesc);
-  WGPUImageCopyTexture copyTexture = {
-    .texture = fontTexture,
-    .mipLevel = 0,
-    .origin = { 0, 0, 0 },
-    .aspect = WGPUTextureAspect_All,
-  };
-
-  WGPUTextureDataLayout textureDataLayout = {
-    .offset = 0,
-    .bytesPerRow = bitmapWidth * 1, // R8Unorm = 1 byte per pixel
-    .rowsPerImage = bitmapHeight,
-  };
-
-  WGPUExtent3D textureExtent3D{
-    .width = bitmapWidth,
-    .height = bitmapHeight,
-    .depthOrArrayLayers = 1,
-  };
-
-  wgpuQueueWriteTexture(queue,
-                        &copyTexture,
-                        fontData.bitmap,
-                        bitmapWidth * bitmapHeight * 1, // total size in bytes
-                        &textureDataLayout,
-                        &textureExtent3D);
-
-  // texture view
-  WGPUTextureViewDescriptor viewDesc = {};
-  viewDesc.format = WGPUTextureFormat_R8Unorm;
-  viewDesc.dimension = WGPUTextureViewDimension_2D;
-  viewDesc.baseMipLevel = 0;
-  viewDesc.mipLevelCount = 1;
-  viewDesc.baseArrayLayer = 0;
-  viewDesc.arrayLayerCount = 1;
-  viewDesc.aspect = WGPUTextureAspect_All;
-
-  WGPUTextureView fontTextureView =
-    wgpuTextureCreateView(fontTexture, &viewDesc);
-
-  WGPUSamplerDescriptor samplerDesc = {};
-  samplerDesc.addressModeU = WGPUAddressMode_ClampToEdge;
-  samplerDesc.addressModeV = WGPUAddressMode_ClampToEdge;
-  samplerDesc.addressModeW = WGPUAddressMode_ClampToEdge;
-  samplerDesc.magFilter = WGPUFilterMode_Linear;
-  samplerDesc.minFilter = WGPUFilterMode_Linear;
-  samplerDesc.lodMinClamp = 0.0f;
-  samplerDesc.lodMaxClamp = 32.0f;
-  samplerDesc.maxAnisotropy = 1;
-
-  WGPUSampler fontSampler = wgpuDeviceCreateSampler(device, &samplerDesc);
-
-  textures[1].texture = fontTexture;
-  textures[1].textureView = fontTextureView;
-  textures[1].sampler = fontSampler;
-  textures[1].width = bitmapWidth;
-  textures[1].height = bitmapHeight;
+  char cachePath[64];
+  snprintf(cachePath,
+           sizeof(cachePath),
+           ".cache/glyphs-%016llx.sdf",
+           (unsigned long long)fontHash);
+  glyphAtlas.SetFont(&fontData.fontInfo, cachePath);
+  for (uint32_t c = 32; c < 127; ++c) {
+    glyphAtlas.Get(c);
+  }
+  glyphAtlas.SaveCache();
 }
 
 void
@@ -522,17 +553,17 @@ BatchRenderer::CreateBindGroup()
 {
   WGPUBindGroupEntry bgEntries[5] = {};
 
-  // Texture 0
+  // Texture 0, the registry's layers
   bgEntries[0].binding = 0;
-  bgEntries[0].textureView = textures[0].textureView;
+  bgEntries[0].textureView = textureRegistry.View();
   bgEntries[1].binding = 1;
-  bgEntries[1].sampler = textures[0].sampler;
+  bgEntries[1].sampler = textureSampler;
 
-  // Texture 1 (Font)
+  // Texture 1 (Font), the atlas pages
   bgEntries[2].binding = 2;
-  bgEntries[2].textureView = textures[1].textureView;
+  bgEntries[2].textureView = glyphAtlas.View();
   bgEntries[3].binding = 3;
-  bgEntries[3].sampler = textures[1].sampler;
+  bgEntries[3].sampler = fontSampler;
 
   // Uniform buffer
   bgEntries[4].binding = 4;
@@ -557,6 +588,10 @@ BatchRenderer::CreateBindGroup()
   bgDesc.entryCount = 5;
   bgDesc.entries = bgEntries;
 
+  // rebuilt when the atlas or the registry grows
+  if (bindGroup) {
+    wgpuBindGroupRelease(bindGroup);
+  }
   bindGroup = wgpuDeviceCreateBindGroup(device, &bgDesc);
 
   // Check bind group creation
@@ -576,52 +611,23 @@ BatchRenderer::AddQuad(Vector2 position,
                        Vector2 origin,
                        int32_t drawOrder = 0)
 {
-  if (quads.size() >= MAX_QUADS)
+  QuadInstance* quad = batch.PushInstance(drawOrder);
+  if (!quad)
     return;
 
-  Quad quad;
-  quad.drawOrder = drawOrder;
-
   // origin offset
   float originX = origin.x * width;
   float originY = origin.y * height;
 
-  Vertex v0 = { { -originX, height - originY }, // Top-left
-                color,
-                { 0.0f, 1.0f },
-                rotation,
-                0u,
-                position,
-                0.0f };
-
-  Vertex v1 = { { width - originX, height - originY }, // Top-right
-                color,
-                { 1.0f, 1.0f },
-                rotation,
-                0u,
-                position,
-                0.0f };
-
-  Vertex v2 = { { width - originX, -originY }, // Bottom-right
-                color,
-                { 1.0f, 0.0f },
-                rotation,
-                0u,
-                position,
-                0.0f };
-
-  Vertex v3 = { { -originX, -originY }, // Bottom-left
-                color,
-                { 0.0f, 0.0f },
-                rotation,
-                0u,
-                position,
-                0.0f };
-
-  quad.vertices = { v0, v1, v2, v3 };
-  quad.indices = { 0, 1, 2, 0, 2, 3 };
-
-  quads.push_back(quad);
+  quad->translation = position;
+  quad->rect = { -originX, -originY, width - originX, height - originY };
+  quad->uv[0] = 0;
+  quad->uv[1] = 0;
+  quad->uv[2] = 0xffff;
+  quad->uv[3] = 0xffff;
+  quad->color = QuadBatch::PackColor(color);
+  quad->rotation = rotation;
+  quad->texIndex = PackTexIndex(QUAD_SOLID, 0);
 }
 
 void
@@ -633,12 +639,6 @@ BatchRenderer::AddLine(Vector2 start,
                        Vector2 origin = ORIGIN_CENTER,
                        int32_t drawOrder = 0)
 {
-  if (quads.size() >= MAX_QUADS)
-    return;
-
-  Quad quad;
-  quad.drawOrder = drawOrder;
-
   Vector2 dir = { end.x - start.x, end.y - start.y };
   float length = sqrtf(dir.x * dir.x + dir.y * dir.y);
 
@@ -660,19 +660,19 @@ BatchRenderer::AddLine(Vector2 start,
   Vector2 v3 = { end.x - center.x - offset.x, end.y - center.y - offset.y };
   Vector2 v4 = { end.x - center.x + offset.x, end.y - center.y + offset.y };
 
-  Vertex vertex0 = { { v1.x, v1.y }, color, { 0.0f, 0.0f }, rotation, 0u,
-                     center,         0.0f };
-  Vertex vertex1 = { { v2.x, v2.y }, color, { 0.0f, 0.0f }, rotation, 0u,
-                     center,         0.0f };
-  Vertex vertex2 = { { v3.x, v3.y }, color, { 0.0f, 0.0f }, rotation, 0u,
-                     center,         0.0f };
-  Vertex vertex3 = { { v4.x, v4.y }, color, { 0.0f, 0.0f }, rotation, 0u,
-                     center,         0.0f };
-
-  quad.vertices = { vertex0, vertex1, vertex2, vertex3 };
-  quad.indices = { 0, 1, 2, 0, 2, 3 };
+  // not axis aligned, lines stay on the vertex path
+  Vertex* quad = batch.PushVertices(drawOrder);
+  if (!quad)
+    return;
 
-  quads.push_back(quad);
+  quad[0] = { { v1.x, v1.y }, color, { 0.0f, 0.0f }, rotation, 0u,
+              center,         0.0f };
+  quad[1] = { { v2.x, v2.y }, color, { 0.0f, 0.0f }, rotation, 0u,
+              center,         0.0f };
+  quad[2] = { { v3.x, v3.y }, color, { 0.0f, 0.0f }, rotation, 0u,
+              center,         0.0f };
+  quad[3] = { { v4.x, v4.y }, color, { 0.0f, 0.0f }, rotation, 0u,
+              center,         0.0f };
 }
 
 void
@@ -680,58 +680,33 @@ BatchRenderer::AddTexturedQuad(Vector2 position,
                                float width,
                                float height,
                                float texCoords[4][2],
-                               uint32_t texIndex,
+                               uint32_t texture,
                                Vector4 color,
                                float rotation = 0.0f,
                                Vector2 origin = ORIGIN_CENTER,
                                int32_t drawOrder = 0)
 {
-  if (quads.size() >= MAX_QUADS)
+  QuadInstance* quad = batch.PushInstance(drawOrder);
+  if (!quad)
     return;
 
-  Quad quad;
-  quad.drawOrder = drawOrder;
-
   // origin offset
   float originX = origin.x * width;
   float originY = origin.y * height;
 
-  Vertex v0 = { { -originX, height - originY }, // Top-left
-                color,
-                { texCoords[0][0], texCoords[0][1] },
-                rotation,
-                texIndex,
-                position,
-                0.0f };
-
-  Vertex v1 = { { width - originX, height - originY }, // Top-right
-                color,
-                { texCoords[1][0], texCoords[1][1] },
-                rotation,
-                texIndex,
-                position,
-                0.0f };
-
-  Vertex v2 = { { width - originX, -originY }, // Bottom-right
-                color,
-                { texCoords[2][0], texCoords[2][1] },
-                rotation,
-                texIndex,
-                position,
-                0.0f };
-
-  Vertex v3 = { { -originX, -originY }, // Bottom-left
-                color,
-                { texCoords[3][0], texCoords[3][1] },
-                rotation,
-                texIndex,
-                position,
-                0.0f };
-
-  quad.vertices = { v0, v1, v2, v3 };
-  quad.indices = { 0, 1, 2, 0, 2, 3 };
-
-  quads.push_back(quad);
+  // texCoords go around from the top-left corner, (u0, v1) ... (u0, v0),
+  // the opposite corners 0 and 2 span the whole rect. They're scaled from
+  // the texture to the corner of the layer it sits in.
+  Vector2 scale = textureRegistry.Scale(texture);
+  quad->translation = position;
+  quad->rect = { -originX, -originY, width - originX, height - originY };
+  quad->uv[0] = QuadBatch::PackUnorm16(texCoords[0][0] * scale.x);
+  quad->uv[1] = QuadBatch::PackUnorm16(texCoords[2][1] * scale.y);
+  quad->uv[2] = QuadBatch::PackUnorm16(texCoords[2][0] * scale.x);
+  quad->uv[3] = QuadBatch::PackUnorm16(texCoords[0][1] * scale.y);
+  quad->color = QuadBatch::PackColor(color);
+  quad->rotation = rotation;
+  quad->texIndex = PackTexIndex(QUAD_TEXTURE, texture);
 }
 
 void
@@ -741,130 +716,191 @@ BatchRenderer::DrawText(const char* text,
                         Vector4 color,
                         int32_t drawOrder = 0.0f)
 {
-  // convert to ndc
-  float posX = (position.x / static_cast<float>(windowWidth)) * 2.0f - 1.0f;
-  float posY = 1.0f - (position.y / static_cast<float>(windowHeight)) * 2.0f;
+  DrawText(std::string_view(text), position, fontSize, color, drawOrder);
+}
 
-  float scale = fontSize / 90.0f; // note (David): 90 is baked font size
+void
+BatchRenderer::DrawText(std::string_view text,
+                        Vector2 position,
+                        float fontSize,
+                        Vector4 color,
+                        int32_t drawOrder)
+{
+  textScratch.clear();
+  BuildText(text, position, fontSize, color, textScratch);
+  AddInstances(textScratch.data(), textScratch.size(), {}, drawOrder);
+}
 
-  for (const char* p = text; *p; ++p) {
-    if (*p == '\n') {
-      posY += fontSize;
-      posX = position.x;
+void
+BatchRenderer::BuildText(std::string_view text,
+                         Vector2 position,
+                         float fontSize,
+                         Vector4 color,
+                         std::vector<QuadInstance>& out)
+{
+  // the pen starts at 0 and glyphs don't snap to anything, so a run is the
+  // same wherever the text is drawn
+  float penX = 0.0f;
+  float penY = 0.0f;
+
+  float scale = fontSize / GlyphAtlas::PIXEL_HEIGHT;
+  uint32_t packedColor = QuadBatch::PackColor(color);
+
+  const char* end = text.data() + text.size();
+  for (const char* p = text.data(); p < end;) {
+    uint32_t c = DecodeUtf8(&p, end);
+    if (c == '\n') {
+      penY += fontSize;
+      penX = 0.0f;
       continue;
     }
 
-    char c = *p;
-    if (c < 32 || c >= 128)
+    if (c < 32 || c == 127)
       continue;
 
-    stbtt_aligned_quad q;
-    stbtt_GetBakedQuad(fontData.cdata, 512, 512, c - 32, &posX, &posY, &q, 1);
-
-    float x0 = q.x0 * scale;
-    float y0 = q.y0 * scale;
-    float x1 = q.x1 * scale;
-    float y1 = q.y1 * scale;
-
-    float w = x1 - x0;
-    float h = y1 - y0;
+    const GlyphAtlas::Glyph* glyph = glyphAtlas.Get(c);
+    if (!glyph)
+      continue;
 
-    Vector2 center = { position.x + x0 + w / 2.0f, position.y + y0 + h / 2.0f };
+    if (glyph->shelf != GlyphAtlas::NO_SHELF) {
+      float x0 = penX + glyph->x0 * scale;
+      float y0 = penY + glyph->y0 * scale;
+      float w = (glyph->x1 - glyph->x0) * scale;
+      float h = (glyph->y1 - glyph->y0) * scale;
+
+      // as AddTexturedQuad() with ORIGIN_CENTER, v1 at the bottom
+      QuadInstance quad;
+      quad.translation = { position.x + x0 + w / 2.0f,
+                           position.y + y0 + h / 2.0f };
+      quad.rect = { -w / 2.0f, -h / 2.0f, w / 2.0f, h / 2.0f };
+      quad.uv[0] = glyph->uv[0];
+      quad.uv[1] = glyph->uv[1];
+      quad.uv[2] = glyph->uv[2];
+      quad.uv[3] = glyph->uv[3];
+      quad.color = packedColor;
+      quad.rotation = 0.0f;
+      quad.texIndex = PackTexIndex(QUAD_GLYPH, glyph->page);
+      out.push_back(quad);
+    }
+    penX += glyph->advance * scale;
+  }
+}
 
-    float texCoords[4][2] = {
-      { q.s0, q.t1 }, // bottom-left
-      { q.s1, q.t1 }, // bottom-right
-      { q.s1, q.t0 }, // top-right
-      { q.s0, q.t0 }, // top-left
-    };
+void
+BatchRenderer::AddInstances(const QuadInstance* instances,
+                            size_t count,
+                            Vector2 offset,
+                            int32_t drawOrder)
+{
+  for (size_t i = 0; i < count; ++i) {
+    QuadInstance* quad = batch.PushInstance(drawOrder);
+    if (!quad)
+      return;
 
-    AddTexturedQuad(
-      center, w, h, texCoords, 2, color, 0.0f, ORIGIN_CENTER, drawOrder);
+    *quad = instances[i];
+    quad->translation.x += offset.x;
+    quad->translation.y += offset.y;
   }
 }
 
 Vector2
 BatchRenderer::MeasureText(const char* text, float fontSize)
 {
-  float posX = 0.0f;
-  float posY = fontSize;
-
-  float maxWidth = 0.0f;
-  //  float scale = fontSize / 90.0f; // move backed font size somewhere else
+  const GlyphMetrics& glyphs = fontData.Metrics(fontSize);
 
-  float scale = stbtt_ScaleForPixelHeight(&fontData.fontInfo, fontSize);
-
-  for (const char* p = text; *p; ++p) {
+  float totalWidth = 0.0f;
+  float posY = fontSize;
+  const char* end = text + strlen(text);
+  for (const char* p = text; p < end;) {
     if (*p == '\n') {
       posY += fontSize; // move down by the font size (line height)
-      posX = 0.0f;      // reset X to the starting X position
-      continue;
     }
+    totalWidth += glyphs.CodepointAdvance(DecodeUtf8(&p, end));
+  }
 
-    char c = *p;
-    if (c < 32 || c >= 128)
-      continue;
-
-    stbtt_aligned_quad q;
-    stbtt_GetBakedQuad(fontData.cdata, 512, 512, c - 32, &posX, &posY, &q, 1);
-
-    float x0 = q.x0 * scale;
-    float x1 = q.x1 * scale;
-
-    float width = x1 - x0;
-    posX += width;
+  return Vector2{ totalWidth, posY };
+}
 
-    if (posX > maxWidth) {
-      maxWidth = posX;
+const GlyphMetrics&
+BatchRenderer::Font::Metrics(float fontSize)
+{
+  for (const std::unique_ptr<GlyphMetrics>& cached : metrics) {
+    if (cached->fontSize == fontSize) {
+      return *cached;
     }
   }
 
-  float totalWidth = 0;
-  // float scale = stbtt_ScaleForPixelHeight(&fontData.fontInfo, fontSize);
+  auto glyphs = std::make_unique<GlyphMetrics>();
+  glyphs->fontSize = fontSize;
 
-  for (size_t i = 0; i < strlen(text); ++i) {
-    char c = text[i];
+  float scale = stbtt_ScaleForPixelHeight(&fontInfo, fontSize);
+  for (int32_t i = 0; i < 128; ++i) {
     int32_t advance, lsb;
-    stbtt_GetCodepointHMetrics(&fontData.fontInfo, c, &advance, &lsb);
-    totalWidth += advance * scale;
+    stbtt_GetCodepointHMetrics(&fontInfo, i, &advance, &lsb);
+    glyphs->advances[i] = advance * scale;
   }
+  glyphs->DetectMonospace();
 
-  //  return totalWidth;
+  // the rest of Unicode is looked up as it's met
+  glyphs->font = &fontInfo;
+  glyphs->fontScale = scale;
+  glyphs->fontAdvance = [](const void* font, uint32_t codepoint) {
+    int32_t advance, lsb;
+    stbtt_GetCodepointHMetrics(static_cast<const stbtt_fontinfo*>(font),
+                               static_cast<int>(codepoint),
+                               &advance,
+                               &lsb);
+    return static_cast<float>(advance);
+  };
 
-  return Vector2{ totalWidth, posY };
+  metrics.push_back(std::move(glyphs));
+  return *metrics.back();
 }
 
 void
 BatchRenderer::Render(WGPURenderPassEncoder passEncoder)
 {
-  if (quads.empty())
-    return;
+  PROFILE_ZONE("batch render");
 
-  // sorting the quads based on drawOrder (ascending order)
-  std::stable_sort(
-    quads.begin(), quads.end(), [](const Quad& a, const Quad& b) {
-      return a.drawOrder < b.drawOrder;
-    });
-
-  vertices.clear();
-  indices.clear();
-  numQuads = 0;
-
-  // batch sorted quads
-  for (const auto& quad : quads) {
-    uint16_t baseIndex = static_cast<uint16_t>(numQuads * 4);
-    for (auto index : quad.indices) {
-      indices.push_back(baseIndex + index);
+  if (size_t dropped = batch.Dropped()) {
+    if (droppedQuads == 0) {
+      std::cerr << "Dropped " << dropped << " quads past the limit of "
+                << MAX_QUADS << " in a frame" << std::endl;
     }
-    vertices.insert(vertices.end(), quad.vertices.begin(), quad.vertices.end());
-    numQuads++;
+    droppedQuads += dropped;
   }
 
-  // upload data to GPU buffers
-  wgpuQueueWriteBuffer(
-    queue, vertexBuffer, 0, vertices.data(), vertices.size() * sizeof(Vertex));
-  wgpuQueueWriteBuffer(
-    queue, indexBuffer, 0, indices.data(), indices.size() * sizeof(uint16_t));
+  // glyphs rasterised this frame go up before anything samples them
+  bool atlasRecreated = glyphAtlas.Flush();
+  if (textureRegistry.Recreated() || atlasRecreated) {
+    CreateBindGroup();
+  }
+  glyphAtlas.EndFrame();
+
+  size_t numQuads = batch.Size();
+  const std::vector<const ResidentQuads::Block*>& resident = residents.Kept();
+  if (numQuads == 0 && resident.empty()) {
+    residents.EndFrame();
+    return;
+  }
+
+  // quads in draw order (ascending), equal orders keep submission order
+  batch.Sort();
+
+  // upload what the frame uses into its region of the ring, the indices
+  // never change
+  uint64_t instanceBytes = batch.InstanceCount() * sizeof(QuadInstance);
+  uint64_t vertexBytes =
+    batch.VertexQuadCount() * QuadBatch::VERTICES_PER_QUAD * sizeof(Vertex);
+  uploads.BeginFrame(instanceBytes + vertexBytes + 4);
+  UploadRing::Slice instances = uploads.Write(batch.Instances(), instanceBytes);
+  UploadRing::Slice vertices = uploads.Write(batch.Vertices(), vertexBytes);
+  uploads.Flush();
+  if (onUpload) {
+    onUpload({ uploads.FrameBytes() + residents.FrameBytes(),
+               uploads.CurrentRegion(),
+               uploads.RegionCount() });
+  }
 
   // update uniforms
   currentUniforms.uTime = static_cast<float>(SDL_GetTicks()) / 1000.0f;
@@ -879,24 +915,143 @@ BatchRenderer::Render(WGPURenderPassEncoder passEncoder)
   currentUniforms.uProjection =
     matrix4_orthographic(left, right, bottom, top, near, far);
 
+  // the frame's quads are where they were written, resident ones scroll
+  currentUniforms.uScroll = { 0.0f, 0.0f };
   wgpuQueueWriteBuffer(
     queue, uniformBuffer, 0, &currentUniforms, sizeof(Uniforms));
+  currentUniforms.uScroll = scroll;
+  wgpuQueueWriteBuffer(
+    queue, uniformBuffer, UNIFORM_STRIDE, &currentUniforms, sizeof(Uniforms));
 
-  // set pipeline and buffers
-  wgpuRenderPassEncoderSetPipeline(passEncoder, pipeline);
-  wgpuRenderPassEncoderSetVertexBuffer(
-    passEncoder, 0, vertexBuffer, 0, WGPU_WHOLE_SIZE);
+  // set bind group for textures, both pipelines share it
+  uint32_t uniformOffset = 0;
+  wgpuRenderPassEncoderSetBindGroup(
+    passEncoder, 0, bindGroup, 1, &uniformOffset);
   wgpuRenderPassEncoderSetIndexBuffer(
     passEncoder, indexBuffer, WGPUIndexFormat_Uint16, 0, WGPU_WHOLE_SIZE);
 
-  // set bind group for textures
-  wgpuRenderPassEncoderSetBindGroup(passEncoder, 0, bindGroup, 0, nullptr);
+  // resident blocks go in before the frame's quads of their draw order
+  size_t nextResident = 0;
+  auto drawResident = [&](int32_t drawOrder) {
+    if (nextResident == resident.size() ||
+        resident[nextResident]->drawOrder > drawOrder) {
+      return;
+    }
 
-  // draw quads
-  wgpuRenderPassEncoderDrawIndexed(passEncoder, numQuads * 6, 1, 0, 0, 0);
+    // the clip has to stay inside the target
+    float x0 = std::clamp(scrollClip.min.x, 0.0f, right);
+    float y0 = std::clamp(scrollClip.min.y, 0.0f, bottom);
+    float x1 = std::clamp(scrollClip.max.x, x0, right);
+    float y1 = std::clamp(scrollClip.max.y, y0, bottom);
+    wgpuRenderPassEncoderSetScissorRect(passEncoder,
+                                        static_cast<uint32_t>(x0),
+                                        static_cast<uint32_t>(y0),
+                                        static_cast<uint32_t>(x1 - x0),
+                                        static_cast<uint32_t>(y1 - y0));
+    uniformOffset = UNIFORM_STRIDE;
+    wgpuRenderPassEncoderSetBindGroup(
+      passEncoder, 0, bindGroup, 1, &uniformOffset);
+    wgpuRenderPassEncoderSetPipeline(passEncoder, instancePipeline);
+
+    for (; nextResident < resident.size() &&
+           resident[nextResident]->drawOrder <= drawOrder;
+         ++nextResident) {
+      const ResidentQuads::Block* block = resident[nextResident];
+      if (block->count == 0) {
+        continue;
+      }
+      wgpuRenderPassEncoderSetVertexBuffer(
+        passEncoder, 0, block->buffer, 0, block->count * sizeof(QuadInstance));
+      wgpuRenderPassEncoderDraw(
+        passEncoder, QuadBatch::INDICES_PER_QUAD, block->count, 0, 0);
+    }
+
+    wgpuRenderPassEncoderSetScissorRect(passEncoder,
+                                        0,
+                                        0,
+                                        static_cast<uint32_t>(right),
+                                        static_cast<uint32_t>(bottom));
+    uniformOffset = 0;
+    wgpuRenderPassEncoderSetBindGroup(
+      passEncoder, 0, bindGroup, 1, &uniformOffset);
+  };
+
+  // draw quads, switching pipelines where the draw order interleaves them
+  for (const QuadRun& run : batch.Runs()) {
+    drawResident(run.drawOrder);
+    if (!(run.instanced ? instances.buffer : vertices.buffer)) {
+      continue; // the region couldn't be allocated
+    }
+    if (run.instanced) {
+      wgpuRenderPassEncoderSetPipeline(passEncoder, instancePipeline);
+      wgpuRenderPassEncoderSetVertexBuffer(
+        passEncoder, 0, instances.buffer, instances.offset, instances.size);
+      wgpuRenderPassEncoderDraw(passEncoder,
+                                QuadBatch::INDICES_PER_QUAD,
+                                run.count,
+                                0,
+                                run.first);
+    } else {
+      wgpuRenderPassEncoderSetPipeline(passEncoder, pipeline);
+      wgpuRenderPassEncoderSetVertexBuffer(
+        passEncoder, 0, vertices.buffer, vertices.offset, vertices.size);
+      for (uint32_t drawn = 0; drawn < run.count;) {
+        uint32_t quads =
+          std::min(run.count - drawn, QuadBatch::QUADS_PER_INDEXED_DRAW);
+        int32_t baseVertex =
+          (run.first + drawn) * QuadBatch::VERTICES_PER_QUAD;
+        wgpuRenderPassEncoderDrawIndexed(passEncoder,
+                                         quads * QuadBatch::INDICES_PER_QUAD,
+                                         1,
+                                         0,
+                                         baseVertex,
+                                         0);
+        drawn += quads;
+      }
+    }
+  }
+  drawResident(INT32_MAX);
 
   // reset for next frame
-  quads.clear();
+  batch.Clear();
+  residents.EndFrame();
+}
+
+void
+BatchRenderer::SetScroll(Vector2 scroll, BoundingBox clip)
+{
+  this->scroll = scroll;
+  scrollClip = clip;
+}
+
+bool
+BatchRenderer::KeepResident(uint64_t key, uint64_t stamp, int32_t drawOrder)
+{
+  return residents.Keep(key, stamp, drawOrder);
+}
+
+void
+BatchRenderer::AddResident(uint64_t key,
+                           uint64_t stamp,
+                           int32_t drawOrder,
+                           const QuadInstance* instances,
+                           size_t count)
+{
+  residents.Upload(key, stamp, drawOrder, instances, count);
+}
+
+void
+BatchRenderer::FrameSubmitted()
+{
+  gpuTimer.Submitted();
+
+  gpuTimes.clear();
+  gpuTimer.Collect(gpuTimes);
+  if (onGpuTime) {
+    for (float ms : gpuTimes) {
+      onGpuTime(ms);
+    }
+  }
 }
 
 void
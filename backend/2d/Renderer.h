@@ -1,11 +1,21 @@
 #pragma once
 
+#include "../../GlyphMetrics.h"
 #include "../../Math.h"
+#include "GlyphAtlas.h"
+#include "GpuTimer.h"
+#include "QuadBatch.h"
+#include "ResidentQuads.h"
+#include "TextureRegistry.h"
+#include "UploadRing.h"
 #include "SDL3/SDL.h"
 #include "SDL3/SDL_events.h"
 #include "webgpu/webgpu.h"
 #include "wgpu/wgpu.h"
+#include <functional>
+#include <memory>
 #include <stdint.h>
+#include <string_view>
 #include <vector>
 
 #include "stb/stb_image.h"
@@ -53,24 +63,41 @@ enum Layer
   LAYER_TEXT = 3
 };
 
-struct Vertex
-{
-  Vector2 position; // relative to the origin
-  Vector4 color;
-  Vector2 texCoord;
-  float rotation; // angle in radians
-  uint32_t texIndex;
-  Vector2 translation; // per quad translation
-  float padding;       // align to 16 bytes
-};
-
+// Render() writes two blocks, UNIFORM_STRIDE apart, that differ only in
+// uScroll: zero for the frame's quads, the scroll for resident ones
 struct Uniforms
 {
   float uTime;
-  float padding[3]; // enforce 16-byte alignment
+  float padding;
+  Vector2 uScroll; // added to every translation
   Matrix4 uProjection;
 };
 
+constexpr uint32_t UNIFORM_STRIDE = 256; // minUniformBufferOffsetAlignment
+
+// QuadInstance::texIndex has what a quad samples in the low byte and the
+// texture layer or glyph page above it
+enum QuadKind : uint32_t
+{
+  QUAD_SOLID = 0,
+  QUAD_TEXTURE = 1,
+  QUAD_GLYPH = 2
+};
+
+constexpr uint32_t
+PackTexIndex(QuadKind kind, uint32_t layer)
+{
+  return kind | layer << 8;
+}
+
+// what a frame uploaded, handed to BatchRenderer::onUpload
+struct UploadStats
+{
+  uint64_t bytes; // vertex and instance data, as written, resident included
+  uint32_t region;
+  uint32_t regions;
+};
+
 struct Texture
 {
   WGPUTexture texture;
@@ -87,13 +114,6 @@ struct SpriteFrameDesc
   Vector2 sprite_size;
 };
 
-struct Quad
-{
-  std::vector<Vertex> vertices;
-  std::vector<uint16_t> indices;
-  int32_t drawOrder;
-};
-
 class BatchRenderer
 {
 public:
@@ -103,7 +123,17 @@ public:
                 int32_t height);
   ~BatchRenderer();
   void Initialize();
-  void LoadTexture(const char* filePath, int32_t textureIndex);
+
+  // the pipeline has to match the pass it draws into, it's rebuilt when
+  // either changes
+  void SetTarget(WGPUTextureFormat format, uint32_t sampleCount);
+
+  // a texture for AddTexturedQuad(), its layer in the texture registry.
+  // TextureRegistry::NO_TEXTURE when it can't be loaded or is too large.
+  uint32_t RegisterTexture(const char* filePath);
+  uint32_t RegisterTexture(const uint8_t* pixels,
+                           uint32_t width,
+                           uint32_t height);
   void LoadFont(const char* fontFilePath);
 
   void AddQuad(Vector2 position,
@@ -118,7 +148,7 @@ public:
                        float width,
                        float height,
                        float texCoords[4][2],
-                       uint32_t texIndex,
+                       uint32_t texture,
                        Vector4 color,
                        float rotation,
                        Vector2 origin,
@@ -138,47 +168,133 @@ public:
                 Vector4 color,
                 int32_t drawOrder);
 
+  void DrawText(std::string_view text,
+                Vector2 position,
+                float fontSize,
+                Vector4 color,
+                int32_t drawOrder);
+
+  // Glyph instances of `text` with the pen at `position`, appended to `out`.
+  // Glyphs only depend on the pen through a translation, so a run built once
+  // can be drawn anywhere with AddInstances().
+  void BuildText(std::string_view text,
+                 Vector2 position,
+                 float fontSize,
+                 Vector4 color,
+                 std::vector<QuadInstance>& out);
+
+  // draws instances built earlier, moved by `offset`
+  void AddInstances(const QuadInstance* instances,
+                    size_t count,
+                    Vector2 offset,
+                    int32_t drawOrder);
+
+  // GPU-side scrolling. Resident blocks of instances stay uploaded across
+  // frames (see ResidentQuads) and are drawn moved by `scroll`, which only
+  // goes into the uniforms, clipped to `clip`. A block is drawn before the
+  // frame's quads of its draw order.
+  void SetScroll(Vector2 scroll, BoundingBox clip);
+
+  // draws the block this frame if it was uploaded with `stamp`, false when
+  // it has to be added again
+  bool KeepResident(uint64_t key, uint64_t stamp, int32_t drawOrder);
+
+  void AddResident(uint64_t key,
+                   uint64_t stamp,
+                   int32_t drawOrder,
+                   const QuadInstance* instances,
+                   size_t count);
+
   Vector2 MeasureText(const char* text, float fontSize);
   void Render(WGPURenderPassEncoder passEncoder);
 
+  // timestamps for the frame's render pass, nullptr when the GPU isn't
+  // timed. Call once a frame for its WGPURenderPassDescriptor.
+  const WGPURenderPassTimestampWrites* PassTimestamps()
+  {
+    return gpuTimer.BeginFrame();
+  }
+
+  // after the pass ended, before the encoder is finished
+  void ResolveTimestamps(WGPUCommandEncoder encoder)
+  {
+    gpuTimer.Resolve(encoder);
+  }
+
+  // reads back timestamps, call after the queue submit
+  void FrameSubmitted();
+
+  // quads that didn't fit in a frame since startup
+  uint64_t DroppedQuads() const { return droppedQuads; }
+
+  // changes when glyphs were evicted from the atlas, instances built by
+  // BuildText() before may show the wrong glyphs
+  uint64_t GlyphGeneration() const { return glyphAtlas.Generation(); }
+
+  // called from Render() with the frame's uploads
+  std::function<void(const UploadStats&)> onUpload;
+
+  // called from FrameSubmitted() with the pass time, in ms, of a frame a few
+  // frames back. Never called without timestamp queries.
+  std::function<void(float)> onGpuTime;
+
   int32_t windowWidth;
   int32_t windowHeight;
 
 private:
   WGPUDevice device;
   WGPUQueue queue;
-  WGPURenderPipeline pipeline;
-  WGPUBuffer vertexBuffer;
+  WGPURenderPipeline pipeline;         // Vertex quads (lines)
+  WGPURenderPipeline instancePipeline; // QuadInstance quads
+  WGPUTextureFormat targetFormat;
+  uint32_t targetSamples;
   WGPUBuffer indexBuffer;
   WGPUBuffer uniformBuffer;
-  std::vector<Vertex> vertices;
-  std::vector<uint16_t> indices;
-  size_t numQuads;
+  UploadRing uploads;
+  ResidentQuads residents;
+  GpuTimer gpuTimer;
+  std::vector<float> gpuTimes;
+  Vector2 scroll;
+  BoundingBox scrollClip;
 
   void CreatePipeline();
   void CreateBuffers();
   void CreateBindGroup();
+  void CreateSamplers();
 
   WGPUShaderModule vertexShaderModule;
+  WGPUShaderModule instanceShaderModule;
   WGPUShaderModule fragmentShaderModule;
 
   WGPUBindGroupLayout bindGroupLayout;
   WGPUBindGroup bindGroup;
-  Texture textures[2];
+  TextureRegistry textureRegistry;
+  WGPUSampler textureSampler;
+  WGPUSampler fontSampler;
   Uniforms currentUniforms;
 
-  std::vector<Quad> quads;
+  // the batch starts with room for INITIAL_QUADS and doubles from there,
+  // MAX_QUADS only guards against runaway submissions
+  static constexpr uint32_t INITIAL_QUADS = 16384;
+  static constexpr uint32_t MAX_QUADS = 1u << 19;
 
-  const uint32_t MAX_QUADS = 10000;
+  QuadBatch batch;
+  uint64_t droppedQuads;
+  GlyphAtlas glyphAtlas;
+  std::vector<QuadInstance> textScratch; // DrawText() glyphs
 
 public:
   struct Font
   {
     stbtt_fontinfo fontInfo;
     uint8_t* fontBuffer;
-    uint8_t* bitmap;
-    stbtt_bakedchar cdata[96]; // ASCII 32..126 is 95 glyphs (sorry but no
-                               // Georgian lang support for now...)
+
+    // advance tables are built once per font size and shared by everything
+    // that measures text, references stay valid for the font's lifetime
+    const GlyphMetrics& Metrics(float fontSize);
+
+  private:
+    std::vector<std::unique_ptr<GlyphMetrics>> metrics;
   } fontData;
 };
 
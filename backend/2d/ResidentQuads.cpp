@@ -0,0 +1,124 @@
+#include "ResidentQuads.h"
+
+#include <algorithm>
+#include <iostream>
+
+ResidentQuads::ResidentQuads(WGPUDevice device, WGPUQueue queue)
+  : device(device)
+  , queue(queue)
+{
+  // kept holds pointers into it
+  blocks.reserve(MAX_BLOCKS);
+}
+
+ResidentQuads::~ResidentQuads()
+{
+  for (Block& block : blocks) {
+    if (block.buffer) {
+      wgpuBufferRelease(block.buffer);
+    }
+  }
+}
+
+ResidentQuads::Block*
+ResidentQuads::Find(uint64_t key)
+{
+  for (Block& block : blocks) {
+    if (block.key == key) {
+      return &block;
+    }
+  }
+  return nullptr;
+}
+
+bool
+ResidentQuads::Keep(uint64_t key, uint64_t stamp, int32_t drawOrder)
+{
+  Block* block = Find(key);
+  if (!block || block->stamp != stamp) {
+    return false;
+  }
+  if (block->keptFrame != frame) {
+    block->keptFrame = frame;
+    kept.push_back(block);
+  }
+  block->drawOrder = drawOrder;
+  return true;
+}
+
+void
+ResidentQuads::Upload(uint64_t key,
+                      uint64_t stamp,
+                      int32_t drawOrder,
+                      const QuadInstance* instances,
+                      size_t count)
+{
+  Block* block = Find(key);
+  if (!block && blocks.size() < MAX_BLOCKS) {
+    blocks.emplace_back();
+    block = &blocks.back();
+  } else if (!block) {
+    // the least recently kept block, never one drawn this frame
+    block = &*std::min_element(
+      blocks.begin(), blocks.end(), [](const Block& a, const Block& b) {
+        return a.keptFrame < b.keptFrame;
+      });
+    if (block->keptFrame == frame) {
+      std::cerr << "More than " << MAX_BLOCKS << " resident blocks in a frame"
+                << std::endl;
+      return;
+    }
+  }
+
+  uint64_t bytes = count * sizeof(QuadInstance);
+  if (bytes > block->size) {
+    if (block->buffer) {
+      wgpuBufferRelease(block->buffer);
+    }
+    uint64_t size = block->size ? block->size : 64 * sizeof(QuadInstance);
+    while (size < bytes) {
+      size *= 2;
+    }
+
+    WGPUBufferDescriptor bufferDesc = {};
+    bufferDesc.label = "Resident quads";
+    bufferDesc.size = size;
+    bufferDesc.usage = WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst;
+    bufferDesc.mappedAtCreation = false;
+    block->buffer = wgpuDeviceCreateBuffer(device, &bufferDesc);
+    block->size = size;
+    if (!block->buffer) {
+      std::cerr << "Failed to create a " << size << " byte resident block"
+                << std::endl;
+      *block = Block(); // uploaded again next frame
+      return;
+    }
+  }
+
+  block->key = key;
+  block->stamp = stamp;
+  block->count = static_cast<uint32_t>(count);
+  if (count) {
+    wgpuQueueWriteBuffer(queue, block->buffer, 0, instances, bytes);
+    frameBytes += bytes;
+  }
+  Keep(key, stamp, drawOrder);
+}
+
+const std::vector<const ResidentQuads::Block*>&
+ResidentQuads::Kept()
+{
+  std::stable_sort(
+    kept.begin(), kept.end(), [](const Block* a, const Block* b) {
+      return a->drawOrder < b->drawOrder;
+    });
+  return kept;
+}
+
+void
+ResidentQuads::EndFrame()
+{
+  kept.clear();
+  frame++;
+  frameBytes = 0;
+}
@@ -0,0 +1,67 @@
+/**
+ * $file backend/2d/ResidentQuads.h
+ */
+#pragma once
+
+#include "QuadBatch.h"
+#include "webgpu/webgpu.h"
+#include "wgpu/wgpu.h"
+#include <stdint.h>
+#include <vector>
+
+// Blocks of instances that stay uploaded across frames. The caller keys a
+// block and stamps it with whatever its contents depend on, a block kept
+// with the stamp it was uploaded with costs nothing but its draw. Blocks
+// that weren't kept in a frame stay uploaded for when they come back, past
+// MAX_BLOCKS the least recently kept one is reused.
+class ResidentQuads
+{
+public:
+  static constexpr size_t MAX_BLOCKS = 32;
+
+  struct Block
+  {
+    uint64_t key = 0;
+    uint64_t stamp = 0;
+    int32_t drawOrder = 0;
+    uint32_t count = 0;
+    WGPUBuffer buffer = nullptr;
+    uint64_t size = 0;
+    uint64_t keptFrame = 0;
+  };
+
+  ResidentQuads(WGPUDevice device, WGPUQueue queue);
+  ~ResidentQuads();
+
+  ResidentQuads(const ResidentQuads&) = delete;
+  ResidentQuads& operator=(const ResidentQuads&) = delete;
+
+  // draws the block this frame if it holds `stamp`, false when it has to
+  // be uploaded
+  bool Keep(uint64_t key, uint64_t stamp, int32_t drawOrder);
+
+  // uploads the block and draws it this frame
+  void Upload(uint64_t key,
+              uint64_t stamp,
+              int32_t drawOrder,
+              const QuadInstance* instances,
+              size_t count);
+
+  // the blocks kept this frame by draw order, valid until EndFrame()
+  const std::vector<const Block*>& Kept();
+
+  // bytes uploaded this frame
+  uint64_t FrameBytes() const { return frameBytes; }
+
+  void EndFrame();
+
+private:
+  Block* Find(uint64_t key);
+
+  WGPUDevice device;
+  WGPUQueue queue;
+  std::vector<Block> blocks;
+  std::vector<const Block*> kept;
+  uint64_t frame = 1;
+  uint64_t frameBytes = 0;
+};
@@ -0,0 +1,120 @@
+#include "TextureRegistry.h"
+
+#include <iostream>
+
+TextureRegistry::TextureRegistry(WGPUDevice device, WGPUQueue queue)
+  : device(device)
+  , queue(queue)
+{
+  CreateArray(INITIAL_LAYERS);
+}
+
+TextureRegistry::~TextureRegistry()
+{
+  if (view)
+    wgpuTextureViewRelease(view);
+  if (texture)
+    wgpuTextureRelease(texture);
+}
+
+uint32_t
+TextureRegistry::Register(const uint8_t* pixels,
+                          uint32_t width,
+                          uint32_t height)
+{
+  if (width > LAYER_SIZE || height > LAYER_SIZE) {
+    std::cerr << "Texture of " << width << "x" << height
+              << " is larger than a " << LAYER_SIZE << " texture layer"
+              << std::endl;
+    return NO_TEXTURE;
+  }
+
+  uint32_t layer = Count();
+  if (layer == layers) {
+    CreateArray(layers * 2);
+  }
+  scales.push_back({ static_cast<float>(width) / LAYER_SIZE,
+                     static_cast<float>(height) / LAYER_SIZE });
+
+  WGPUImageCopyTexture copyTexture = {
+    .texture = texture,
+    .mipLevel = 0,
+    .origin = { 0, 0, layer },
+    .aspect = WGPUTextureAspect_All,
+  };
+
+  WGPUTextureDataLayout textureDataLayout = {
+    .offset = 0,
+    .bytesPerRow = width * 4,
+    .rowsPerImage = height,
+  };
+
+  WGPUExtent3D textureExtent3D{
+    .width = width,
+    .height = height,
+    .depthOrArrayLayers = 1,
+  };
+  wgpuQueueWriteTexture(queue,
+                        &copyTexture,
+                        pixels,
+                        size_t(width) * height * 4,
+                        &textureDataLayout,
+                        &textureExtent3D);
+  return layer;
+}
+
+void
+TextureRegistry::CreateArray(uint32_t count)
+{
+  WGPUTextureDescriptor textureDesc = {};
+  textureDesc.label = "Texture registry";
+  textureDesc.size.width = LAYER_SIZE;
+  textureDesc.size.height = LAYER_SIZE;
+  textureDesc.size.depthOrArrayLayers = count;
+  textureDesc.mipLevelCount = 1;
+  textureDesc.sampleCount = 1;
+  textureDesc.dimension = WGPUTextureDimension_2D;
+  textureDesc.format = WGPUTextureFormat_RGBA8Unorm;
+  textureDesc.usage = WGPUTextureUsage_TextureBinding |
+                      WGPUTextureUsage_CopyDst | WGPUTextureUsage_CopySrc;
+  WGPUTexture grown = wgpuDeviceCreateTexture(device, &textureDesc);
+
+  // layers in use move over on the queue, ahead of anything drawn after
+  if (texture && Count()) {
+    WGPUCommandEncoder encoder =
+      wgpuDeviceCreateCommandEncoder(device, nullptr);
+    WGPUImageCopyTexture source = {
+      .texture = texture,
+      .mipLevel = 0,
+      .origin = { 0, 0, 0 },
+      .aspect = WGPUTextureAspect_All,
+    };
+    WGPUImageCopyTexture destination = source;
+    destination.texture = grown;
+    WGPUExtent3D extent = { LAYER_SIZE, LAYER_SIZE, Count() };
+    wgpuCommandEncoderCopyTextureToTexture(
+      encoder, &source, &destination, &extent);
+    WGPUCommandBuffer commands = wgpuCommandEncoderFinish(encoder, nullptr);
+    wgpuQueueSubmit(queue, 1, &commands);
+    wgpuCommandBufferRelease(commands);
+    wgpuCommandEncoderRelease(encoder);
+  }
+
+  if (view)
+    wgpuTextureViewRelease(view);
+  if (texture)
+    wgpuTextureRelease(texture);
+  texture = grown;
+  layers = count;
+
+  WGPUTextureViewDescriptor viewDesc = {};
+  viewDesc.format = WGPUTextureFormat_RGBA8Unorm;
+  viewDesc.dimension = WGPUTextureViewDimension_2DArray;
+  viewDesc.baseMipLevel = 0;
+  viewDesc.mipLevelCount = 1;
+  viewDesc.baseArrayLayer = 0;
+  viewDesc.arrayLayerCount = layers;
+  viewDesc.aspect = WGPUTextureAspect_All;
+  view = wgpuTextureCreateView(texture, &viewDesc);
+  recreated = true;
+}
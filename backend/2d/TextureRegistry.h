@@ -0,0 +1,65 @@
+/**
+ * $file backend/2d/TextureRegistry.h
+ */
+#pragma once
+
+#include "../../Math.h"
+#include "webgpu/webgpu.h"
+#include "wgpu/wgpu.h"
+#include <stdint.h>
+#include <vector>
+
+// Every texture quads are drawn with, as layers of one RGBA8 texture array
+// that is bound once. A texture goes into the top left corner of a layer of
+// its own and keeps that layer for good, quads pick it by index and their
+// texture coordinates are scaled to the corner with Scale(). Coordinates
+// clamp at the layer's edge, not the texture's.
+//
+// The array doubles its layers when it's full, the layers already in use
+// are copied over on the GPU.
+class TextureRegistry
+{
+public:
+  static constexpr uint32_t LAYER_SIZE = 1024;
+  static constexpr uint32_t INITIAL_LAYERS = 4;
+  static constexpr uint32_t NO_TEXTURE = UINT32_MAX;
+
+  TextureRegistry(WGPUDevice device, WGPUQueue queue);
+  ~TextureRegistry();
+
+  TextureRegistry(const TextureRegistry&) = delete;
+  TextureRegistry& operator=(const TextureRegistry&) = delete;
+
+  // layer of a new texture from RGBA8 `pixels`, NO_TEXTURE when it's
+  // larger than a layer
+  uint32_t Register(const uint8_t* pixels, uint32_t width, uint32_t height);
+
+  // from the texture's coordinates to the layer's
+  Vector2 Scale(uint32_t layer) const
+  {
+    return layer < scales.size() ? scales[layer] : Vector2{ 1.0f, 1.0f };
+  }
+
+  uint32_t Count() const { return static_cast<uint32_t>(scales.size()); }
+  WGPUTextureView View() const { return view; }
+
+  // true once after the array was recreated, the views bound to it have to
+  // follow
+  bool Recreated()
+  {
+    bool changed = recreated;
+    recreated = false;
+    return changed;
+  }
+
+private:
+  void CreateArray(uint32_t layers);
+
+  WGPUDevice device;
+  WGPUQueue queue;
+  WGPUTexture texture = nullptr;
+  WGPUTextureView view = nullptr;
+  uint32_t layers = 0;
+  bool recreated = false;
+  std::vector<Vector2> scales; // by layer
+};
@@ -0,0 +1,174 @@
+#include "UploadRing.h"
+
+#include <iostream>
+#include <string.h>
+
+UploadRing::UploadRing(WGPUDevice device, WGPUQueue queue, uint64_t regionSize)
+  : device(device)
+  , queue(queue)
+  , regionSize(regionSize)
+  , current(REGIONS - 1)
+{
+  for (size_t i = 0; i < REGIONS; ++i) {
+    regions.push_back(std::make_unique<Region>());
+    regions.back()->ring = this;
+  }
+}
+
+UploadRing::~UploadRing()
+{
+  // OnMapped holds on to the regions, let the maps finish first
+  while (pending > 0) {
+    wgpuDevicePoll(device, true, nullptr);
+  }
+  for (std::unique_ptr<Region>& region : regions) {
+    if (region->buffer) {
+      wgpuBufferRelease(region->buffer);
+    }
+  }
+  if (target) {
+    wgpuBufferRelease(target);
+  }
+}
+
+void
+UploadRing::CreateRegion(Region& region, uint64_t bytes)
+{
+  // nothing reads the region any more, the old buffer can go right away
+  if (region.buffer) {
+    wgpuBufferRelease(region.buffer);
+  }
+  uint64_t size = region.size ? region.size : regionSize;
+  while (size < bytes) {
+    size *= 2;
+  }
+
+  WGPUBufferDescriptor bufferDesc = {};
+  bufferDesc.label = "Upload ring region";
+  bufferDesc.size = size;
+  bufferDesc.usage = WGPUBufferUsage_MapWrite | WGPUBufferUsage_CopySrc;
+  bufferDesc.mappedAtCreation = true;
+  region.buffer = wgpuDeviceCreateBuffer(device, &bufferDesc);
+  region.size = region.buffer ? size : 0;
+  region.state = region.buffer ? RegionState::Mapped : RegionState::Lost;
+  if (!region.buffer) {
+    std::cerr << "Failed to create a " << size << " byte upload region"
+              << std::endl;
+  }
+}
+
+void
+UploadRing::GrowTarget(uint64_t bytes)
+{
+  // draws already submitted keep the old buffer alive
+  if (target) {
+    wgpuBufferRelease(target);
+  }
+  uint64_t size = targetSize ? targetSize : regionSize;
+  while (size < bytes) {
+    size *= 2;
+  }
+
+  WGPUBufferDescriptor bufferDesc = {};
+  bufferDesc.label = "Upload ring target";
+  bufferDesc.size = size;
+  bufferDesc.usage = WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst;
+  bufferDesc.mappedAtCreation = false;
+  target = wgpuDeviceCreateBuffer(device, &bufferDesc);
+  targetSize = target ? size : 0;
+  if (!target) {
+    std::cerr << "Failed to create a " << size << " byte vertex buffer"
+              << std::endl;
+  }
+}
+
+void
+UploadRing::BeginFrame(uint64_t bytes)
+{
+  current = (current + 1) % regions.size();
+  if (regions[current]->state == RegionState::Pending) {
+    // callbacks only run while the device is polled
+    wgpuDevicePoll(device, false, nullptr);
+  }
+  if (regions[current]->state == RegionState::Pending) {
+    if (regions.size() < MAX_REGIONS) {
+      regions.insert(regions.begin() + current, std::make_unique<Region>());
+      regions[current]->ring = this;
+    } else {
+      while (regions[current]->state == RegionState::Pending) {
+        wgpuDevicePoll(device, true, nullptr);
+      }
+    }
+  }
+
+  Region& region = *regions[current];
+  if (region.state == RegionState::Lost || region.size < bytes) {
+    CreateRegion(region, bytes);
+  }
+  if (targetSize < bytes) {
+    GrowTarget(bytes);
+  }
+
+  mapped = nullptr;
+  if (region.state == RegionState::Mapped) {
+    mapped = static_cast<uint8_t*>(
+      wgpuBufferGetMappedRange(region.buffer, 0, region.size));
+  }
+  frameBytes = 0;
+}
+
+UploadRing::Slice
+UploadRing::Write(const void* data, uint64_t bytes)
+{
+  Region& region = *regions[current];
+  uint64_t offset = (frameBytes + 3) & ~uint64_t(3);
+  if (!mapped || !target || offset + bytes > region.size ||
+      offset + bytes > targetSize) {
+    return { nullptr, 0, 0 };
+  }
+  memcpy(mapped + offset, data, bytes);
+  frameBytes = offset + bytes;
+  return { target, offset, bytes };
+}
+
+void
+UploadRing::Flush()
+{
+  if (!mapped) {
+    return;
+  }
+  mapped = nullptr;
+
+  Region& region = *regions[current];
+  wgpuBufferUnmap(region.buffer);
+
+  // copies go in whole words, regions and the target are sized in them
+  uint64_t copyBytes = (frameBytes + 3) & ~uint64_t(3);
+  if (copyBytes > 0) {
+    WGPUCommandEncoderDescriptor encoderDesc = {};
+    encoderDesc.label = "Upload ring copy";
+    WGPUCommandEncoder encoder =
+      wgpuDeviceCreateCommandEncoder(device, &encoderDesc);
+    wgpuCommandEncoderCopyBufferToBuffer(
+      encoder, region.buffer, 0, target, 0, copyBytes);
+    WGPUCommandBuffer commands = wgpuCommandEncoderFinish(encoder, nullptr);
+    wgpuQueueSubmit(queue, 1, &commands);
+    wgpuCommandBufferRelease(commands);
+    wgpuCommandEncoderRelease(encoder);
+  }
+
+  region.state = RegionState::Pending;
+  pending++;
+  wgpuBufferMapAsync(
+    region.buffer, WGPUMapMode_Write, 0, region.size, OnMapped, &region);
+}
+
+void
+UploadRing::OnMapped(WGPUBufferMapAsyncStatus status, void* userdata)
+{
+  Region* region = static_cast<Region*>(userdata);
+  region->state = status == WGPUBufferMapAsyncStatus_Success
+                    ? RegionState::Mapped
+                    : RegionState::Lost;
+  region->ring->pending--;
+}
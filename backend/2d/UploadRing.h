@@ -0,0 +1,95 @@
+/**
+ * $file backend/2d/UploadRing.h
+ */
+#pragma once
+
+#include "webgpu/webgpu.h"
+#include "wgpu/wgpu.h"
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+// Per-frame vertex uploads are written straight into a ring of mapped
+// staging regions, each a MapWrite buffer of its own. A frame sub-allocates
+// slices from the start of its region, then Flush() unmaps it and copies
+// what was written into the vertex buffer the draws read, in a submit of
+// its own ahead of the frame's.
+//
+// The region is mapped again right after that copy. The map only completes
+// once the GPU is done copying out of it, so it's the region's fence: a
+// region comes round again only when it's mapped, and a frame never writes
+// into memory the GPU still reads. Copies into the vertex buffer are
+// ordered on the queue behind the draws of earlier frames.
+//
+// When the GPU falls a whole ring behind, a region is added in front of the
+// busy one rather than waiting on it, up to MAX_REGIONS.
+class UploadRing
+{
+public:
+  static constexpr size_t REGIONS = 3;
+  static constexpr size_t MAX_REGIONS = 8;
+
+  struct Slice
+  {
+    WGPUBuffer buffer;
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  UploadRing(WGPUDevice device, WGPUQueue queue, uint64_t regionSize);
+  ~UploadRing();
+
+  UploadRing(const UploadRing&) = delete;
+  UploadRing& operator=(const UploadRing&) = delete;
+
+  // moves to the next mapped region, grown to hold at least `bytes`
+  void BeginFrame(uint64_t bytes);
+
+  // copies `bytes` into the frame's region, 4 byte aligned. The slice is
+  // where they'll be in the vertex buffer after Flush().
+  Slice Write(const void* data, uint64_t bytes);
+
+  // submits the copy of the frame's writes, before the frame is submitted
+  void Flush();
+
+  uint64_t FrameBytes() const { return frameBytes; }
+  uint32_t CurrentRegion() const { return static_cast<uint32_t>(current); }
+  uint32_t RegionCount() const
+  {
+    return static_cast<uint32_t>(regions.size());
+  }
+
+private:
+  enum class RegionState
+  {
+    Mapped,  // free to write
+    Pending, // waiting on its map, the GPU may still copy out of it
+    Lost     // the map failed, the buffer is recreated
+  };
+
+  struct Region
+  {
+    UploadRing* ring;
+    WGPUBuffer buffer = nullptr;
+    uint64_t size = 0;
+    RegionState state = RegionState::Lost;
+  };
+
+  void CreateRegion(Region& region, uint64_t bytes);
+  void GrowTarget(uint64_t bytes);
+  static void OnMapped(WGPUBufferMapAsyncStatus status, void* userdata);
+
+  WGPUDevice device;
+  WGPUQueue queue;
+  uint64_t regionSize;
+
+  // regions are handed to OnMapped, they stay put when one is inserted
+  std::vector<std::unique_ptr<Region>> regions;
+  size_t current;
+  uint8_t* mapped = nullptr; // the frame's region while writing
+  uint64_t frameBytes = 0;
+  uint32_t pending = 0; // regions waiting on their map
+
+  WGPUBuffer target = nullptr; // what the draws read
+  uint64_t targetSize = 0;
+};
@@ -0,0 +1,62 @@
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const char* path)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+
+  // the mapping keeps the file open by itself
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    void* mapped =
+      mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED) {
+      data = static_cast<const uint8_t*>(mapped);
+      size = size_t(info.st_size);
+    }
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  Unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+  : data(other.data)
+  , size(other.size)
+{
+  other.data = nullptr;
+  other.size = 0;
+}
+
+MappedFile&
+MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this != &other) {
+    Unmap();
+    data = other.data;
+    size = other.size;
+    other.data = nullptr;
+    other.size = 0;
+  }
+  return *this;
+}
+
+void
+MappedFile::Unmap()
+{
+  if (data) {
+    munmap(const_cast<uint8_t*>(data), size);
+  }
+  data = nullptr;
+  size = 0;
+}
@@ -0,0 +1,34 @@
+/**
+ * $file backend/MappedFile.h
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A file mapped read only. Nothing is read up front, pages come in from the
+// page cache as they're touched. The mapping holds on to the file it was
+// made from, replacing or removing the path doesn't change what it reads.
+// Empty when the file can't be opened or mapped.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  explicit MappedFile(const char* path);
+  ~MappedFile();
+
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const uint8_t* Data() const { return data; }
+  size_t Size() const { return size; }
+  bool Empty() const { return size == 0; }
+
+private:
+  void Unmap();
+
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+};
@@ -0,0 +1,328 @@
+#include "RenderTarget.h"
+#include "common.h"
+
+#include <iostream>
+#include <string.h>
+
+RenderTarget::RenderTarget(WGPUDevice device,
+                           WGPUSurface surface,
+                           WGPUTextureFormat format,
+                           uint32_t width,
+                           uint32_t height)
+  : device(device)
+  , surface(surface)
+  , sampleCount(MSAA_NUMBER_OF_SAMPLE)
+{
+  config.nextInChain = nullptr;
+  config.format = format;
+  config.viewFormatCount = 0;
+  config.viewFormats = nullptr;
+  config.usage = WGPUTextureUsage_RenderAttachment;
+  config.device = device;
+  config.presentMode = WGPUPresentMode_Fifo;
+  config.alphaMode = WGPUCompositeAlphaMode_Opaque;
+  config.width = width;
+  config.height = height;
+  Configure();
+}
+
+RenderTarget::RenderTarget(WGPUDevice device,
+                           WGPUTextureFormat format,
+                           uint32_t width,
+                           uint32_t height)
+  : RenderTarget(device, nullptr, format, width, height)
+{
+}
+
+RenderTarget::~RenderTarget()
+{
+  ReleaseFrame();
+  ReleaseMultisampled();
+  if (offscreenTexture) {
+    wgpuTextureRelease(offscreenTexture);
+  }
+}
+
+void
+RenderTarget::Resize(uint32_t width, uint32_t height)
+{
+  if (width == config.width && height == config.height) {
+    return;
+  }
+  config.width = width;
+  config.height = height;
+  ReleaseMultisampled();
+  Configure();
+}
+
+void
+RenderTarget::SetFormat(WGPUTextureFormat format)
+{
+  if (format == config.format) {
+    return;
+  }
+  config.format = format;
+  ReleaseMultisampled();
+  Configure();
+}
+
+void
+RenderTarget::SetSampleCount(uint32_t samples)
+{
+  if (samples == 2) {
+    std::cerr << "MSAA sample count 2 isn't supported by WebGPU, using 4"
+              << std::endl;
+    samples = 4;
+  }
+  if (samples != 1 && samples != 4) {
+    std::cerr << "Unsupported MSAA sample count " << samples << ", using "
+              << MSAA_NUMBER_OF_SAMPLE << std::endl;
+    samples = MSAA_NUMBER_OF_SAMPLE;
+  }
+  if (samples != sampleCount) {
+    sampleCount = samples;
+    ReleaseMultisampled();
+  }
+}
+
+void
+RenderTarget::Configure()
+{
+  if (surface) {
+    wgpuSurfaceConfigure(surface, &config);
+    return;
+  }
+
+  if (offscreenTexture) {
+    wgpuTextureRelease(offscreenTexture);
+  }
+  WGPUTextureDescriptor desc = {};
+  desc.label = "Offscreen texture";
+  desc.size.width = config.width;
+  desc.size.height = config.height;
+  desc.size.depthOrArrayLayers = 1;
+  desc.mipLevelCount = 1;
+  desc.sampleCount = 1;
+  desc.dimension = WGPUTextureDimension_2D;
+  desc.format = config.format;
+  desc.usage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopySrc;
+  offscreenTexture = wgpuDeviceCreateTexture(device, &desc);
+}
+
+void
+RenderTarget::CreateMultisampled()
+{
+  WGPUTextureDescriptor desc = {};
+  desc.label = "Multi-sampled texture";
+  desc.size.width = config.width;
+  desc.size.height = config.height;
+  desc.size.depthOrArrayLayers = 1;
+  desc.mipLevelCount = 1;
+  desc.sampleCount = sampleCount;
+  desc.dimension = WGPUTextureDimension_2D;
+  desc.format = config.format;
+  desc.usage = WGPUTextureUsage_RenderAttachment;
+
+  multisampledTexture = wgpuDeviceCreateTexture(device, &desc);
+  multisampledView = wgpuTextureCreateView(multisampledTexture, nullptr);
+}
+
+void
+RenderTarget::ReleaseMultisampled()
+{
+  if (multisampledView) {
+    wgpuTextureViewRelease(multisampledView);
+    multisampledView = nullptr;
+  }
+  if (multisampledTexture) {
+    wgpuTextureRelease(multisampledTexture);
+    multisampledTexture = nullptr;
+  }
+}
+
+bool
+RenderTarget::Acquire()
+{
+  ReleaseFrame();
+
+  if (!surface) {
+    frameView = wgpuTextureCreateView(offscreenTexture, nullptr);
+    if (sampleCount > 1 && !multisampledView) {
+      CreateMultisampled();
+    }
+    return true;
+  }
+
+  WGPUSurfaceTexture surfaceTexture;
+  wgpuSurfaceGetCurrentTexture(surface, &surfaceTexture);
+  switch (surfaceTexture.status) {
+    case WGPUSurfaceGetCurrentTextureStatus_Success:
+      break;
+    case WGPUSurfaceGetCurrentTextureStatus_Outdated:
+    case WGPUSurfaceGetCurrentTextureStatus_Lost:
+      if (surfaceTexture.texture) {
+        wgpuTextureRelease(surfaceTexture.texture);
+      }
+      Configure();
+      return false;
+    default:
+      if (surfaceTexture.texture) {
+        wgpuTextureRelease(surfaceTexture.texture);
+      }
+      AcquireFailed();
+      return false;
+  }
+  if (!surfaceTexture.texture) {
+    AcquireFailed();
+    return false;
+  }
+
+  WGPUTextureViewDescriptor viewDescriptor = {};
+  viewDescriptor.nextInChain = nullptr;
+  viewDescriptor.label = "Surface texture view";
+  viewDescriptor.format = config.format;
+  viewDescriptor.dimension = WGPUTextureViewDimension_2D;
+  viewDescriptor.baseMipLevel = 0;
+  viewDescriptor.mipLevelCount = 1;
+  viewDescriptor.baseArrayLayer = 0;
+  viewDescriptor.arrayLayerCount = 1;
+  viewDescriptor.aspect = WGPUTextureAspect_All;
+
+  acquireFailing = false;
+  frameTexture = surfaceTexture.texture;
+  frameView = wgpuTextureCreateView(frameTexture, &viewDescriptor);
+
+  if (sampleCount > 1 && !multisampledView) {
+    CreateMultisampled();
+  }
+  return true;
+}
+
+void
+RenderTarget::AcquireFailed()
+{
+  // a minimized or occluded window times out on every try
+  if (!acquireFailing) {
+    std::cout << "Unable to get texture from surface.\n";
+  }
+  acquireFailing = true;
+}
+
+WGPURenderPassColorAttachment
+RenderTarget::ColorAttachment(WGPUColor clearColor) const
+{
+  WGPURenderPassColorAttachment colorAttachment = {};
+  if (sampleCount > 1) {
+    colorAttachment.view = multisampledView; // multi-sample render target
+    colorAttachment.resolveTarget = frameView;
+  } else {
+    colorAttachment.view = frameView;
+    colorAttachment.resolveTarget = nullptr;
+  }
+  colorAttachment.loadOp = WGPULoadOp_Clear;
+  colorAttachment.storeOp = WGPUStoreOp_Store;
+  colorAttachment.clearValue = clearColor;
+  return colorAttachment;
+}
+
+void
+RenderTarget::Present()
+{
+  if (surface) {
+    wgpuSurfacePresent(surface);
+  }
+  ReleaseFrame();
+}
+
+bool
+RenderTarget::ReadPixels(std::vector<uint8_t>& pixels)
+{
+  if (!offscreenTexture) {
+    return false;
+  }
+
+  // buffer rows are padded to the copy alignment, they're packed on the way
+  // out
+  uint32_t rowBytes = config.width * 4;
+  uint32_t paddedRowBytes = (rowBytes + 255) / 256 * 256;
+  uint64_t size = uint64_t(paddedRowBytes) * config.height;
+
+  WGPUBufferDescriptor bufferDesc = {};
+  bufferDesc.label = "Readback buffer";
+  bufferDesc.size = size;
+  bufferDesc.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+  WGPUBuffer buffer = wgpuDeviceCreateBuffer(device, &bufferDesc);
+
+  WGPUImageCopyTexture source = {
+    .texture = offscreenTexture,
+    .mipLevel = 0,
+    .origin = { 0, 0, 0 },
+    .aspect = WGPUTextureAspect_All,
+  };
+  WGPUImageCopyBuffer destination = {};
+  destination.buffer = buffer;
+  destination.layout.offset = 0;
+  destination.layout.bytesPerRow = paddedRowBytes;
+  destination.layout.rowsPerImage = config.height;
+  WGPUExtent3D extent = { config.width, config.height, 1 };
+
+  WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, nullptr);
+  wgpuCommandEncoderCopyTextureToBuffer(
+    encoder, &source, &destination, &extent);
+  WGPUCommandBuffer commands = wgpuCommandEncoderFinish(encoder, nullptr);
+  WGPUQueue queue = wgpuDeviceGetQueue(device);
+  wgpuQueueSubmit(queue, 1, &commands);
+  wgpuCommandBufferRelease(commands);
+  wgpuCommandEncoderRelease(encoder);
+
+  struct Mapping
+  {
+    bool done = false;
+    WGPUBufferMapAsyncStatus status = WGPUBufferMapAsyncStatus_Unknown;
+  } mapping;
+  wgpuBufferMapAsync(
+    buffer,
+    WGPUMapMode_Read,
+    0,
+    size,
+    [](WGPUBufferMapAsyncStatus status, void* userdata) {
+      Mapping* mapping = static_cast<Mapping*>(userdata);
+      mapping->status = status;
+      mapping->done = true;
+    },
+    &mapping);
+  while (!mapping.done) {
+    wgpuDevicePoll(device, true, nullptr);
+  }
+
+  bool read = mapping.status == WGPUBufferMapAsyncStatus_Success;
+  if (read) {
+    const uint8_t* data = static_cast<const uint8_t*>(
+      wgpuBufferGetConstMappedRange(buffer, 0, size));
+    pixels.resize(size_t(rowBytes) * config.height);
+    for (uint32_t row = 0; row < config.height; ++row) {
+      memcpy(&pixels[size_t(row) * rowBytes],
+             data + size_t(row) * paddedRowBytes,
+             rowBytes);
+    }
+    wgpuBufferUnmap(buffer);
+  } else {
+    std::cerr << "Unable to read back the frame.\n";
+  }
+  wgpuBufferRelease(buffer);
+  wgpuQueueRelease(queue);
+  return read;
+}
+
+void
+RenderTarget::ReleaseFrame()
+{
+  if (frameView) {
+    wgpuTextureViewRelease(frameView);
+    frameView = nullptr;
+  }
+  if (frameTexture) {
+    wgpuTextureRelease(frameTexture);
+    frameTexture = nullptr;
+  }
+}
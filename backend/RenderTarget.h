@@ -0,0 +1,88 @@
+/**
+ * $file backend/RenderTarget.h
+ */
+#pragma once
+
+#include "webgpu/webgpu.h"
+#include "wgpu/wgpu.h"
+#include <stdint.h>
+#include <vector>
+
+// Owns the surface configuration and the multisampled colour target the
+// frame is drawn into before it's resolved onto the surface texture. The
+// target lives across frames and is only recreated when the size, format or
+// sample count changes. With a single sample the pass draws straight into
+// the surface texture.
+//
+// Without a surface (headless runs) frames go into a texture of the target's
+// own that stays around after Present() and can be read back.
+class RenderTarget
+{
+public:
+  RenderTarget(WGPUDevice device,
+               WGPUSurface surface,
+               WGPUTextureFormat format,
+               uint32_t width,
+               uint32_t height);
+
+  // offscreen
+  RenderTarget(WGPUDevice device,
+               WGPUTextureFormat format,
+               uint32_t width,
+               uint32_t height);
+  ~RenderTarget();
+
+  RenderTarget(const RenderTarget&) = delete;
+  RenderTarget& operator=(const RenderTarget&) = delete;
+
+  // reconfigures the surface, the multisampled target follows on the next
+  // Acquire()
+  void Resize(uint32_t width, uint32_t height);
+  void SetFormat(WGPUTextureFormat format);
+
+  // 1 or 4, the only counts WebGPU guarantees. 2 needs adapter specific
+  // format features and is taken as 4, anything else falls back to
+  // MSAA_NUMBER_OF_SAMPLE.
+  void SetSampleCount(uint32_t samples);
+
+  // gets the surface texture for this frame, false when there's none to
+  // draw into (the surface is reconfigured if it went out of date). A
+  // failure is logged once until a texture is acquired again.
+  bool Acquire();
+
+  // only between Acquire() and Present()
+  WGPURenderPassColorAttachment ColorAttachment(WGPUColor clearColor) const;
+
+  // presents and lets go of the frame's surface texture
+  void Present();
+
+  // the last frame drawn offscreen as rows of Width() pixels in Format(),
+  // waits for the GPU. False when the target has a surface.
+  bool ReadPixels(std::vector<uint8_t>& pixels);
+
+  WGPUTextureFormat Format() const { return config.format; }
+  uint32_t SampleCount() const { return sampleCount; }
+  uint32_t Width() const { return config.width; }
+  uint32_t Height() const { return config.height; }
+
+private:
+  void Configure();
+  void CreateMultisampled();
+  void ReleaseMultisampled();
+  void ReleaseFrame();
+  void AcquireFailed();
+
+  WGPUDevice device;
+  WGPUSurface surface;
+  WGPUSurfaceConfiguration config = {};
+  uint32_t sampleCount;
+  bool acquireFailing = false;
+
+  WGPUTexture multisampledTexture = nullptr;
+  WGPUTextureView multisampledView = nullptr;
+
+  WGPUTexture frameTexture = nullptr;
+  WGPUTextureView frameView = nullptr;
+
+  WGPUTexture offscreenTexture = nullptr; // without a surface
+};
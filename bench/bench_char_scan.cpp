@@ -0,0 +1,210 @@
+/**
+ * $file bench/bench_char_scan.cpp
+ *
+ * Character run scanning, per byte vs the vector blocks the build targets
+ * (SSE2 or NEON), on their own and inside the tokenizer on a 1 MB C
+ * file, where tokenizeLine() runs on TokenScan. Both tokenizer paths must
+ * produce the same tokens.
+ */
+#include "../CharScan.h"
+#include "../Tokenizer.h"
+
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <string>
+
+static const int PASSES = 20;
+
+static std::string
+makeSource(size_t size)
+{
+  static const char* chunk =
+    "#include <stdio.h>\n"
+    "#define SQUARE(x) \\\n"
+    "  ((x) * (x))\n"
+    "\n"
+    "/* running totals,\n"
+    "   one per bucket */\n"
+    "static unsigned long accumulated_bucket_totals[64];\n"
+    "\n"
+    "int\n"
+    "accumulate_named_counter(const char* counter_name, int count)\n"
+    "{\n"
+    "  // skip empty input, there is nothing to add up\n"
+    "  if (count <= 0 || !counter_name) {\n"
+    "    return -1;\n"
+    "  }\n"
+    "  for (int index = 0; index < count; ++index) {\n"
+    "    accumulated_bucket_totals[index & 63] += SQUARE(index) * 3.25;\n"
+    "  }\n"
+    "  printf(\"accumulated %s over %d buckets\\n\", counter_name, count);\n"
+    "  return (int)accumulated_bucket_totals[0];\n"
+    "}\n\n";
+  std::string text;
+  while (text.size() < size) {
+    text += chunk;
+  }
+  return text;
+}
+
+// identifiers of 4 to 40 characters between short runs of whitespace
+static std::string
+makeIdentifiers(size_t size)
+{
+  std::mt19937 rng(42);
+  std::string text;
+  while (text.size() < size) {
+    size_t length = 4 + rng() % 37;
+    for (size_t i = 0; i < length; ++i) {
+      text.push_back("abcdefghijklmnopqrstuvwxyzABCXYZ_0123456789"[rng() % 43]);
+    }
+    text.append(1 + rng() % 4, " \t"[rng() % 2]);
+  }
+  return text;
+}
+
+template<typename Fn>
+static double
+measureMs(Fn&& fn)
+{
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template<typename Scan>
+static size_t
+scanIdentifiers(const std::string& text)
+{
+  size_t words = 0;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    pos += Scan::identifierRun(text.data() + pos, text.size() - pos);
+    pos += Scan::spaceRun(text.data() + pos, text.size() - pos);
+    words++;
+  }
+  return words;
+}
+
+template<typename Scan>
+static size_t
+scanQuotes(const std::string& text)
+{
+  size_t quotes = 0;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    pos += Scan::findEither(text.data() + pos, text.size() - pos, '"', '\\');
+    pos++;
+    quotes++;
+  }
+  return quotes;
+}
+
+template<typename Lex>
+static size_t
+lexFile(const std::string& source, TokenList& tokens, Lex lex)
+{
+  LexState state = LexState::Normal;
+  size_t count = 0;
+  size_t start = 0;
+  while (start < source.size()) {
+    size_t end = source.find('\n', start);
+    end = end == std::string::npos ? source.size() : end + 1;
+    tokens.clear();
+    state = lex(source, start, end, state, tokens);
+    count += tokens.size();
+    start = end;
+  }
+  return count;
+}
+
+static bool
+sameTokens(const std::string& source)
+{
+  TokenList scalar;
+  TokenList vector;
+  LexState scalarState = LexState::Normal;
+  LexState vectorState = LexState::Normal;
+  size_t start = 0;
+  while (start < source.size()) {
+    size_t end = source.find('\n', start);
+    end = end == std::string::npos ? source.size() : end + 1;
+    scalar.clear();
+    vector.clear();
+    scalarState =
+      tokenizeLineScalar(source, start, end, scalarState, scalar);
+    vectorState = tokenizeLine(source, start, end, vectorState, vector);
+    if (scalarState != vectorState || scalar.size() != vector.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < scalar.size(); ++i) {
+      SyntaxToken a = scalar[i];
+      SyntaxToken b = vector[i];
+      if (a.type != b.type || a.startPos != b.startPos ||
+          a.length != b.length) {
+        return false;
+      }
+    }
+    start = end;
+  }
+  return true;
+}
+
+template<typename Fn>
+static void
+report(const char* name, size_t bytes, Fn&& fn)
+{
+  size_t sink = fn(); // warm up
+  double ms = measureMs([&] {
+    for (int i = 0; i < PASSES; ++i) {
+      sink += fn();
+    }
+  });
+  printf("%-26s %9.1f MB/s %12zu\n",
+         name,
+         bytes * PASSES / (1024.0 * 1024.0) / (ms / 1000.0),
+         sink / (PASSES + 1));
+}
+
+int
+main()
+{
+  const std::string source = makeSource(1024 * 1024);
+  const std::string identifiers = makeIdentifiers(1024 * 1024);
+  const std::string quoted(1024 * 1024, 'x');
+
+  printf("vector path: %s, keyword hash (%u, %u) over %zu slots\n",
+         VectorScan::NAME,
+         keywordHash.first,
+         keywordHash.last,
+         KeywordHash::TABLE_SIZE);
+  if (!sameTokens(source)) {
+    printf("scalar and vector tokens differ\n");
+    return 1;
+  }
+
+  printf("%-26s %14s %12s\n", "", "throughput", "result");
+  report("identifiers scalar", identifiers.size(), [&] {
+    return scanIdentifiers<ScalarScan>(identifiers);
+  });
+  report("identifiers vector", identifiers.size(), [&] {
+    return scanIdentifiers<VectorScan>(identifiers);
+  });
+  report("string body scalar", quoted.size(), [&] {
+    return scanQuotes<ScalarScan>(quoted);
+  });
+  report("string body vector", quoted.size(), [&] {
+    return scanQuotes<VectorScan>(quoted);
+  });
+
+  TokenList tokens;
+  report("tokenizeLine scalar", source.size(), [&] {
+    return lexFile(source, tokens, tokenizeLineScalar);
+  });
+  report("tokenizeLine", source.size(), [&] {
+    return lexFile(source, tokens, tokenizeLine);
+  });
+  return 0;
+}
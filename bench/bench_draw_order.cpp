@@ -0,0 +1,136 @@
+/**
+ * $file bench/bench_draw_order.cpp
+ *
+ * Ordering a frame's quads by draw order: std::stable_sort over Quad objects
+ * that own their vertices and indices, as the renderer did at first,
+ * std::stable_sort over the 8 byte QuadKeys, and the counting sort
+ * SortQuadKeys() uses for the few layers the editor draws on. The layers are
+ * mixed the way a busy editor frame mixes them, mostly text with
+ * backgrounds, UI and the hover popup in between.
+ *
+ *   bench_draw_order [rounds]
+ */
+#include "../backend/2d/QuadBatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+struct Quad
+{
+  std::vector<Vertex> vertices;
+  std::vector<uint16_t> indices;
+  int32_t drawOrder;
+};
+
+// LAYER_BACKGROUND..LAYER_TEXT and LAYER_UI + 1, + 2
+static int32_t
+randomLayer(std::mt19937& rng)
+{
+  uint32_t roll = rng() % 100;
+  if (roll < 80) {
+    return 3;
+  }
+  if (roll < 92) {
+    return 0;
+  }
+  if (roll < 97) {
+    return 2;
+  }
+  return roll < 99 ? 1 : 4 + rng() % 2;
+}
+
+template<typename Fn>
+static double
+measureMs(Fn&& fn)
+{
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static bool
+sameOrder(const std::vector<QuadKey>& a, const std::vector<QuadKey>& b)
+{
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i].drawOrder != b[i].drawOrder || a[i].item != b[i].item) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int
+main(int argc, char* argv[])
+{
+  int rounds = argc > 1 ? atoi(argv[1]) : 20;
+
+  printf("%-8s %16s %16s %16s\n",
+         "quads",
+         "Quad stable_sort",
+         "key stable_sort",
+         "counting sort");
+
+  for (size_t count : { 10000, 50000, 200000 }) {
+    std::mt19937 rng(42);
+    std::vector<QuadKey> keys(count);
+    std::vector<Quad> quads(count);
+    for (size_t i = 0; i < count; ++i) {
+      int32_t layer = randomLayer(rng);
+      keys[i] = { layer, static_cast<uint32_t>(i) };
+      quads[i].drawOrder = layer;
+      quads[i].vertices.resize(4);
+      quads[i].indices = { 0, 1, 2, 0, 2, 3 };
+    }
+
+    auto byOrder = [](const QuadKey& a, const QuadKey& b) {
+      return a.drawOrder < b.drawOrder;
+    };
+
+    // the copies back to the submitted order are timed in every column
+    std::vector<Quad> sortedQuads;
+    double quadMs = measureMs([&] {
+      for (int round = 0; round < rounds; ++round) {
+        sortedQuads = quads;
+        std::stable_sort(
+          sortedQuads.begin(),
+          sortedQuads.end(),
+          [](const Quad& a, const Quad& b) {
+            return a.drawOrder < b.drawOrder;
+          });
+      }
+    });
+
+    std::vector<QuadKey> stable;
+    double stableMs = measureMs([&] {
+      for (int round = 0; round < rounds; ++round) {
+        stable = keys;
+        std::stable_sort(stable.begin(), stable.end(), byOrder);
+      }
+    });
+
+    std::vector<QuadKey> counted;
+    std::vector<QuadKey> scratch;
+    double countingMs = measureMs([&] {
+      for (int round = 0; round < rounds; ++round) {
+        counted = keys;
+        SortQuadKeys(counted.data(), counted.size(), scratch);
+      }
+    });
+
+    if (!sameOrder(stable, counted)) {
+      printf("counting sort order differs from std::stable_sort\n");
+      return 1;
+    }
+    printf("%-8zu %13.3f ms %13.3f ms %13.3f ms\n",
+           count,
+           quadMs / rounds,
+           stableMs / rounds,
+           countingMs / rounds);
+  }
+  return 0;
+}
@@ -0,0 +1,107 @@
+/**
+ * $file bench/bench_piece_table.cpp
+ *
+ * Random single-keystroke edits on a 50 MB buffer, std::string vs PieceTable.
+ */
+#include "../PieceTable.h"
+
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+struct Edit
+{
+  bool insert;
+  size_t position;
+  size_t count;
+};
+
+static std::string
+makeBuffer(size_t size)
+{
+  static const char* line =
+    "static inline int32_t value = compute(a, b); // x\n";
+  std::string text;
+  text.reserve(size);
+  while (text.size() < size) {
+    text += line;
+  }
+  text.resize(size);
+  return text;
+}
+
+template<typename Fn>
+static double
+measureMs(Fn&& fn)
+{
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int
+main(int argc, char* argv[])
+{
+  const size_t bufferSize = 50 * 1024 * 1024;
+  const size_t editCount = argc > 1 ? (size_t)atol(argv[1]) : 2000;
+
+  std::string source = makeBuffer(bufferSize);
+
+  std::mt19937_64 rng(1234);
+  std::vector<Edit> edits;
+  size_t length = source.size();
+  for (size_t i = 0; i < editCount; ++i) {
+    Edit edit;
+    edit.insert = (rng() % 3) != 0;
+    edit.position = rng() % length;
+    edit.count = 1 + rng() % 4;
+    if (!edit.insert) {
+      edit.count = std::min(edit.count, length - edit.position);
+      length -= edit.count;
+    } else {
+      length += edit.count;
+    }
+    edits.push_back(edit);
+  }
+
+  const char* typed = "abcd";
+
+  std::string flat = source;
+  double flatMs = measureMs([&] {
+    for (const Edit& edit : edits) {
+      if (edit.insert) {
+        flat.insert(edit.position, typed, edit.count);
+      } else {
+        flat.erase(edit.position, edit.count);
+      }
+    }
+  });
+
+  PieceTable table(source);
+  double tableMs = measureMs([&] {
+    for (const Edit& edit : edits) {
+      if (edit.insert) {
+        table.insert(edit.position, typed, edit.count);
+      } else {
+        table.erase(edit.position, edit.count);
+      }
+    }
+  });
+
+  bool same = table.length() == flat.length() && table.substr(0) == flat;
+
+  printf("buffer: %zu MB, edits: %zu\n", bufferSize >> 20, editCount);
+  printf("std::string : %10.2f ms total, %8.3f us/edit\n",
+         flatMs,
+         flatMs * 1000.0 / editCount);
+  printf("PieceTable  : %10.2f ms total, %8.3f us/edit (%zu pieces)\n",
+         tableMs,
+         tableMs * 1000.0 / editCount,
+         table.pieceCount());
+  printf("contents match: %s\n", same ? "yes" : "NO");
+
+  return same ? 0 : 1;
+}
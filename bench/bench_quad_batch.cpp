@@ -0,0 +1,214 @@
+/**
+ * $file bench/bench_quad_batch.cpp
+ *
+ * Submitting 100k glyph quads in a frame and getting them into upload order:
+ * a Quad with its own vertex and index vectors per glyph, stable sorted and
+ * flattened as the renderer did before, vs the flat QuadBatch arena with 4
+ * vertices per glyph and with one instance per glyph. Upload sizes are per
+ * frame, the legacy path also uploaded the indices.
+ *
+ *   bench_quad_batch [frames]
+ */
+#include "../backend/2d/QuadBatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static const size_t GLYPHS = 100000;
+
+// what the renderer did before
+struct Quad
+{
+  std::vector<Vertex> vertices;
+  std::vector<uint16_t> indices;
+  int32_t drawOrder;
+};
+
+struct LegacyBatch
+{
+  std::vector<Quad> quads;
+  std::vector<Vertex> vertices;
+  std::vector<uint16_t> indices;
+
+  void add(const Vertex (&glyph)[4], int32_t drawOrder)
+  {
+    Quad quad;
+    quad.drawOrder = drawOrder;
+    quad.vertices = { glyph[0], glyph[1], glyph[2], glyph[3] };
+    quad.indices = { 0, 1, 2, 0, 2, 3 };
+    quads.push_back(quad);
+  }
+
+  const Vertex* flatten()
+  {
+    std::stable_sort(
+      quads.begin(), quads.end(), [](const Quad& a, const Quad& b) {
+        return a.drawOrder < b.drawOrder;
+      });
+    vertices.clear();
+    indices.clear();
+    size_t numQuads = 0;
+    for (const auto& quad : quads) {
+      uint16_t baseIndex = static_cast<uint16_t>(numQuads * 4);
+      for (auto index : quad.indices) {
+        indices.push_back(baseIndex + index);
+      }
+      vertices.insert(
+        vertices.end(), quad.vertices.begin(), quad.vertices.end());
+      numQuads++;
+    }
+    quads.clear();
+    return vertices.data();
+  }
+};
+
+static void
+glyphVertices(size_t i, Vertex* out)
+{
+  float x = static_cast<float>(i % 120) * 11.0f;
+  float y = static_cast<float>(i / 120 % 60) * 23.0f;
+  Vector4 color = { 1.0f, 1.0f, 1.0f, 1.0f };
+  Vector2 center = { x + 5.5f, y + 11.5f };
+  out[0] = { { -5.5f, 11.5f }, color, { 0.0f, 1.0f }, 0.0f, 2u, center, 0.0f };
+  out[1] = { { 5.5f, 11.5f }, color, { 1.0f, 1.0f }, 0.0f, 2u, center, 0.0f };
+  out[2] = { { 5.5f, -11.5f }, color, { 1.0f, 0.0f }, 0.0f, 2u, center, 0.0f };
+  out[3] = { { -5.5f, -11.5f }, color, { 0.0f, 0.0f }, 0.0f, 2u, center, 0.0f };
+}
+
+static void
+glyphInstance(size_t i, QuadInstance* out)
+{
+  float x = static_cast<float>(i % 120) * 11.0f;
+  float y = static_cast<float>(i / 120 % 60) * 23.0f;
+  out->translation = { x + 5.5f, y + 11.5f };
+  out->rect = { -5.5f, -11.5f, 5.5f, 11.5f };
+  out->uv[0] = 0;
+  out->uv[1] = 0;
+  out->uv[2] = 0xffff;
+  out->uv[3] = 0xffff;
+  out->color = QuadBatch::PackColor({ 1.0f, 1.0f, 1.0f, 1.0f });
+  out->rotation = 0.0f;
+  out->texIndex = 2u;
+}
+
+// text on layer 3 with a background quad (selection, underline) on layer 0
+// every 64 glyphs when `interleaved`
+static int32_t
+drawOrderOf(size_t i, bool interleaved)
+{
+  return interleaved && i % 64 == 0 ? 0 : 3;
+}
+
+template<typename Fn>
+static double
+measureMs(Fn&& fn)
+{
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static float
+checksum(const Vertex* vertices)
+{
+  float sum = 0.0f;
+  for (size_t i = 0; i < GLYPHS; i += 997) {
+    sum += vertices[i * 4].translation.x + vertices[i * 4 + 3].translation.y;
+  }
+  return sum;
+}
+
+static float
+checksum(const QuadInstance* instances)
+{
+  float sum = 0.0f;
+  for (size_t i = 0; i < GLYPHS; i += 997) {
+    sum += instances[i].translation.x + instances[i].translation.y;
+  }
+  return sum;
+}
+
+static double
+megabytes(size_t bytes)
+{
+  return bytes / (1024.0 * 1024.0);
+}
+
+int
+main(int argc, char* argv[])
+{
+  int frames = argc > 1 ? atoi(argv[1]) : 30;
+
+  std::vector<uint16_t> indices =
+    QuadBatch::QuadIndices(QuadBatch::QUADS_PER_INDEXED_DRAW);
+  printf("%zu glyph quads per frame, %d frames, %zu indices built once\n",
+         GLYPHS,
+         frames,
+         indices.size());
+  printf("upload per frame: legacy %.1f MB, vertices %.1f MB, "
+         "instances %.1f MB\n\n",
+         megabytes(GLYPHS * (4 * sizeof(Vertex) + 6 * sizeof(uint16_t))),
+         megabytes(GLYPHS * 4 * sizeof(Vertex)),
+         megabytes(GLYPHS * sizeof(QuadInstance)));
+  printf("%-14s %12s %12s %12s\n",
+         "ms/frame",
+         "legacy",
+         "vertices",
+         "instances");
+
+  for (bool interleaved : { false, true }) {
+    LegacyBatch legacy;
+    QuadBatch arena(16384, GLYPHS); // grows in the first frame
+    float legacySum = 0.0f;
+    float vertexSum = 0.0f;
+    float instanceSum = 0.0f;
+
+    double legacyMs = measureMs([&] {
+      for (int frame = 0; frame < frames; ++frame) {
+        for (size_t i = 0; i < GLYPHS; ++i) {
+          Vertex glyph[4];
+          glyphVertices(i, glyph);
+          legacy.add(glyph, drawOrderOf(i, interleaved));
+        }
+        legacySum += checksum(legacy.flatten());
+      }
+    });
+
+    double vertexMs = measureMs([&] {
+      for (int frame = 0; frame < frames; ++frame) {
+        for (size_t i = 0; i < GLYPHS; ++i) {
+          glyphVertices(i, arena.PushVertices(drawOrderOf(i, interleaved)));
+        }
+        arena.Sort();
+        vertexSum += checksum(arena.Vertices());
+        arena.Clear();
+      }
+    });
+
+    double instanceMs = measureMs([&] {
+      for (int frame = 0; frame < frames; ++frame) {
+        for (size_t i = 0; i < GLYPHS; ++i) {
+          glyphInstance(i, arena.PushInstance(drawOrderOf(i, interleaved)));
+        }
+        arena.Sort();
+        instanceSum += checksum(arena.Instances());
+        arena.Clear();
+      }
+    });
+
+    if (legacySum != vertexSum || legacySum != instanceSum) {
+      printf("legacy and arena quads differ\n");
+      return 1;
+    }
+    printf("%-14s %12.2f %12.2f %12.2f\n",
+           interleaved ? "interleaved" : "in order",
+           legacyMs / frames,
+           vertexMs / frames,
+           instanceMs / frames);
+  }
+  return 0;
+}
@@ -0,0 +1,151 @@
+/**
+ * $file bench/bench_tokenizer.cpp
+ *
+ * Tokenizer throughput and heap allocations on a 1 MB C file. Every operator
+ * new is counted, a pass that reuses its token storage must not allocate.
+ */
+#include "../LineIndex.h"
+#include "../PieceTable.h"
+#include "../SyntaxCache.h"
+#include "../Tokenizer.h"
+
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+static size_t allocations = 0;
+
+void*
+operator new(size_t size)
+{
+  allocations++;
+  if (void* p = malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void
+operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+static std::string
+makeSource(size_t size)
+{
+  static const char* chunk =
+    "#include <stdio.h>\n"
+    "#define SQUARE(x) \\\n"
+    "  ((x) * (x))\n"
+    "\n"
+    "/* running totals,\n"
+    "   one per bucket */\n"
+    "static unsigned long totals[64];\n"
+    "\n"
+    "int\n"
+    "accumulate(const char* name, int count, double scale)\n"
+    "{\n"
+    "  // skip empty input\n"
+    "  if (count <= 0 || !name) {\n"
+    "    return -1;\n"
+    "  }\n"
+    "  for (int i = 0; i < count; ++i) {\n"
+    "    totals[i & 63] += SQUARE(i) * 3.25 + 'a';\n"
+    "  }\n"
+    "  printf(\"%s: %d\\n\", name, count);\n"
+    "  return (int)(scale * totals[0]);\n"
+    "}\n\n";
+  std::string text;
+  while (text.size() < size) {
+    text += chunk;
+  }
+  return text;
+}
+
+template<typename Fn>
+static double
+measureMs(Fn&& fn)
+{
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void
+report(const char* name, double ms, size_t bytes, size_t tokens, size_t allocs)
+{
+  printf("%-28s %8.2f MB/s %9zu tokens %7zu allocs %10.6f allocs/token\n",
+         name,
+         bytes / (1024.0 * 1024.0) / (ms / 1000.0),
+         tokens,
+         allocs,
+         tokens ? (double)allocs / tokens : 0.0);
+}
+
+int
+main()
+{
+  const std::string source = makeSource(1024 * 1024);
+  size_t tokenCount = 0;
+
+  // one growing token list for the whole file
+  size_t before = allocations;
+  double ms = measureMs([&] { tokenCount = tokenize(source).size(); });
+  report("tokenize (fresh list)", ms, source.size(), tokenCount,
+         allocations - before);
+
+  // line by line into a warmed up list, as the editor does per line
+  TokenList tokens;
+  auto lexLines = [&] {
+    LexState state = LexState::Normal;
+    size_t start = 0;
+    tokenCount = 0;
+    while (start < source.size()) {
+      size_t end = source.find('\n', start);
+      end = end == std::string::npos ? source.size() : end + 1;
+      tokens.clear();
+      state = tokenizeLine(source, start, end, state, tokens);
+      tokenCount += tokens.size();
+      start = end;
+    }
+  };
+  lexLines();
+  before = allocations;
+  ms = measureMs(lexLines);
+  report("tokenizeLine (reused list)", ms, source.size(), tokenCount,
+         allocations - before);
+
+  // the editor cache on the piece table, the second rebuild reuses every
+  // line's storage
+  PieceTable text;
+  text.assign(source);
+  LineIndex lines;
+  lines.build(text);
+  SyntaxCache cache(text, lines);
+
+  before = allocations;
+  ms = measureMs([&] { cache.rebuild(); });
+  size_t cachedTokens = 0;
+  for (size_t line = 0; line < lines.lineCount(); ++line) {
+    cachedTokens += cache.lineTokens(line).size();
+  }
+  report("SyntaxCache::rebuild (cold)", ms, source.size(), cachedTokens,
+         allocations - before);
+
+  before = allocations;
+  ms = measureMs([&] { cache.rebuild(); });
+  report("SyntaxCache::rebuild (warm)", ms, source.size(), cachedTokens,
+         allocations - before);
+
+  return 0;
+}
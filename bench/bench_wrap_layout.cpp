@@ -0,0 +1,162 @@
+/**
+ * $file bench/bench_wrap_layout.cpp
+ *
+ * Per-frame soft wrap cost at growing file sizes: re-wrapping the whole
+ * document every frame vs the cached WrapLayout, which only wraps the line
+ * that was typed into and the rows on screen.
+ *
+ *   bench_wrap_layout [frames] [proportional]
+ */
+#include "../GlyphMetrics.h"
+#include "../LineIndex.h"
+#include "../PieceTable.h"
+#include "../WrapLayout.h"
+
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+static const float ADVANCE = 11.0f;
+static const float WRAP_WIDTH = 900.0f;
+static const size_t VISIBLE_ROWS = 60;
+
+static std::string
+makeBuffer(size_t lineCount)
+{
+  std::mt19937 rng(42);
+  std::string text;
+  for (size_t i = 0; i < lineCount; ++i) {
+    // mostly short lines with an occasional one long enough to wrap
+    size_t length = rng() % 8 == 0 ? 80 + rng() % 200 : rng() % 60;
+    for (size_t j = 0; j < length; ++j) {
+      text.push_back("abcdefgh (){};=+ "[rng() % 17]);
+    }
+    text.push_back('\n');
+  }
+  return text;
+}
+
+template<typename Fn>
+static double
+measureUs(Fn&& fn)
+{
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+// what the editor did before, once per frame
+struct WrappedRow
+{
+  std::string text;
+  size_t startPos;
+};
+
+static size_t
+wrapEverything(const PieceTable& text, const float* advances)
+{
+  std::vector<WrappedRow> rows;
+  rows.reserve(2048);
+  auto it = text.begin();
+  const auto end = text.end();
+  while (it != end) {
+    WrappedRow row;
+    row.startPos = it.position();
+    float width = 0.0f;
+    while (it != end && *it != '\n') {
+      float w = advances[(unsigned char)*it];
+      if (width + w > WRAP_WIDTH && !row.text.empty()) {
+        break;
+      }
+      width += w;
+      row.text.push_back(*it);
+      ++it;
+    }
+    rows.emplace_back(std::move(row));
+    if (it != end && *it == '\n') {
+      ++it;
+    }
+  }
+  return rows.size();
+}
+
+int
+main(int argc, char* argv[])
+{
+  const size_t frames = argc > 1 ? (size_t)atol(argv[1]) : 2000;
+
+  GlyphMetrics glyphs;
+  for (float& advance : glyphs.advances) {
+    advance = ADVANCE;
+  }
+  // a proportional table takes the per-character paths
+  if (argc > 2) {
+    glyphs.advances[(unsigned char)' '] = ADVANCE / 2;
+  }
+  glyphs.DetectMonospace();
+
+  printf("%10s %10s %16s %16s\n", "lines", "rows", "full us/frame",
+         "cached us/frame");
+
+  for (size_t lineCount : { 10000, 100000, 1000000 }) {
+    PieceTable text;
+    text.assign(makeBuffer(lineCount));
+    LineIndex lines;
+    lines.build(text);
+    WrapLayout layout(text, lines);
+    layout.setMetrics(glyphs, WRAP_WIDTH);
+    while (!layout.settle(1 << 20)) {
+    }
+
+    // the old path is too slow to run every frame on big files, a few
+    // frames are enough for an average
+    size_t fullFrames = 5;
+    size_t sink = 0;
+    double fullUs = measureUs([&] {
+      for (size_t i = 0; i < fullFrames; ++i) {
+        sink += wrapEverything(text, glyphs.advances);
+      }
+    });
+
+    std::mt19937_64 rng(7);
+    size_t cursor = text.length() / 2;
+    double cachedUs = measureUs([&] {
+      for (size_t frame = 0; frame < frames; ++frame) {
+        // one keystroke, mirrored the way SimpleTextEditor::applyEdit does
+        const char c = "abc }\n"[rng() % 6];
+        lines.insert(cursor, &c, 1);
+        text.insert(cursor, &c, 1);
+        size_t last = lines.lineAt(cursor + 1);
+        for (size_t line = lines.lineAt(cursor); line <= last; ++line) {
+          layout.layoutLine(line);
+        }
+        cursor++;
+
+        // cursor placement and the rows on screen
+        size_t cursorRow = layout.rowAt(cursor);
+        WrapLayout::Row row = layout.row(cursorRow);
+        float x = layout.width(row.start, cursor);
+
+        size_t firstRow = cursorRow > 30 ? cursorRow - 30 : 0;
+        for (size_t i = firstRow; i < firstRow + VISIBLE_ROWS; ++i) {
+          WrapLayout::Row visible = layout.row(i);
+          x += layout.width(visible.start, visible.end);
+        }
+        sink += (size_t)x;
+      }
+    });
+
+    printf("%10zu %10zu %16.1f %16.2f\n",
+           lineCount,
+           layout.rowCount(),
+           fullUs / fullFrames,
+           cachedUs / frames);
+    if (sink == 0) {
+      printf("\n");
+    }
+  }
+  return 0;
+}
@@ -7,12 +7,15 @@
 
 #include "Math.h"
 #include "backend/2d/Renderer.h"
+#include "backend/RenderTarget.h"
 #include "backend/common.h"
 
 #include "CommandPallete.h"
 #include "Editor.h"
+#include "Headless.h"
 #include "Imui.h"
 #include "Platform.h"
+#include "Profiler.h"
 
 #define WINDOW_WIDTH 1080
 #define WINDOW_HEIGHT 720
@@ -21,20 +24,56 @@
 int
 main(int32_t argc, char* argv[])
 {
-  SDL_Window* window = SDL_CreateWindow(
-    EDITOR_NAME, WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_RESIZABLE);
+  // startup is traced up to the first presented frame
+  Uint64 startTime = SDL_GetPerformanceCounter();
+  auto msSinceStart = [startTime](Uint64 time) {
+    return (double)(time - startTime) * 1000.0 / SDL_GetPerformanceFrequency();
+  };
 
-  if (!window) {
-    std::cout << "Window Creation Failed\n";
-    return -1;
+  // [--headless WxH [--script FILE] [--golden FILE] [--report FILE]] [FILE]
+  HeadlessOptions headless;
+  bool isHeadless = false;
+  const char* filename = nullptr;
+  for (int32_t i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--headless" && hasValue) {
+      if (!ParseHeadlessSize(argv[++i], headless)) {
+        std::cout << "Expected --headless WxH\n";
+        return 1;
+      }
+      isHeadless = true;
+    } else if (arg == "--script" && hasValue) {
+      headless.script = argv[++i];
+    } else if (arg == "--golden" && hasValue) {
+      headless.golden = argv[++i];
+    } else if (arg == "--report" && hasValue) {
+      headless.report = argv[++i];
+    } else {
+      filename = argv[i];
+    }
   }
 
-  SDL_SetWindowBordered(window, SDL_FALSE);
+  SDL_Window* window = nullptr;
+  if (isHeadless) {
+    // the editor's worker wakes the loop through the event queue
+    SDL_Init(SDL_INIT_EVENTS);
+  } else {
+    window = SDL_CreateWindow(
+      EDITOR_NAME, WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_RESIZABLE);
+
+    if (!window) {
+      std::cout << "Window Creation Failed\n";
+      return -1;
+    }
+
+    SDL_SetWindowBordered(window, SDL_FALSE);
 
-  SDL_Surface* icon = SDL_LoadBMP("./res/icon.bmp");
-  if (icon != NULL) {
-    SDL_SetWindowIcon(window, icon);
-    SDL_DestroySurface(icon);
+    SDL_Surface* icon = SDL_LoadBMP("./res/icon.bmp");
+    if (icon != NULL) {
+      SDL_SetWindowIcon(window, icon);
+      SDL_DestroySurface(icon);
+    }
   }
 
   WGPUInstanceDescriptor instanceDescriptor = {};
@@ -45,9 +84,13 @@ main(int32_t argc, char* argv[])
     return 1;
   }
 
-  WGPUSurface surface = SDL_GetWGPUSurface(instance, window);
+  // headless runs take a software adapter when there is one, so frames look
+  // the same on any machine
+  WGPUSurface surface =
+    window ? SDL_GetWGPUSurface(instance, window) : nullptr;
   WGPURequestAdapterOptions adapterOptions = {};
   adapterOptions.compatibleSurface = surface;
+  adapterOptions.forceFallbackAdapter = isHeadless;
 
   WGPUAdapter adapter = nullptr;
   auto requestAdapterCallback = [](WGPURequestAdapterStatus status,
@@ -63,6 +106,12 @@ main(int32_t argc, char* argv[])
 
   wgpuInstanceRequestAdapter(
     instance, &adapterOptions, requestAdapterCallback, &adapter);
+  if (!adapter && isHeadless) {
+    std::cout << "No fallback adapter, using the default one\n";
+    adapterOptions.forceFallbackAdapter = false;
+    wgpuInstanceRequestAdapter(
+      instance, &adapterOptions, requestAdapterCallback, &adapter);
+  }
 
   if (!adapter) {
     std::cout << "Unable to request adapter\n";
@@ -85,6 +134,13 @@ main(int32_t argc, char* argv[])
   deviceDesc.nextInChain = nullptr;
   deviceDesc.label = "My Device";
 
+  // the render pass is timed on the GPU where timestamps are supported
+  WGPUFeatureName timestampFeature = WGPUFeatureName_TimestampQuery;
+  if (wgpuAdapterHasFeature(adapter, timestampFeature)) {
+    deviceDesc.requiredFeatureCount = 1;
+    deviceDesc.requiredFeatures = &timestampFeature;
+  }
+
   wgpuAdapterRequestDevice(
     adapter, &deviceDesc, deviceRequestCallback, &device);
 
@@ -94,284 +150,348 @@ main(int32_t argc, char* argv[])
   }
 
   WGPUQueue commandQueue = wgpuDeviceGetQueue(device);
+  Uint64 deviceReady = SDL_GetPerformanceCounter();
 
-  // surface configuration
-  WGPUSurfaceCapabilities capabilities;
-  wgpuSurfaceGetCapabilities(surface, adapter, &capabilities);
-
-  WGPUSurfaceConfiguration config = {};
-  config.nextInChain = nullptr;
-  config.format = WGPUTextureFormat_BGRA8Unorm; // capabilities.formats[1];
-  config.viewFormatCount = 0;
-  config.viewFormats = nullptr;
-  config.usage = WGPUTextureUsage_RenderAttachment;
-  config.device = device;
-  config.presentMode = WGPUPresentMode_Fifo;
-  config.alphaMode = WGPUCompositeAlphaMode_Opaque;
-  config.width = WINDOW_WIDTH;
-  config.height = WINDOW_HEIGHT;
-  wgpuSurfaceConfigure(surface, &config);
-
-  wgpuSurfaceCapabilitiesFreeMembers(capabilities);
-
-  // surface texture view descriptor
-  WGPUTextureViewDescriptor viewDescriptor = {};
-  viewDescriptor.nextInChain = nullptr;
-  viewDescriptor.label = "Surface texture view";
-  viewDescriptor.format = config.format;
-  viewDescriptor.dimension = WGPUTextureViewDimension_2D;
-  viewDescriptor.baseMipLevel = 0;
-  viewDescriptor.mipLevelCount = 1;
-  viewDescriptor.baseArrayLayer = 0;
-  viewDescriptor.arrayLayerCount = 1;
-  viewDescriptor.aspect = WGPUTextureAspect_All;
-
-  bool is_running = true;
-  SDL_Event e;
-
-  Uint64 lastTime = SDL_GetPerformanceCounter();
-  float deltaTime = 0.0f;
-
-  int32_t frameCount = 0;
-  float fps = 0.0f;
-  float fpsTimer = 0.0f;
-
-  UIContext uiContext = {};
-
-  BatchRenderer batchRenderer(
-    device, commandQueue, config.width, config.height);
-  batchRenderer.Initialize();
-
-  Vector2 editor_position = { 10.0f, 50.0f };
-  float fontSize = 23.0f;
-  Vector4 textColor = { 1.0f, 1.0f, 1.0f, 1.0f };
-  Vector4 cursorColor = LIME;
-  Vector4 selectionColor = { 0.0f, 0.5f, 1.0f, 0.5f };
-  Vector4 lineNumberColor = { 0.7f, 0.7f, 0.7f, 1.0f };
-
-  SimpleTextEditor editor(batchRenderer,
-                          editor_position,
-                          fontSize,
-                          textColor,
-                          cursorColor,
-                          selectionColor,
-                          lineNumberColor);
-
-  editor.projectConfigPath = "project_config.json";
-  editor.loadProjectConfig();
-
-  SDL_StartTextInput(window);
-
-  if (argc > 1) {
-    const char* filename = argv[1];
-    editor.loadTextFromFile(filename);
-    char buffer[255];
-    sprintf(buffer, "%s | %s", EDITOR_NAME, filename);
-    SDL_SetWindowTitle(window, buffer);
+  if (isHeadless) {
+    if (filename) {
+      headless.file = filename;
+    }
+    int32_t result = RunHeadless(device, commandQueue, headless);
+    wgpuQueueRelease(commandQueue);
+    wgpuDeviceRelease(device);
+    wgpuAdapterRelease(adapter);
+    wgpuInstanceRelease(instance);
+    SDL_Quit();
+    return result;
   }
 
-  CommandPalette commandPalette(batchRenderer, config.width, config.height);
-
-  commandPalette.onItemPreview = [&](const CommandPalette::Item& item) {
-    switch (commandPalette.getMode()) {
-      case CommandPaletteMode::TextSearch:
-      case CommandPaletteMode::CommentList:
-      case CommandPaletteMode::FunctionList:
-        editor.handleCommandPaletteSelection(item.data);
-        break;
-      case CommandPaletteMode::FileList:
-      case CommandPaletteMode::SystemCommand:
-        break;
+  // the renderer polls the device on its way out for pending upload maps
+  // and timestamp readbacks, so it and everything drawing with it is gone
+  // before the device is released, as in RunHeadless()
+  {
+    // surface configuration
+    WGPUSurfaceCapabilities capabilities;
+    wgpuSurfaceGetCapabilities(surface, adapter, &capabilities);
+
+    RenderTarget renderTarget(device,
+                              surface,
+                              WGPUTextureFormat_BGRA8Unorm, // formats[1]
+                              WINDOW_WIDTH,
+                              WINDOW_HEIGHT);
+
+    wgpuSurfaceCapabilitiesFreeMembers(capabilities);
+
+    bool is_running = true;
+    SDL_Event e;
+
+    Uint64 lastTime = SDL_GetPerformanceCounter();
+    float deltaTime = 0.0f;
+
+    // CPU time of the frames drawn lately and GPU time of their passes, for
+    // the bar
+    FrameSeries frameTimes;
+    FrameSeries gpuFrameTimes;
+    Profiler::SetThreadName("main");
+
+    // frames are only drawn when something changed, a display refresh that
+    // passes without one counts as skipped
+    bool redraw = true;
+    bool acquireFailed = false; // wait before the next try
+    uint64_t framesRendered = 0;
+    uint64_t framesSkipped = 0;
+    Uint64 lastFrameTime = SDL_GetPerformanceCounter();
+    float refreshInterval = 1.0f / 60.0f;
+    const SDL_DisplayMode* displayMode =
+      SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(window));
+    if (displayMode && displayMode->refresh_rate > 0.0f) {
+      refreshInterval = 1.0f / displayMode->refresh_rate;
     }
-  };
 
-  commandPalette.onItemSelect = [&](const CommandPalette::Item& item) {
-    switch (commandPalette.getMode()) {
-      case CommandPaletteMode::FileList:
-        editor.loadTextFromFile(item.displayText.c_str());
-        {
-          char buffer[255];
-          sprintf(buffer, "%s | %s", EDITOR_NAME, item.displayText.c_str());
-          SDL_SetWindowTitle(window, buffer);
-        }
-        break;
-      case CommandPaletteMode::TextSearch:
-      case CommandPaletteMode::CommentList:
-      case CommandPaletteMode::FunctionList:
-        editor.handleCommandPaletteSelection(item.data);
-        break;
-      case CommandPaletteMode::SystemCommand:
-        break;
-    }
-  };
+    UIContext uiContext = {};
+
+    BatchRenderer batchRenderer(
+      device, commandQueue, renderTarget.Width(), renderTarget.Height());
+    batchRenderer.Initialize();
+    Uint64 rendererReady = SDL_GetPerformanceCounter();
+
+    Vector2 editor_position = { 10.0f, 50.0f };
+    float fontSize = 23.0f;
+    Vector4 textColor = { 1.0f, 1.0f, 1.0f, 1.0f };
+    Vector4 cursorColor = LIME;
+    Vector4 selectionColor = { 0.0f, 0.5f, 1.0f, 0.5f };
+    Vector4 lineNumberColor = { 0.7f, 0.7f, 0.7f, 1.0f };
+
+    SimpleTextEditor editor(batchRenderer,
+                            editor_position,
+                            fontSize,
+                            textColor,
+                            cursorColor,
+                            selectionColor,
+                            lineNumberColor);
+
+    // the sample count comes from the project config, the pipeline follows
+    auto applyRenderConfig = [&]() {
+      renderTarget.SetSampleCount(editor.msaaSamples());
+      batchRenderer.SetTarget(renderTarget.Format(),
+                              renderTarget.SampleCount());
+    };
 
-  commandPalette.onCommandSelect = [&](const std::string& command) {
-    if (command == "/q") {
-      std::cout << "Exiting."
-                << "\n";
-      SDL_Event e;
-      e.type = SDL_EVENT_QUIT;
-      SDL_PushEvent(&e);
-    } else if (command.substr(0, 1) == "/n") {
-      std::string filename = command.substr(1);
-      std::cout << "Creating new file " << filename << "\n";
-    } else if (command == "/w") {
-      std::cout << "Saving buffer (not implemented use Ctr+S)."
-                << "\n";
-      editor.saveBufferToFile();
-    } else if (command == "/r") {
-      editor.projectConfigPath =
-        commandPalette.getWorkDir() + "/project_config.json";
-      editor.loadProjectConfig();
-    } else if (command == "/fmt") {
-      editor.formatCodeWithClangFormat();
-    }
-  };
+    batchRenderer.onUpload = [&](const UploadStats& stats) {
+      editor.setUploadBytes(stats.bytes);
+    };
+
+    batchRenderer.onGpuTime = [&](float ms) {
+      gpuFrameTimes.Add(ms);
+      editor.setGpuFrameTimes(gpuFrameTimes.Percentile(0.50f),
+                              gpuFrameTimes.Percentile(0.99f));
+    };
 
-  while (is_running) {
-    Uint64 currentTime = SDL_GetPerformanceCounter();
-    deltaTime = (float)(currentTime - lastTime) / SDL_GetPerformanceFrequency();
-    lastTime = currentTime;
+    editor.projectConfigPath = "project_config.json";
+    editor.loadProjectConfig();
+    applyRenderConfig();
 
-    fpsTimer += deltaTime;
-    frameCount++;
+    SDL_StartTextInput(window);
 
-    if (fpsTimer >= 1.0f) {
-      fps = frameCount / fpsTimer;
-      frameCount = 0;
-      fpsTimer -= 1.0f;
+    if (filename) {
+      editor.loadTextFromFile(filename);
+      char buffer[255];
+      sprintf(buffer, "%s | %s", EDITOR_NAME, filename);
+      SDL_SetWindowTitle(window, buffer);
     }
 
-    while (SDL_PollEvent(&e)) {
-      bool ctrlPressed = (SDL_GetModState() & SDL_KMOD_CTRL) != 0;
+    CommandPalette commandPalette(
+      batchRenderer, renderTarget.Width(), renderTarget.Height());
+
+    commandPalette.onItemPreview = [&](const CommandPalette::Item& item) {
+      switch (commandPalette.getMode()) {
+        case CommandPaletteMode::TextSearch:
+        case CommandPaletteMode::CommentList:
+        case CommandPaletteMode::FunctionList:
+          editor.handleCommandPaletteSelection(item.data);
+          break;
+        case CommandPaletteMode::FileList:
+        case CommandPaletteMode::SystemCommand:
+          break;
+      }
+    };
 
-      if (commandPalette.isVisible()) {
-        commandPalette.handleInput(e);
-      } else {
-        editor.handleInput(e);
-
-        switch (e.type) {
-          case SDL_EVENT_QUIT:
-            is_running = false;
-            break;
-
-          case SDL_EVENT_WINDOW_RESIZED: {
-            int32_t newWidth, newHeight;
-            SDL_GetWindowSize(window, &newWidth, &newHeight);
-
-            batchRenderer.windowWidth = newWidth;
-            batchRenderer.windowHeight = newHeight;
-
-            config.width = newWidth;
-            config.height = newHeight;
-
-            wgpuSurfaceConfigure(surface, &config);
-            editor.resize(config.width, config.height);
-            commandPalette.resize(config.width, config.height);
-          } break;
-
-          case SDL_EVENT_KEY_DOWN: {
-            if (e.key.key == SDLK_P) {
-              if (ctrlPressed) {
-                commandPalette.show();
-                commandPalette.setEditorText(editor.getText());
-              }
-            }
+    commandPalette.onItemSelect = [&](const CommandPalette::Item& item) {
+      switch (commandPalette.getMode()) {
+        case CommandPaletteMode::FileList:
+          editor.loadTextFromFile(item.displayText.c_str());
+          {
+            char buffer[255];
+            sprintf(buffer, "%s | %s", EDITOR_NAME, item.displayText.c_str());
+            SDL_SetWindowTitle(window, buffer);
+          }
+          break;
+        case CommandPaletteMode::TextSearch:
+        case CommandPaletteMode::CommentList:
+        case CommandPaletteMode::FunctionList:
+          editor.handleCommandPaletteSelection(item.data);
+          break;
+        case CommandPaletteMode::SystemCommand:
+          break;
+      }
+    };
 
-          } break;
+    commandPalette.onCommandSelect = [&](const std::string& command) {
+      if (command == "/q") {
+        std::cout << "Exiting."
+                  << "\n";
+        SDL_Event e;
+        e.type = SDL_EVENT_QUIT;
+        SDL_PushEvent(&e);
+      } else if (command.substr(0, 1) == "/n") {
+        std::string filename = command.substr(1);
+        std::cout << "Creating new file " << filename << "\n";
+      } else if (command == "/w") {
+        std::cout << "Saving buffer (not implemented use Ctr+S)."
+                  << "\n";
+        editor.saveBufferToFile();
+      } else if (command == "/r") {
+        editor.projectConfigPath =
+          commandPalette.getWorkDir() + "/project_config.json";
+        editor.loadProjectConfig();
+        applyRenderConfig();
+      } else if (command == "/fmt") {
+        editor.formatCodeWithClangFormat();
+      } else if (command == "/trace") {
+        if (Profiler::WriteTrace("trace.json")) {
+          std::cout << "Trace written to trace.json\n";
+        } else {
+          std::cerr << "Unable to write trace.json\n";
+        }
+      }
+    };
 
-          default:
-            break;
+    while (is_running) {
+      // sleep until an event arrives or the cursor blinks, also after the
+      // surface had no texture (the window is minimized or occluded)
+      if ((!redraw && !editor.needsFrame()) || acquireFailed) {
+        SDL_WaitEventTimeout(nullptr, editor.idleTimeoutMs());
+      }
+
+      Uint64 currentTime = SDL_GetPerformanceCounter();
+      deltaTime =
+        (float)(currentTime - lastTime) / SDL_GetPerformanceFrequency();
+      lastTime = currentTime;
+
+      PROFILE_ZONE("frame");
+      Uint64 frameStart = SDL_GetPerformanceCounter();
+
+      {
+        PROFILE_ZONE("events");
+        while (SDL_PollEvent(&e)) {
+          bool ctrlPressed = (SDL_GetModState() & SDL_KMOD_CTRL) != 0;
+
+          // the worker's wakeups and plain mouse movement change nothing by
+          // themselves, the editor decides about those in update()
+          if (e.type != SDL_EVENT_MOUSE_MOTION && e.type != SDL_EVENT_USER) {
+            redraw = true;
+          }
+
+          if (commandPalette.isVisible()) {
+            commandPalette.handleInput(e);
+          } else {
+            editor.handleInput(e);
+
+            switch (e.type) {
+              case SDL_EVENT_QUIT:
+                is_running = false;
+                break;
+
+              case SDL_EVENT_WINDOW_RESIZED: {
+                int32_t newWidth, newHeight;
+                SDL_GetWindowSize(window, &newWidth, &newHeight);
+
+                batchRenderer.windowWidth = newWidth;
+                batchRenderer.windowHeight = newHeight;
+
+                renderTarget.Resize(newWidth, newHeight);
+                editor.resize(newWidth, newHeight);
+                commandPalette.resize(newWidth, newHeight);
+              } break;
+
+              case SDL_EVENT_KEY_DOWN: {
+                if (e.key.key == SDLK_P) {
+                  if (ctrlPressed) {
+                    commandPalette.show();
+                    commandPalette.setEditorText(editor.getText());
+                  }
+                }
+
+              } break;
+
+              default:
+                break;
+            }
+          }
         }
       }
-    }
 
-    // UPDATE -------------------------------------------------
-    SDL_GetGlobalMouseState(&uiContext.Mouse.global.x,
-                            &uiContext.Mouse.global.y);
-    Uint32 mouseState = SDL_GetMouseState(&uiContext.Mouse.relative.x,
-                                          &uiContext.Mouse.relative.y);
-    uiContext.Mouse.pressed = (mouseState & SDL_BUTTON(SDL_BUTTON_LEFT)) != 0;
-    editor.update(deltaTime);
-
-    // RENDER -----------------------------------------------
-    WGPUSurfaceTexture surfaceTexture;
-    wgpuSurfaceGetCurrentTexture(surface, &surfaceTexture);
-    if (!surfaceTexture.texture) {
-      std::cout << "Unable to get texture from surface.\n";
-      continue;
-    }
+      // UPDATE -------------------------------------------------
+      SDL_GetGlobalMouseState(&uiContext.Mouse.global.x,
+                              &uiContext.Mouse.global.y);
+      Uint32 mouseState = SDL_GetMouseState(&uiContext.Mouse.relative.x,
+                                            &uiContext.Mouse.relative.y);
+      uiContext.Mouse.pressed = (mouseState & SDL_BUTTON(SDL_BUTTON_LEFT)) != 0;
+      {
+        PROFILE_ZONE("update");
+        editor.update(deltaTime);
+      }
 
-    WGPUTextureDescriptor multiSampledFrameDesc = {};
-    multiSampledFrameDesc.label = "Multi-sampled texture";
-    multiSampledFrameDesc.size.width = config.width;
-    multiSampledFrameDesc.size.height = config.height;
-    multiSampledFrameDesc.size.depthOrArrayLayers = 1;
-    multiSampledFrameDesc.mipLevelCount = 1;
-    multiSampledFrameDesc.sampleCount = MSAA_NUMBER_OF_SAMPLE;
-    multiSampledFrameDesc.dimension = WGPUTextureDimension_2D;
-    multiSampledFrameDesc.format = config.format;
-    multiSampledFrameDesc.usage = WGPUTextureUsage_RenderAttachment;
-
-    WGPUTexture multiSampledTexture =
-      wgpuDeviceCreateTexture(device, &multiSampledFrameDesc);
-    WGPUTextureView multiSampledTextureView =
-      wgpuTextureCreateView(multiSampledTexture, nullptr);
-
-    WGPUTextureView targetView =
-      wgpuTextureCreateView(surfaceTexture.texture, &viewDescriptor);
-    WGPUCommandEncoder encoder =
-      wgpuDeviceCreateCommandEncoder(device, nullptr);
-
-    WGPURenderPassColorAttachment colorAttachment = {};
-    colorAttachment.view =
-      multiSampledTextureView; // multi-sample render target
-    colorAttachment.resolveTarget = targetView;
-    colorAttachment.loadOp = WGPULoadOp_Clear;
-    colorAttachment.storeOp = WGPUStoreOp_Store;
-    Vector4 clearColor = RGBA32(0x2B2A33);
-    colorAttachment.clearValue = {
-      clearColor.x, clearColor.y, clearColor.z, clearColor.w
-    };
+      if (!redraw && !editor.needsFrame()) {
+        continue;
+      }
+
+      // a frame that couldn't get a surface texture is drawn on the next pass
+      acquireFailed = !renderTarget.Acquire();
+      if (acquireFailed) {
+        continue;
+      }
+      redraw = false;
+
+      Uint64 frameTime = SDL_GetPerformanceCounter();
+      float sinceLastFrame =
+        (float)(frameTime - lastFrameTime) / SDL_GetPerformanceFrequency();
+      int32_t refreshes = (int32_t)(sinceLastFrame / refreshInterval + 0.5f);
+      if (refreshes > 1) {
+        framesSkipped += refreshes - 1;
+      }
+      lastFrameTime = frameTime;
+      framesRendered++;
+      editor.setFrameStats(framesRendered, framesSkipped);
 
-    WGPURenderPassDescriptor renderPassDesc = {};
-    renderPassDesc.colorAttachmentCount = 1;
-    renderPassDesc.colorAttachments = &colorAttachment;
+      // RENDER -----------------------------------------------
+      WGPUCommandEncoder encoder =
+        wgpuDeviceCreateCommandEncoder(device, nullptr);
 
-    WGPURenderPassEncoder passEncoder =
-      wgpuCommandEncoderBeginRenderPass(encoder, &renderPassDesc);
+      Vector4 clearColor = RGBA32(0x2B2A33);
+      WGPURenderPassColorAttachment colorAttachment =
+        renderTarget.ColorAttachment(
+          { clearColor.x, clearColor.y, clearColor.z, clearColor.w });
 
-    editor.render(batchRenderer);
-    if (commandPalette.isVisible()) {
-      commandPalette.render();
-    }
+      WGPURenderPassDescriptor renderPassDesc = {};
+      renderPassDesc.colorAttachmentCount = 1;
+      renderPassDesc.colorAttachments = &colorAttachment;
+      renderPassDesc.timestampWrites = batchRenderer.PassTimestamps();
 
-    uint32_t flags = SDL_GetWindowFlags(window);
-    if ((flags & SDL_WINDOW_INPUT_FOCUS) != 0) {
-      editor.renderBar(batchRenderer);
-    }
+      WGPURenderPassEncoder passEncoder =
+        wgpuCommandEncoderBeginRenderPass(encoder, &renderPassDesc);
 
-    batchRenderer.Render(passEncoder);
+      editor.render(batchRenderer);
+      if (commandPalette.isVisible()) {
+        commandPalette.render();
+      }
 
-    wgpuRenderPassEncoderEnd(passEncoder);
-    wgpuRenderPassEncoderRelease(passEncoder);
+      uint32_t flags = SDL_GetWindowFlags(window);
+      if ((flags & SDL_WINDOW_INPUT_FOCUS) != 0) {
+        editor.renderBar(batchRenderer);
+      }
 
-    // submit to the command buffer
-    WGPUCommandBufferDescriptor cmdBufferDesc = {};
-    WGPUCommandBuffer commandBuffer =
-      wgpuCommandEncoderFinish(encoder, &cmdBufferDesc);
-    wgpuQueueSubmit(commandQueue, 1, &commandBuffer);
+      batchRenderer.Render(passEncoder);
 
-    // present the final frame
-    wgpuSurfacePresent(surface);
+      wgpuRenderPassEncoderEnd(passEncoder);
+      wgpuRenderPassEncoderRelease(passEncoder);
+      batchRenderer.ResolveTimestamps(encoder);
 
-    // cleanup
-    wgpuCommandBufferRelease(commandBuffer);
-    wgpuCommandEncoderRelease(encoder);
-    wgpuTextureViewRelease(targetView);
-    wgpuTextureRelease(surfaceTexture.texture);
-    wgpuTextureViewRelease(multiSampledTextureView);
-    wgpuTextureRelease(multiSampledTexture);
+      // submit to the command buffer
+      WGPUCommandBufferDescriptor cmdBufferDesc = {};
+      WGPUCommandBuffer commandBuffer =
+        wgpuCommandEncoderFinish(encoder, &cmdBufferDesc);
+      {
+        PROFILE_ZONE("submit");
+        wgpuQueueSubmit(commandQueue, 1, &commandBuffer);
+        batchRenderer.FrameSubmitted();
+      }
+
+      // present the final frame
+      {
+        PROFILE_ZONE("present");
+        renderTarget.Present();
+      }
+
+      Uint64 frameEnd = SDL_GetPerformanceCounter();
+      frameTimes.Add((float)(frameEnd - frameStart) * 1000.0f /
+                     SDL_GetPerformanceFrequency());
+      editor.setFrameTimes(frameTimes.Percentile(0.50f),
+                           frameTimes.Percentile(0.99f));
+
+      if (framesRendered == 1) {
+        Uint64 presented = SDL_GetPerformanceCounter();
+        printf("startup: first frame presented after %.1f ms (device %.1f ms, "
+               "renderer %.1f ms, editor %.1f ms)\n",
+               msSinceStart(presented),
+               msSinceStart(deviceReady),
+               msSinceStart(rendererReady) - msSinceStart(deviceReady),
+               msSinceStart(presented) - msSinceStart(rendererReady));
+      }
+
+      // cleanup
+      wgpuCommandBufferRelease(commandBuffer);
+      wgpuCommandEncoderRelease(encoder);
+    }
   }
 
   wgpuDeviceRelease(device);